@@ -0,0 +1,309 @@
+// Contrast detect autofocus - drive the lens toward the sharpest liveview frame
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+// Sharpness is the sum of absolute differences between neighbouring
+// luma pixels, across and down. Vector paths are picked like base64.c,
+// and give the same result as the scalar code.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define SHARP_X86
+	#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define SHARP_NEON
+	#include <arm_neon.h>
+#endif
+
+// ML liveview, 4 bytes per pixel after ptp_liveview_ml, luma first
+#define AF_ML_WIDTH 360
+#define AF_ML_HEIGHT 240
+
+// A frame this much worse (1/n) than the best is past the peak, not noise
+#define AF_NOISE 50
+
+// Frames in a row without a new best before giving up on a direction
+#define AF_STALE 2
+
+// Frames that aren't ready yet are retried this often
+#define AF_RETRY 10
+#define AF_RETRY_MAX 50
+
+static uint64_t sharp_rows_scalar(const uint8_t *p, int stride, int width, int height) {
+	uint64_t sum = 0;
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = p + (y * stride);
+		for (int x = 0; x + 1 < width; x++) {
+			sum += abs(row[x + 1] - row[x]);
+			if (y + 1 < height) sum += abs(row[x + stride] - row[x]);
+		}
+		if (y + 1 < height && width > 0) sum += abs(row[width - 1 + stride] - row[width - 1]);
+	}
+
+	return sum;
+}
+
+// Scalar tail of a row, from x to the end
+static uint64_t sharp_tail(const uint8_t *row, int stride, int x, int width, int down) {
+	uint64_t sum = 0;
+	for (; x < width; x++) {
+		if (x + 1 < width) sum += abs(row[x + 1] - row[x]);
+		if (down) sum += abs(row[x + stride] - row[x]);
+	}
+
+	return sum;
+}
+
+#ifdef SHARP_X86
+// _mm_sad_epu8 sums 8 absolute differences into each 64 bit half
+static uint64_t sharp_sse2(const uint8_t *p, int stride, int width, int height) {
+	uint64_t sum = 0;
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = p + (y * stride);
+		int down = y + 1 < height;
+		__m128i acc = _mm_setzero_si128();
+		int x = 0;
+		for (; x + 17 <= width; x += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(row + x));
+			__m128i b = _mm_loadu_si128((const __m128i *)(row + x + 1));
+			acc = _mm_add_epi64(acc, _mm_sad_epu8(a, b));
+			if (down) {
+				__m128i c = _mm_loadu_si128((const __m128i *)(row + x + stride));
+				acc = _mm_add_epi64(acc, _mm_sad_epu8(a, c));
+			}
+		}
+
+		uint64_t lanes[2];
+		_mm_storeu_si128((__m128i *)lanes, acc);
+		sum += lanes[0] + lanes[1];
+		sum += sharp_tail(row, stride, x, width, down);
+	}
+
+	return sum;
+}
+
+__attribute__((target("avx2")))
+static uint64_t sharp_avx2(const uint8_t *p, int stride, int width, int height) {
+	uint64_t sum = 0;
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = p + (y * stride);
+		int down = y + 1 < height;
+		__m256i acc = _mm256_setzero_si256();
+		int x = 0;
+		for (; x + 33 <= width; x += 32) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(row + x));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(row + x + 1));
+			acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, b));
+			if (down) {
+				__m256i c = _mm256_loadu_si256((const __m256i *)(row + x + stride));
+				acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, c));
+			}
+		}
+
+		uint64_t lanes[4];
+		_mm256_storeu_si256((__m256i *)lanes, acc);
+		sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		sum += sharp_tail(row, stride, x, width, down);
+	}
+
+	return sum;
+}
+
+static int sharp_x86_level = -1;
+#endif
+
+#ifdef SHARP_NEON
+static uint64_t sharp_neon(const uint8_t *p, int stride, int width, int height) {
+	uint64_t sum = 0;
+	for (int y = 0; y < height; y++) {
+		const uint8_t *row = p + (y * stride);
+		int down = y + 1 < height;
+		uint32x4_t acc = vdupq_n_u32(0);
+		int x = 0;
+		while (x + 17 <= width) {
+			// 16 bit lanes take at most 2 * 255 per pass, widen before they can overflow
+			uint16x8_t part = vdupq_n_u16(0);
+			for (int n = 0; n < 64 && x + 17 <= width; n++, x += 16) {
+				uint8x16_t a = vld1q_u8(row + x);
+				part = vpadalq_u8(part, vabdq_u8(a, vld1q_u8(row + x + 1)));
+				if (down) part = vpadalq_u8(part, vabdq_u8(a, vld1q_u8(row + x + stride)));
+			}
+			acc = vpadalq_u16(acc, part);
+		}
+
+		sum += vaddlvq_u32(acc);
+		sum += sharp_tail(row, stride, x, width, down);
+	}
+
+	return sum;
+}
+#endif
+
+uint64_t ptp_sharpness(const uint8_t *luma, int stride, int width, int height) {
+#if defined(SHARP_X86)
+	if (sharp_x86_level == -1) {
+		__builtin_cpu_init();
+		sharp_x86_level = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	if (sharp_x86_level == 1) return sharp_avx2(luma, stride, width, height);
+	return sharp_sse2(luma, stride, width, height);
+#elif defined(SHARP_NEON)
+	return sharp_neon(luma, stride, width, height);
+#else
+	return sharp_rows_scalar(luma, stride, width, height);
+#endif
+}
+
+uint64_t ptp_sharpness_scalar(const uint8_t *luma, int stride, int width, int height) {
+	return sharp_rows_scalar(luma, stride, width, height);
+}
+
+// Get a fresh frame after a move and score it
+static int af_measure(struct PtpRuntime *r, struct PtpAutofocus *af, uint8_t *frame, uint8_t *luma, uint64_t *metric) {
+	int length = 0;
+	for (int i = 0; i <= af->skip; i++) {
+		for (int t = 0; t < AF_RETRY_MAX; t++) {
+			length = ptp_liveview_frame(r, frame);
+			if (length == PTP_CHECK_CODE && ptp_get_return_code(r) == PTP_RC_CANON_NotReady) length = 0;
+			if (length != 0) break;
+			CAMLIB_SLEEP(AF_RETRY);
+		}
+		if (length < 0) return length;
+		if (length == 0) return PTP_RUNTIME_ERR;
+		af->frames++;
+	}
+
+	if (ptp_liveview_type(r) != PTP_LV_ML) {
+		// JPEG gets bigger with more detail, it's the best that can be done without decoding
+		*metric = length;
+		return 0;
+	}
+
+	for (int y = 0; y < af->h; y++) {
+		const uint8_t *src = frame + ((((af->y + y) * AF_ML_WIDTH) + af->x) * 4);
+		for (int x = 0; x < af->w; x++) {
+			luma[(y * af->w) + x] = src[x * 4];
+		}
+	}
+
+	*metric = ptp_sharpness(luma, af->w, af->w, af->h);
+	return 0;
+}
+
+static int af_move(struct PtpRuntime *r, struct PtpAutofocus *af, int step) {
+	int x = ptp_eos_drive_lens(r, step);
+	if (x) return x;
+	af->moves++;
+	if (af->settle) CAMLIB_SLEEP(af->settle);
+	return 0;
+}
+
+int ptp_eos_autofocus(struct PtpRuntime *r, struct PtpAutofocus *af) {
+	int type = ptp_liveview_type(r);
+	if (type != PTP_LV_ML && type != PTP_LV_EOS) return PTP_UNSUPPORTED;
+
+	// Only the whole JPEG can be scored on EOS, don't pretend to use a region
+	if (type == PTP_LV_EOS && (af->w > 0 || af->h > 0)) return PTP_UNSUPPORTED;
+
+	// Default region is the middle quarter
+	if (af->w <= 0 || af->h <= 0) {
+		af->w = AF_ML_WIDTH / 2;
+		af->h = AF_ML_HEIGHT / 2;
+		af->x = AF_ML_WIDTH / 4;
+		af->y = AF_ML_HEIGHT / 4;
+	}
+	if (af->x < 0 || af->y < 0 || af->x + af->w > AF_ML_WIDTH || af->y + af->h > AF_ML_HEIGHT) {
+		return PTP_RUNTIME_ERR;
+	}
+
+	if (af->max_frames <= 0) af->max_frames = 40;
+
+	af->frames = 0;
+	af->moves = 0;
+	af->converged = 0;
+
+	uint8_t *frame = malloc(ptp_liveview_size(r));
+	uint8_t *luma = NULL;
+	if (type == PTP_LV_ML) luma = malloc(af->w * af->h);
+	if (frame == NULL || (type == PTP_LV_ML && luma == NULL)) {
+		free(frame);
+		free(luma);
+		return PTP_OUT_OF_MEM;
+	}
+
+	ptp_lock(r);
+	af->start = ptp_time_us();
+
+	uint64_t best;
+	int x = af_measure(r, af, frame, luma, &best);
+	if (x) goto end;
+
+	// Lens position relative to the start, in drive steps
+	int pos = 0;
+	int best_pos = 0;
+	int dir = 1;
+
+	// Large, then medium, then small steps. Each size walks until the score
+	// stops improving, returns to the best position, and the next size looks
+	// on both sides of it, since the peak could be anywhere within one step.
+	for (int size = 3; size >= 1; size--) {
+		for (int side = 0; side < 2; side++) {
+			int improved = 0;
+			int stale = 0;
+			while (af->frames < af->max_frames) {
+				x = af_move(r, af, dir * size);
+				if (x) goto end;
+				pos += dir * size;
+
+				uint64_t m;
+				x = af_measure(r, af, frame, luma, &m);
+				if (x) goto end;
+
+				if (m > best) {
+					best = m;
+					best_pos = pos;
+					improved = 1;
+					stale = 0;
+					continue;
+				}
+
+				// A clear drop ends it right away, a flat top after a couple of tries
+				stale++;
+				if (best - m > best / AF_NOISE || stale >= AF_STALE) break;
+			}
+
+			while (pos != best_pos) {
+				int step = pos < best_pos ? size : -size;
+				x = af_move(r, af, step);
+				if (x) goto end;
+				pos += step;
+			}
+
+			dir = -dir;
+			if (improved || af->frames >= af->max_frames) break;
+		}
+
+		if (af->frames >= af->max_frames) break;
+	}
+
+	af->converged = af->frames < af->max_frames;
+	af->metric = best;
+
+	end:;
+	af->end = ptp_time_us();
+	ptp_unlock(r);
+	free(frame);
+	free(luma);
+	return x;
+}
+
+int ptp_autofocus_json(struct PtpAutofocus *af, char *buffer, int max) {
+	return snprintf(buffer, max, "{\"converged\": %d, \"frames\": %d, \"moves\": %d, \"ms\": %.1f, \"metric\": %llu}",
+		af->converged, af->frames, af->moves, (af->end - af->start) / 1000.0, (unsigned long long)af->metric);
+}
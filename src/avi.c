@@ -0,0 +1,364 @@
+// Liveview recording into an AVI file, JPEG frames as MJPEG
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+// The file is written front to back: a header with zero sizes, one
+// 00dc (JPEG) or 00db (raw) chunk per frame, then the idx1 index.
+// Closing rewrites the header with the frame count, size and the
+// measured frame rate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// Header up to and including the movi list type
+#define AVI_HEADER_SIZE 224
+#define AVI_MOVI_OFFSET (AVI_HEADER_SIZE - 4)
+
+// RIFF sizes are 32 bit, and many readers stop at 1GB without OpenDML
+#define AVI_MAX_SIZE 0x40000000
+
+#define AVIF_HASINDEX 0x10
+#define AVIIF_KEYFRAME 0x10
+
+// stdio buffer, so the disk sees large writes
+#define AVI_BUFFER_SIZE (4 * 1024 * 1024)
+
+// ML frames, see ptp_liveview_frame
+#define AVI_ML_WIDTH 360
+#define AVI_ML_HEIGHT 240
+
+// How often the writer looks for a new frame
+#define PTP_RECORD_POLL 2
+
+static uint8_t *avi_u32(uint8_t *d, uint32_t x) {
+	d[0] = x;
+	d[1] = x >> 8;
+	d[2] = x >> 16;
+	d[3] = x >> 24;
+	return d + 4;
+}
+
+static uint8_t *avi_u16(uint8_t *d, uint16_t x) {
+	d[0] = x;
+	d[1] = x >> 8;
+	return d + 2;
+}
+
+static uint8_t *avi_fourcc(uint8_t *d, const char *s) {
+	memcpy(d, s, 4);
+	return d + 4;
+}
+
+static int avi_header(struct PtpRecorder *rec, uint8_t *h) {
+	uint32_t frames = rec->frames;
+	uint32_t biggest = rec->biggest;
+
+	// Whole frame rate as a fraction, from the timestamps of the first and last frame
+	uint32_t rate = 1000 * 30;
+	uint32_t scale = 1000;
+	if (frames > 1 && rec->last > rec->first) {
+		rate = (uint32_t)(((uint64_t)(frames - 1) * 1000000000ULL) / (rec->last - rec->first));
+		if (rate == 0) rate = 1;
+	}
+
+	uint8_t *d = h;
+	d = avi_fourcc(d, "RIFF");
+	d = avi_u32(d, (AVI_HEADER_SIZE - 8) + rec->movi + (rec->frames ? 8 + (rec->frames * 16) : 0));
+	d = avi_fourcc(d, "AVI ");
+
+	d = avi_fourcc(d, "LIST");
+	d = avi_u32(d, 192);
+	d = avi_fourcc(d, "hdrl");
+
+	d = avi_fourcc(d, "avih");
+	d = avi_u32(d, 56);
+	d = avi_u32(d, (uint32_t)(((uint64_t)scale * 1000000) / rate));
+	d = avi_u32(d, 0);
+	d = avi_u32(d, 0);
+	d = avi_u32(d, AVIF_HASINDEX);
+	d = avi_u32(d, frames);
+	d = avi_u32(d, 0);
+	d = avi_u32(d, 1);
+	d = avi_u32(d, biggest);
+	d = avi_u32(d, rec->width);
+	d = avi_u32(d, rec->height);
+	memset(d, 0, 16);
+	d += 16;
+
+	d = avi_fourcc(d, "LIST");
+	d = avi_u32(d, 116);
+	d = avi_fourcc(d, "strl");
+
+	d = avi_fourcc(d, "strh");
+	d = avi_u32(d, 56);
+	d = avi_fourcc(d, "vids");
+	d = avi_fourcc(d, rec->mjpeg ? "MJPG" : "\0\0\0\0");
+	d = avi_u32(d, 0);
+	d = avi_u16(d, 0);
+	d = avi_u16(d, 0);
+	d = avi_u32(d, 0);
+	d = avi_u32(d, scale);
+	d = avi_u32(d, rate);
+	d = avi_u32(d, 0);
+	d = avi_u32(d, frames);
+	d = avi_u32(d, biggest);
+	d = avi_u32(d, 0xffffffff);
+	d = avi_u32(d, 0);
+	d = avi_u16(d, 0);
+	d = avi_u16(d, 0);
+	d = avi_u16(d, rec->width);
+	d = avi_u16(d, rec->height);
+
+	// BITMAPINFOHEADER, raw frames are top down BGRA
+	d = avi_fourcc(d, "strf");
+	d = avi_u32(d, 40);
+	d = avi_u32(d, 40);
+	d = avi_u32(d, rec->width);
+	d = avi_u32(d, rec->mjpeg ? rec->height : -rec->height);
+	d = avi_u16(d, 1);
+	d = avi_u16(d, rec->mjpeg ? 24 : 32);
+	d = avi_fourcc(d, rec->mjpeg ? "MJPG" : "\0\0\0\0");
+	d = avi_u32(d, rec->width * rec->height * (rec->mjpeg ? 3 : 4));
+	memset(d, 0, 16);
+	d += 16;
+
+	d = avi_fourcc(d, "LIST");
+	d = avi_u32(d, 4 + rec->movi);
+	d = avi_fourcc(d, "movi");
+
+	return d - h;
+}
+
+// Compressed (JPEG) or uncompressed DIB chunks of stream 0
+static const char *avi_chunk_id(struct PtpRecorder *rec) {
+	return rec->mjpeg ? "00dc" : "00db";
+}
+
+// Size from the first start of frame marker
+static int avi_jpeg_size(uint8_t *jpeg, int length, int *width, int *height) {
+	int i = 2;
+	while (i + 9 < length) {
+		if (jpeg[i] != 0xff) return PTP_RUNTIME_ERR;
+		uint8_t marker = jpeg[i + 1];
+		int size = (jpeg[i + 2] << 8) | jpeg[i + 3];
+		if (marker >= 0xc0 && marker <= 0xc3) {
+			*height = (jpeg[i + 5] << 8) | jpeg[i + 6];
+			*width = (jpeg[i + 7] << 8) | jpeg[i + 8];
+			return 0;
+		}
+		i += 2 + size;
+	}
+
+	return PTP_RUNTIME_ERR;
+}
+
+int ptp_avi_open(struct PtpRecorder *rec, const char *path, int mjpeg, int width, int height) {
+	rec->file = fopen(path, "wb");
+	if (rec->file == NULL) return PTP_RUNTIME_ERR;
+
+	rec->buffer = malloc(AVI_BUFFER_SIZE);
+	if (rec->buffer != NULL) setvbuf(rec->file, (char *)rec->buffer, _IOFBF, AVI_BUFFER_SIZE);
+
+	rec->mjpeg = mjpeg;
+	rec->width = width;
+	rec->height = height;
+	rec->frames = 0;
+	rec->biggest = 0;
+	rec->movi = 0;
+	rec->first = 0;
+	rec->last = 0;
+	rec->index = NULL;
+	rec->index_length = 0;
+
+	uint8_t h[AVI_HEADER_SIZE];
+	avi_header(rec, h);
+	if (fwrite(h, 1, AVI_HEADER_SIZE, rec->file) != AVI_HEADER_SIZE) {
+		ptp_avi_close(rec);
+		return PTP_RUNTIME_ERR;
+	}
+
+	return 0;
+}
+
+int ptp_avi_write(struct PtpRecorder *rec, uint8_t *data, int length, uint64_t time) {
+	if (rec->file == NULL) return PTP_RUNTIME_ERR;
+	if (rec->mjpeg && rec->width == 0) {
+		if (avi_jpeg_size(data, length, &rec->width, &rec->height)) return PTP_RUNTIME_ERR;
+	}
+
+	uint32_t padded = (length + 1) & ~1;
+	if ((uint64_t)AVI_HEADER_SIZE + rec->movi + 8 + padded + ((rec->frames + 1) * 16) + 8 > AVI_MAX_SIZE) {
+		return PTP_OUT_OF_MEM;
+	}
+
+	// Offset and size of each frame, for idx1
+	if (rec->frames == rec->index_length) {
+		int n = rec->index_length ? rec->index_length * 2 : 1024;
+		uint32_t *index = realloc(rec->index, n * sizeof(uint32_t) * 2);
+		if (index == NULL) return PTP_OUT_OF_MEM;
+		rec->index = index;
+		rec->index_length = n;
+	}
+
+	uint8_t chunk[8];
+	avi_fourcc(chunk, avi_chunk_id(rec));
+	avi_u32(chunk + 4, length);
+	if (fwrite(chunk, 1, 8, rec->file) != 8) return PTP_RUNTIME_ERR;
+	if (fwrite(data, 1, length, rec->file) != (size_t)length) return PTP_RUNTIME_ERR;
+	if (padded != (uint32_t)length && fputc(0, rec->file) == EOF) return PTP_RUNTIME_ERR;
+
+	rec->index[rec->frames * 2] = 4 + rec->movi;
+	rec->index[(rec->frames * 2) + 1] = length;
+	rec->movi += 8 + padded;
+	rec->frames++;
+	if ((uint32_t)length > rec->biggest) rec->biggest = length;
+	if (rec->first == 0) rec->first = time;
+	rec->last = time;
+	return 0;
+}
+
+int ptp_avi_close(struct PtpRecorder *rec) {
+	if (rec->file == NULL) return 0;
+
+	int x = 0;
+	if (rec->frames) {
+		uint8_t entry[16];
+		avi_fourcc(entry, "idx1");
+		avi_u32(entry + 4, rec->frames * 16);
+		if (fwrite(entry, 1, 8, rec->file) != 8) x = PTP_RUNTIME_ERR;
+		for (uint32_t i = 0; i < rec->frames && x == 0; i++) {
+			avi_fourcc(entry, avi_chunk_id(rec));
+			avi_u32(entry + 4, AVIIF_KEYFRAME);
+			avi_u32(entry + 8, rec->index[i * 2]);
+			avi_u32(entry + 12, rec->index[(i * 2) + 1]);
+			if (fwrite(entry, 1, 16, rec->file) != 16) x = PTP_RUNTIME_ERR;
+		}
+	}
+
+	uint8_t h[AVI_HEADER_SIZE];
+	avi_header(rec, h);
+	if (fseek(rec->file, 0, SEEK_SET) || fwrite(h, 1, AVI_HEADER_SIZE, rec->file) != AVI_HEADER_SIZE) {
+		x = PTP_RUNTIME_ERR;
+	}
+
+	if (fclose(rec->file)) x = PTP_RUNTIME_ERR;
+	rec->file = NULL;
+	free(rec->buffer);
+	rec->buffer = NULL;
+	free(rec->index);
+	rec->index = NULL;
+	return x;
+}
+
+static void *record_thread(void *arg) {
+	struct PtpRecorder *rec = arg;
+	uint32_t seq = 0;
+	uint8_t *bgra = NULL;
+	if (!rec->mjpeg) {
+		bgra = malloc(rec->width * rec->height * 4);
+		if (bgra == NULL) {
+			rec->error = PTP_OUT_OF_MEM;
+			rec->running = 0;
+			return NULL;
+		}
+	}
+
+	while (!rec->stop) {
+		// Another reader of the ring, the display path never waits on this
+		struct PtpLiveviewFrame *f = ptp_liveview_thread_take(rec->lv, seq);
+		if (f == NULL) {
+			if (!rec->lv->running) break;
+			CAMLIB_SLEEP(PTP_RECORD_POLL);
+			continue;
+		}
+
+		if (seq != 0 && f->seq > seq + 1) rec->skipped += f->seq - seq - 1;
+		seq = f->seq;
+
+		uint64_t start = ptp_time_us();
+		uint64_t time = f->time;
+		int x;
+		if (bgra != NULL) {
+			ptp_yuva_convert(bgra, f->data, rec->width, rec->height, PTP_PIXEL_BGRA, 0xff);
+			ptp_liveview_thread_release(rec->lv, f);
+			x = ptp_avi_write(rec, bgra, rec->width * rec->height * 4, time);
+		} else {
+			x = ptp_avi_write(rec, f->data, f->length, f->time);
+			ptp_liveview_thread_release(rec->lv, f);
+		}
+
+		uint64_t took = ptp_time_us() - start;
+		rec->write_total += took;
+		if (took > rec->write_max) rec->write_max = took;
+
+		if (x) {
+			rec->error = x;
+			break;
+		}
+	}
+
+	free(bgra);
+	rec->running = 0;
+	return NULL;
+}
+
+int ptp_recorder_start(struct PtpRuntime *r, struct PtpRecorder *rec, struct PtpLiveviewThread *lv, const char *path) {
+	if (rec->thread != NULL) {
+		if (rec->running) return PTP_RUNTIME_ERR;
+		ptp_recorder_stop(rec);
+	}
+
+	if (!lv->running) return PTP_RUNTIME_ERR;
+
+	int x;
+	switch (ptp_liveview_type(r)) {
+	case PTP_LV_EOS:
+		x = ptp_avi_open(rec, path, 1, 0, 0);
+		break;
+	case PTP_LV_ML:
+		x = ptp_avi_open(rec, path, 0, AVI_ML_WIDTH, AVI_ML_HEIGHT);
+		break;
+	default:
+		return PTP_UNSUPPORTED;
+	}
+	if (x) return x;
+
+	rec->lv = lv;
+	rec->stop = 0;
+	rec->error = 0;
+	rec->skipped = 0;
+	rec->write_total = 0;
+	rec->write_max = 0;
+	rec->running = 1;
+
+	x = ptp_thread_start(&rec->thread, record_thread, rec, 0);
+	if (x < 0) {
+		rec->running = 0;
+		ptp_avi_close(rec);
+		return x;
+	}
+
+	return 0;
+}
+
+int ptp_recorder_stop(struct PtpRecorder *rec) {
+	if (rec->thread == NULL) return 0;
+
+	rec->stop = 1;
+	ptp_thread_join(rec->thread);
+	rec->thread = NULL;
+
+	int x = ptp_avi_close(rec);
+	return rec->error ? rec->error : x;
+}
+
+int ptp_recorder_json(struct PtpRecorder *rec, char *buffer, int max) {
+	double seconds = rec->last > rec->first ? (rec->last - rec->first) / 1000000.0 : 0;
+	return snprintf(buffer, max, "{\"running\": %d, \"error\": %d, \"frames\": %u, \"skipped\": %u, \"fps\": %.2f, "
+		"\"megabytes\": %.2f, \"write\": {\"avg\": %.3f, \"max\": %.3f}}",
+		rec->running, rec->error, rec->frames, rec->skipped, seconds > 0 ? (rec->frames - 1) / seconds : 0,
+		rec->movi / 1000000.0, rec->frames ? (double)rec->write_total / rec->frames / 1000.0 : 0, rec->write_max / 1000.0);
+}
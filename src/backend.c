@@ -51,8 +51,19 @@ int ptp_recieve_bulk_packets(struct PtpRuntime *r) {
 		}
 		read += x;
 
+		ptp_stream_feed(r, read);
+
 		if (read >= r->data_length - r->max_packet_size) {
 			PTPLOG("recieve_bulk_packets: Not enough memory\n");
+
+			// Throw away the rest and the response, so the next transaction starts clean
+			uint8_t *scratch = r->data + r->data_length - r->max_packet_size;
+			while (x == r->max_packet_size) {
+				x = ptp_recieve_bulk_packet(scratch, r->max_packet_size);
+				if (x < 0) return PTP_IO_ERR;
+			}
+			ptp_recieve_bulk_packet(scratch, r->max_packet_size);
+
 			return PTP_OUT_OF_MEM;
 		}
 
@@ -109,40 +120,60 @@ int ptp_fsend_packets(struct PtpRuntime *r, int length, FILE *stream) {
 int ptp_frecieve_bulk_packets(struct PtpRuntime *r, FILE *stream, int of) {
 	int read = 0;
 
-	// Since the data is written to file, we must remember the packet type
+	// Large files are read in big transfers, as many whole packets as r->data holds
+	int chunk = r->data_length - (r->data_length % r->max_packet_size);
+
+	// Since the data is written to file, we must remember the packet type and length
 	int type = -1;
+	int total = 0;
 	while (1) {
-		int x = ptp_recieve_bulk_packet(r->data, r->max_packet_size);
+		int x = ptp_recieve_bulk_packet(r->data, chunk);
 		if (x < 0) {
 			PTPLOG("recieve_bulk_packet: %d\n", x);
 			return PTP_IO_ERR;
 		}
 
 		if (type == -1) {
+			if (x < 12) return PTP_IO_ERR;
 			struct PtpBulkContainer *c = (struct PtpBulkContainer *)(r->data);
 			type = c->type;
+			total = c->length;
+		} else if (x == 0) {
+			// Data can only end early with a short packet, not an empty one
+			if (read < total) return PTP_IO_ERR;
 		}
 
-		int fr = fwrite(r->data + of, 1, x - of, stream);
-		of = 0;
-		if (fr <= 0) {
-			PTPLOG("fwrite: %d\n", fr);
+		// When the data is a multiple of the packet size, the response
+		// can arrive in the same transfer, and must stay out of the file
+		int end = x;
+		if (type == PTP_PACKET_TYPE_DATA && read + x > total) end = total - read;
+
+		if (end > of) {
+			int fr = fwrite(r->data + of, 1, end - of, stream);
+			if (fr != end - of) {
+				PTPLOG("fwrite: %d\n", fr);
+				return PTP_RUNTIME_ERR;
+			}
 		}
-		
+		of = 0;
+
 		read += x;
 
-		if (x != r->max_packet_size) {
+		if (type != PTP_PACKET_TYPE_DATA) return read;
+
+		if (read > total) {
+			memmove(r->data, r->data + end, x - end);
+			return total;
+		}
+
+		if (read == total || x % r->max_packet_size != 0) {
 			PTPLOG("recieve_bulk_packets: Read %d bytes\n", read);
 
 			// Read the response packet if only a data packet was sent
-			if (type == PTP_PACKET_TYPE_DATA) {
-				x = ptp_recieve_bulk_packet(r->data, r->max_packet_size);
-				PTPLOG("recieve_bulk_packets: Return code: 0x%X\n", ptp_get_return_code(r));
-			} else {
-				// TODO: Why send a small packet with stream reader?
-			}
-
+			x = ptp_recieve_bulk_packet(r->data, r->max_packet_size);
+			if (x < 0) return PTP_IO_ERR;
+			PTPLOG("recieve_bulk_packets: Return code: 0x%X\n", ptp_get_return_code(r));
 			return read;
 		}
-	}	
+	}
 }
@@ -0,0 +1,201 @@
+// Base64 encoder for binary payloads in JSON responses
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+// Vector paths are picked at runtime on x86 (SSSE3/AVX2) and at
+// compile time on ARM (NEON). Every path produces the same output as
+// the scalar encoder, which also handles the tail of each buffer.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <camlib.h>
+
+static const char base64_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define BASE64_X86
+	#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define BASE64_NEON
+	#include <arm_neon.h>
+#endif
+
+int ptp_base64_length(int length) {
+	return ((length + 2) / 3) * 4;
+}
+
+static int base64_scalar(char *dst, const uint8_t *src, int length) {
+	char *start = dst;
+	int i = 0;
+	for (; i + 3 <= length; i += 3) {
+		uint32_t x = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+		dst[0] = base64_alphabet[(x >> 18) & 0x3f];
+		dst[1] = base64_alphabet[(x >> 12) & 0x3f];
+		dst[2] = base64_alphabet[(x >> 6) & 0x3f];
+		dst[3] = base64_alphabet[x & 0x3f];
+		dst += 4;
+	}
+
+	int left = length - i;
+	if (left) {
+		uint32_t x = src[i] << 16;
+		if (left == 2) x |= src[i + 1] << 8;
+		dst[0] = base64_alphabet[(x >> 18) & 0x3f];
+		dst[1] = base64_alphabet[(x >> 12) & 0x3f];
+		dst[2] = (left == 2) ? base64_alphabet[(x >> 6) & 0x3f] : '=';
+		dst[3] = '=';
+		dst += 4;
+	}
+
+	return dst - start;
+}
+
+#ifdef BASE64_X86
+// Split 12 bytes into 16 6-bit indexes, one per byte (Mula/Lemire)
+__attribute__((target("ssse3")))
+static __m128i base64_reshuffle_ssse3(__m128i in) {
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	__m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	__m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	__m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	__m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+// Map 6-bit indexes to ASCII by adding a per-range offset
+__attribute__((target("ssse3")))
+static __m128i base64_translate_ssse3(__m128i in) {
+	const __m128i lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	__m128i idx = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	__m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+	idx = _mm_or_si128(idx, _mm_and_si128(less, _mm_set1_epi8(13)));
+	return _mm_add_epi8(_mm_shuffle_epi8(lut, idx), in);
+}
+
+__attribute__((target("ssse3")))
+static int base64_ssse3(char *dst, const uint8_t *src, int length) {
+	int i = 0;
+	char *out = dst;
+
+	// Loads are 16 bytes wide but only 12 are consumed
+	for (; i + 16 <= length; i += 12) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)out, base64_translate_ssse3(base64_reshuffle_ssse3(in)));
+		out += 16;
+	}
+
+	return (out - dst) + base64_scalar(out, src + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static int base64_avx2(char *dst, const uint8_t *src, int length) {
+	int i = 0;
+	char *out = dst;
+
+	const __m256i shuf = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+		10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m256i lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	// 24 input bytes per iteration, 12 in each 128 bit lane
+	for (; i + 28 <= length; i += 24) {
+		__m256i in = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + i))),
+			_mm_loadu_si128((const __m128i *)(src + i + 12)), 1);
+
+		in = _mm256_shuffle_epi8(in, shuf);
+		__m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+		__m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		__m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+		__m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		in = _mm256_or_si256(t1, t3);
+
+		__m256i idx = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+		__m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), in);
+		idx = _mm256_or_si256(idx, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+		in = _mm256_add_epi8(_mm256_shuffle_epi8(lut, idx), in);
+
+		_mm256_storeu_si256((__m256i *)out, in);
+		out += 32;
+	}
+
+	return (out - dst) + base64_ssse3(out, src + i, length - i);
+}
+
+static int base64_x86_level = -1;
+
+static int base64_x86(char *dst, const uint8_t *src, int length) {
+	if (base64_x86_level == -1) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			base64_x86_level = 2;
+		} else if (__builtin_cpu_supports("ssse3")) {
+			base64_x86_level = 1;
+		} else {
+			base64_x86_level = 0;
+		}
+	}
+
+	switch (base64_x86_level) {
+	case 2:
+		return base64_avx2(dst, src, length);
+	case 1:
+		return base64_ssse3(dst, src, length);
+	}
+
+	return base64_scalar(dst, src, length);
+}
+#endif
+
+#ifdef BASE64_NEON
+static int base64_neon(char *dst, const uint8_t *src, int length) {
+	int i = 0;
+	char *out = dst;
+
+	uint8x16x4_t lut;
+	lut.val[0] = vld1q_u8((const uint8_t *)base64_alphabet);
+	lut.val[1] = vld1q_u8((const uint8_t *)base64_alphabet + 16);
+	lut.val[2] = vld1q_u8((const uint8_t *)base64_alphabet + 32);
+	lut.val[3] = vld1q_u8((const uint8_t *)base64_alphabet + 48);
+
+	const uint8x16_t mask = vdupq_n_u8(0x3f);
+
+	// De-interleave 48 bytes into 3 vectors, produce 4 vectors of indexes
+	for (; i + 48 <= length; i += 48) {
+		uint8x16x3_t in = vld3q_u8(src + i);
+		uint8x16x4_t res;
+		res.val[0] = vshrq_n_u8(in.val[0], 2);
+		res.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4), vshlq_n_u8(in.val[0], 4)), mask);
+		res.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6), vshlq_n_u8(in.val[1], 2)), mask);
+		res.val[3] = vandq_u8(in.val[2], mask);
+
+		res.val[0] = vqtbl4q_u8(lut, res.val[0]);
+		res.val[1] = vqtbl4q_u8(lut, res.val[1]);
+		res.val[2] = vqtbl4q_u8(lut, res.val[2]);
+		res.val[3] = vqtbl4q_u8(lut, res.val[3]);
+
+		vst4q_u8((uint8_t *)out, res);
+		out += 64;
+	}
+
+	return (out - dst) + base64_scalar(out, src + i, length - i);
+}
+#endif
+
+int ptp_base64_encode(char *dst, const uint8_t *src, int length) {
+#if defined(BASE64_X86)
+	return base64_x86(dst, src, length);
+#elif defined(BASE64_NEON)
+	return base64_neon(dst, src, length);
+#else
+	return base64_scalar(dst, src, length);
+#endif
+}
+
+int ptp_base64_encode_scalar(char *dst, const uint8_t *src, int length) {
+	return base64_scalar(dst, src, length);
+}
@@ -15,26 +15,74 @@
 int bind_connected = 0;
 int bind_initialized = 0;
 
+// How byte payloads are written into JSON, see ptp_set_bytes_mode
+enum BindBytesMode {
+	BIND_BYTES_ARRAY = 0,
+	BIND_BYTES_BASE64 = 1,
+};
+
+int bind_bytes_mode = BIND_BYTES_ARRAY;
+
 struct RouteMap {
 	char *name;
 	int (*call)(struct BindReq *, struct PtpRuntime *);
 };
 
+// Write a byte payload at bind->buffer + curr, either as a JSON array of integers
+// or a base64 string. Returns the new length, or -1 if the buffer is too small.
+static int bind_write_bytes(struct BindReq *bind, int curr, uint8_t *data, int length) {
+	if (bind_bytes_mode == BIND_BYTES_BASE64) {
+		// Quotes and the closing "}" must also fit
+		if (curr + ptp_base64_length(length) + 3 >= bind->max) return -1;
+		bind->buffer[curr++] = '\"';
+		curr += ptp_base64_encode(bind->buffer + curr, data, length);
+		bind->buffer[curr++] = '\"';
+		bind->buffer[curr] = '\0';
+		return curr;
+	}
+
+	// Worst case is 4 chars per byte ("255,")
+	if (curr + (length * 4) + 3 >= bind->max) return -1;
+	curr += sprintf(bind->buffer + curr, "[");
+	for (int i = 0; i < length; i++) {
+		char *comma = "";
+		if (i) comma = ",";
+		curr += sprintf(bind->buffer + curr, "%s%u", comma, data[i]);
+	}
+	curr += sprintf(bind->buffer + curr, "]");
+	return curr;
+}
+
 int bind_status(struct BindReq *bind, struct PtpRuntime *r) {
 	return sprintf(bind->buffer, "{\"error\": 0, \"initialized\": %d, \"connected\": %d, \"platform\": \"%s\"}",
 		bind_initialized, bind_connected, CAMLIB_PLATFORM);
 }
 
+static struct PtpCatalog bind_catalog;
+
+static void bind_stop_threads(struct PtpRuntime *r);
+
 int bind_init(struct BindReq *bind, struct PtpRuntime *r) {
 	if (bind_initialized) {
+		// Background threads use everything that's about to be freed
+		bind_stop_threads(r);
+		ptp_lock_close(r);
+		ptp_buffer_pool_close(r);
+		ptp_object_cache_close(r);
 		free(r->data);
+		free(r->props);
+		free(r->arena.base);
 		if (r->di != NULL) free(r->di);
 	}
 
 	memset(r, 0, sizeof(struct PtpRuntime));
 	r->data = malloc(CAMLIB_DEFAULT_SIZE);
 	r->data_length = CAMLIB_DEFAULT_SIZE;
+	r->props = calloc(1, sizeof(struct PtpPropStore));
+	r->arena.base = malloc(CAMLIB_ARENA_SIZE);
+	r->arena.size = CAMLIB_ARENA_SIZE;
 	r->di = NULL;
+	ptp_lock_init(r);
 	bind_initialized = 1;
 
 	return sprintf(bind->buffer, "{\"error\": %d, \"buffer\": %d}", 0, r->data_length);
@@ -48,6 +96,7 @@ int bind_connect(struct BindReq *bind, struct PtpRuntime *r) {
 
 	r->transaction = 0;
 	r->session = 0;
+	ptp_prop_store_reset(r);
 
 	int x = ptp_device_init(r);
 	if (!x) bind_connected = 1;
@@ -141,6 +190,134 @@ int bind_get_object_info(struct BindReq *bind, struct PtpRuntime *r) {
 	return len;
 }
 
+int bind_catalog_scan(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = ptp_catalog_scan(r, &bind_catalog, bind->params[0]);
+	if (x < 0) return sprintf(bind->buffer, "{\"error\": %d}", x);
+	return sprintf(bind->buffer, "{\"error\": 0, \"resp\": %d}", x);
+}
+
+static int bind_catalog_rows(struct BindReq *bind, uint32_t *rows, int length) {
+	if (length < 0) return sprintf(bind->buffer, "{\"error\": %d}", length);
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	int x = ptp_catalog_json(&bind_catalog, rows, length, bind->buffer + len, bind->max - len - 2);
+	if (x < 0) return sprintf(bind->buffer, "{\"error\": %d}", x);
+	len += x;
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+int bind_catalog_list(struct BindReq *bind, struct PtpRuntime *r) {
+	uint32_t *rows;
+	int n = ptp_catalog_children(&bind_catalog, bind->params[0], &rows);
+	return bind_catalog_rows(bind, rows, n);
+}
+
+int bind_catalog_newest(struct BindReq *bind, struct PtpRuntime *r) {
+	uint32_t *rows;
+	int n = ptp_catalog_newest(&bind_catalog, bind->params[0], &rows);
+	return bind_catalog_rows(bind, rows, n);
+}
+
+int bind_catalog_format(struct BindReq *bind, struct PtpRuntime *r) {
+	uint32_t *rows;
+	int n = ptp_catalog_with_format(&bind_catalog, bind->params[0], &rows);
+	return bind_catalog_rows(bind, rows, n);
+}
+
+// Fetch objects added since the last scan or sync
+int bind_catalog_sync(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = ptp_object_cache_sync(r);
+	if (x < 0) return sprintf(bind->buffer, "{\"error\": %d}", x);
+	return sprintf(bind->buffer, "{\"error\": 0, \"resp\": %d, \"stale\": %d}", x, bind_catalog.stale);
+}
+
+// Off by default: without events (ptp_get_events) handle lists go stale
+// after a capture on most bodies. Also needed for ptp_catalog_sync.
+int bind_cache_enable(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = 0;
+	ptp_lock(r);
+	if (bind->params[0]) {
+		x = ptp_object_cache_init(r);
+		ptp_object_cache_attach(r, &bind_catalog);
+	} else {
+		ptp_object_cache_close(r);
+	}
+	ptp_unlock(r);
+
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_cache_stats(struct BindReq *bind, struct PtpRuntime *r) {
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_object_cache_json(r, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+static struct PtpTether bind_tether;
+
+// Files are saved in the directory given as the string
+int bind_tether_start(struct BindReq *bind, struct PtpRuntime *r) {
+	if (strlen(bind->string) == 0) return sprintf(bind->buffer, "{\"error\": %d}", PTP_RUNTIME_ERR);
+	int x = ptp_tether_start(r, &bind_tether, bind->string);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_tether_stop(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = ptp_tether_stop(r, &bind_tether);
+	if (x > 0) x = 0;
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_tether_shot(struct BindReq *bind, struct PtpRuntime *r) {
+	ptp_tether_shot(&bind_tether);
+	return sprintf(bind->buffer, "{\"error\": 0}");
+}
+
+int bind_tether_poll(struct BindReq *bind, struct PtpRuntime *r) {
+	if (!bind_tether.active) return sprintf(bind->buffer, "{\"error\": %d}", PTP_RUNTIME_ERR);
+	int x = ptp_tether_poll(r, &bind_tether);
+	if (x < 0) return sprintf(bind->buffer, "{\"error\": %d}", x);
+	return sprintf(bind->buffer, "{\"error\": 0, \"resp\": %d}", x);
+}
+
+int bind_tether_stats(struct BindReq *bind, struct PtpRuntime *r) {
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_tether_json(&bind_tether, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+static struct PtpTimelapse bind_timelapse;
+
+// params: interval ms, frames, keepalive ms, thread priority
+// Downloads are done between shots if tether mode is on
+int bind_timelapse_start(struct BindReq *bind, struct PtpRuntime *r) {
+	if (bind_timelapse.running) return sprintf(bind->buffer, "{\"error\": %d}", PTP_RUNTIME_ERR);
+	ptp_timelapse_stop(r, &bind_timelapse);
+
+	bind_timelapse.interval = bind->params[0];
+	bind_timelapse.frames = bind->params[1];
+	bind_timelapse.keepalive = bind->params[2];
+	bind_timelapse.priority = bind->params[3];
+	bind_timelapse.tether = bind_tether.active ? &bind_tether : NULL;
+
+	int x = ptp_timelapse_start(r, &bind_timelapse);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_timelapse_stop(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = ptp_timelapse_stop(r, &bind_timelapse);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_timelapse_stats(struct BindReq *bind, struct PtpRuntime *r) {
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_timelapse_json(&bind_timelapse, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
 int bind_custom(struct BindReq *bind, struct PtpRuntime *r) {
 	struct PtpCommand cmd;
 	cmd.code = bind->params[0];
@@ -160,14 +337,11 @@ int bind_custom(struct BindReq *bind, struct PtpRuntime *r) {
 		return sprintf(bind->buffer, "{\"error\": %d}", x);
 	}
 
-	int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": %X, bytes: [");
-	for (int i = 0; i < ptp_get_payload_length(r); i++) {
-		char *comma = "";
-		if (i) comma = ",";
-		len += sprintf(bind->buffer + len, "%s%u", comma, ptp_get_payload(r)[i]);
-	}
+	int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": %d, \"bytes\": ", 0, ptp_get_return_code(r));
+	len = bind_write_bytes(bind, len, ptp_get_payload(r), ptp_get_payload_length(r));
+	if (len < 0) return sprintf(bind->buffer, "{\"error\": %d}", PTP_OUT_OF_MEM);
 
-	len += sprintf(bind->buffer + len, "]}");
+	len += sprintf(bind->buffer + len, "}");
 	return len;
 }
 
@@ -182,7 +356,136 @@ int bind_drive_lens(struct BindReq *bind, struct PtpRuntime *r) {
 	return sprintf(bind->buffer, "{\"error\": %d}", x);
 }
 
-int bind_get_liveview_frame(struct BindReq *bind, struct PtpRuntime *r) {
+// params: frames, step, moves per frame, settle min ms, settle max ms
+int bind_focus_stack(struct BindReq *bind, struct PtpRuntime *r) {
+	struct PtpFocusStack s;
+	memset(&s, 0, sizeof(s));
+	s.frames = bind->params[0];
+	s.step = bind->params[1];
+	s.moves = bind->params[2] ? bind->params[2] : 1;
+	s.settle_min = bind->params[3];
+	s.settle_max = bind->params[4] ? bind->params[4] : 1000;
+	s.tether = bind_tether.active ? &bind_tether : NULL;
+
+	int x = ptp_eos_focus_stack(r, &s);
+	int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": ", x);
+	len += ptp_focus_stack_json(&s, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+int bind_autofocus(struct BindReq *bind, struct PtpRuntime *r) {
+	struct PtpAutofocus af;
+	memset(&af, 0, sizeof(af));
+	af.x = bind->params[0];
+	af.y = bind->params[1];
+	af.w = bind->params[2];
+	af.h = bind->params[3];
+	af.settle = bind->params[4];
+	af.skip = 1;
+
+	int x = ptp_eos_autofocus(r, &af);
+	int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": ", x);
+	len += ptp_autofocus_json(&af, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+static struct PtpLiveviewThread bind_lv;
+static struct PtpRecorder bind_record;
+static struct PtpMjpegServer bind_mjpeg;
+
+// params: ring slots, thread priority
+int bind_liveview_thread_start(struct BindReq *bind, struct PtpRuntime *r) {
+	if (bind_lv.running) return sprintf(bind->buffer, "{\"error\": %d}", PTP_RUNTIME_ERR);
+
+	// The ring is freed and allocated again, nothing may still be reading it
+	ptp_recorder_stop(&bind_record);
+	ptp_mjpeg_server_stop(&bind_mjpeg);
+	ptp_liveview_thread_stop(r, &bind_lv);
+
+	bind_lv.slots = bind->params[0];
+	bind_lv.priority = bind->params[1];
+
+	int x = ptp_liveview_thread_start(r, &bind_lv);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_liveview_thread_stop(struct BindReq *bind, struct PtpRuntime *r) {
+	// These read from the ring
+	ptp_recorder_stop(&bind_record);
+	ptp_mjpeg_server_stop(&bind_mjpeg);
+	int x = ptp_liveview_thread_stop(r, &bind_lv);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_liveview_thread_stats(struct BindReq *bind, struct PtpRuntime *r) {
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_liveview_thread_json(&bind_lv, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+// string: file path, needs ptp_liveview_thread_start
+int bind_record_start(struct BindReq *bind, struct PtpRuntime *r) {
+	if (strlen(bind->string) == 0) return sprintf(bind->buffer, "{\"error\": %d}", PTP_RUNTIME_ERR);
+	int x = ptp_recorder_start(r, &bind_record, &bind_lv, bind->string);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_record_stop(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = ptp_recorder_stop(&bind_record);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_record_stats(struct BindReq *bind, struct PtpRuntime *r) {
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_recorder_json(&bind_record, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+// params: port (0 for any), listen on every interface
+int bind_mjpeg_start(struct BindReq *bind, struct PtpRuntime *r) {
+	if (bind_mjpeg.running) return sprintf(bind->buffer, "{\"error\": %d}", PTP_RUNTIME_ERR);
+	bind_mjpeg.port = bind->params[0];
+	bind_mjpeg.public = bind->params[1];
+	int x = ptp_mjpeg_server_start(r, &bind_mjpeg, &bind_lv);
+	return sprintf(bind->buffer, "{\"error\": %d, \"resp\": %d}", x, x ? 0 : bind_mjpeg.port);
+}
+
+int bind_mjpeg_stop(struct BindReq *bind, struct PtpRuntime *r) {
+	int x = ptp_mjpeg_server_stop(&bind_mjpeg);
+	return sprintf(bind->buffer, "{\"error\": %d}", x);
+}
+
+int bind_mjpeg_stats(struct BindReq *bind, struct PtpRuntime *r) {
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_mjpeg_server_json(&bind_mjpeg, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+static int bind_liveview_frame_now(struct BindReq *bind, struct PtpRuntime *r) {
+	// Encode straight from the response, no copy
+	if (ptp_liveview_type(r) == PTP_LV_EOS) {
+		// Only clients that get frames pay for the spare buffer
+		if (r->pool == NULL) {
+			int x = ptp_buffer_pool_init(r, 2);
+			if (x) return sprintf(bind->buffer, "{\"error\": %d}", x);
+		}
+
+		uint8_t *buffer, *frame;
+		int x = ptp_liveview_frame_take(r, &buffer, &frame);
+		int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": ", x < 0 ? x : 0);
+		len = bind_write_bytes(bind, len, frame, x > 0 ? x : 0);
+		ptp_buffer_release(r, buffer);
+		if (len < 0) return 0;
+
+		len += sprintf(bind->buffer + len, "}");
+		return len;
+	}
+
 	char *lv = malloc(ptp_liveview_size(r));
 	int x = ptp_liveview_frame(r, lv);
 
@@ -191,24 +494,40 @@ int bind_get_liveview_frame(struct BindReq *bind, struct PtpRuntime *r) {
 		err = 0;
 	}
 
-	char *inc = bind->buffer + sprintf(bind->buffer, "{\"error\": %d, \"resp\": [", err);
+	int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": ", err);
+	len = bind_write_bytes(bind, len, (uint8_t *)lv, x > 0 ? x : 0);
+	free(lv);
+	if (len < 0) return 0;
 
-	for (int i = 0; i < x; i++) {
-		if (inc - bind->buffer >= bind->max) {
-			return 0;
-		}
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
 
-		if (i > x - 2) {
-			inc += sprintf(inc, "%u", (uint8_t)lv[i]);
-		} else {
-			inc += sprintf(inc, "%u,", (uint8_t)lv[i]);
-		}
+// Readers of the ring go before the ring
+static void bind_stop_threads(struct PtpRuntime *r) {
+	ptp_recorder_stop(&bind_record);
+	ptp_mjpeg_server_stop(&bind_mjpeg);
+	ptp_liveview_thread_stop(r, &bind_lv);
+	ptp_timelapse_stop(r, &bind_timelapse);
+}
+
+// Not run under the lock, the newest frame from the thread needs no connection
+int bind_get_liveview_frame(struct BindReq *bind, struct PtpRuntime *r) {
+	if (bind_lv.thread == NULL) {
+		ptp_lock(r);
+		int len = bind_liveview_frame_now(bind, r);
+		ptp_unlock(r);
+		return len;
 	}
 
-	inc += sprintf(inc, "]}");
+	struct PtpLiveviewFrame *f = ptp_liveview_thread_take(&bind_lv, 0);
+	int len = sprintf(bind->buffer, "{\"error\": %d, \"resp\": ", bind_lv.running ? 0 : bind_lv.error);
+	len = bind_write_bytes(bind, len, f ? f->data : NULL, f ? f->length : 0);
+	if (f != NULL) ptp_liveview_thread_release(&bind_lv, f);
+	if (len < 0) return 0;
 
-	free(lv);
-	return inc - bind->buffer;
+	len += sprintf(bind->buffer + len, "}");
+	return len;
 }
 
 int bind_set_property(struct BindReq *bind, struct PtpRuntime *r) {
@@ -287,16 +606,71 @@ int bind_get_events(struct BindReq *bind, struct PtpRuntime *r) {
 	return sprintf(bind->buffer, "{\"error\": %d}", 0);
 }
 
+// Write properties from the store that changed after version since, and
+// the available values of those whose list changed.
+// Doesn't touch the device, ptp_get_events is what keeps the store updated.
+static int bind_props_json(struct BindReq *bind, struct PtpRuntime *r, uint32_t since) {
+	static struct PtpPropEntry *list[PTP_PROP_STORE_SIZE];
+	int length = ptp_prop_store_changed(r, since, list, PTP_PROP_STORE_SIZE);
+
+	int curr = snprintf(bind->buffer, bind->max, "{\"error\": 0, \"version\": %u, \"resp\": [",
+		ptp_prop_store_version(r));
+
+	char *comma = "";
+	for (int i = 0; i < length; i++) {
+		// Only the list has been seen so far
+		if (list[i]->version <= since) continue;
+
+		struct PtpCanonEvent ce;
+		ce.type = PTP_EC_EOS_PropValueChanged;
+		ce.code = list[i]->code;
+		ce.value = list[i]->value;
+		ce.data = list[i]->data;
+		ce.data_length = list[i]->data_length;
+
+		curr += snprintf(bind->buffer + curr, bind->max - curr, "%s", comma);
+		curr += ptp_eos_prop_json(&ce, bind->buffer + curr, bind->max - curr);
+		if (curr >= bind->max) return 0;
+		comma = ",";
+	}
+
+	curr += snprintf(bind->buffer + curr, bind->max - curr, "], \"avail\": [");
+	if (curr >= bind->max) return 0;
+
+	comma = "";
+	for (int i = 0; i < length; i++) {
+		if (list[i]->avail_version <= since) continue;
+
+		curr += snprintf(bind->buffer + curr, bind->max - curr, "%s", comma);
+		curr += ptp_eos_avail_json(list[i], bind->buffer + curr, bind->max - curr);
+		if (curr >= bind->max) return 0;
+		comma = ",";
+	}
+
+	curr += snprintf(bind->buffer + curr, bind->max - curr, "]}");
+	if (curr >= bind->max) return 0;
+	return curr;
+}
+
 int bind_get_all_props(struct BindReq *bind, struct PtpRuntime *r) {
 	int dev = ptp_device_type(r);
 	if (dev == PTP_DEV_EOS) {
-		return bind_get_events(bind, r);
+		return bind_props_json(bind, r, 0);
 	} else {
 		return sprintf(bind->buffer, "{\"error\": 0, \"resp\": []}");
 		// TODO: loop through all camera devinfo properties
 	}
 }
 
+// Properties that changed after the version given in the first parameter
+int bind_get_changed_props(struct BindReq *bind, struct PtpRuntime *r) {
+	if (ptp_device_type(r) != PTP_DEV_EOS) {
+		return sprintf(bind->buffer, "{\"error\": 0, \"version\": 0, \"resp\": [], \"avail\": []}");
+	}
+
+	return bind_props_json(bind, r, (uint32_t)bind->params[0]);
+}
+
 int bind_get_liveview_type(struct BindReq *bind, struct PtpRuntime *r) {
 	return sprintf(bind->buffer, "{\"error\": %d, \"resp\": %d}", 0, ptp_liveview_type(r));
 }
@@ -392,6 +766,51 @@ int bind_bulb_stop(struct BindReq *bind, struct PtpRuntime *r) {
 	return sprintf(bind->buffer, "{\"error\": %d}", x);
 }
 
+// params[0] is the exposure time in ms
+int bind_bulb_exposure(struct BindReq *bind, struct PtpRuntime *r) {
+	struct PtpBulbResult res;
+	int x = ptp_eos_bulb_exposure(r, bind->params[0], &res);
+	if (x) return sprintf(bind->buffer, "{\"error\": %d}", x);
+
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_bulb_json(&res, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+// params[0] selects the property (0 shutter, 1 aperture, 2 iso), and
+// string is a comma separated list of values, one frame each
+int bind_bracket(struct BindReq *bind, struct PtpRuntime *r) {
+	static struct PtpBracketFrame frames[PTP_BRACKET_MAX];
+	static struct PtpBracketResult res;
+
+	int length = 0;
+	char *s = bind->string;
+	while (*s != '\0' && length < PTP_BRACKET_MAX) {
+		int value = strtol(s, &s, 10);
+		frames[length].shutter = -1;
+		frames[length].aperture = -1;
+		frames[length].iso = -1;
+		switch (bind->params[0]) {
+		case 0: frames[length].shutter = value; break;
+		case 1: frames[length].aperture = value; break;
+		case 2: frames[length].iso = value; break;
+		default: return sprintf(bind->buffer, "{\"error\": %d}", PTP_UNSUPPORTED);
+		}
+		length++;
+		if (*s != ',') break;
+		s++;
+	}
+
+	int x = ptp_eos_bracket(r, frames, length, &res);
+	if (x) return sprintf(bind->buffer, "{\"error\": %d}", x);
+
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_bracket_json(&res, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
 int bind_pre_take_picture(struct BindReq *bind, struct PtpRuntime *r) {
 	int x = 0;
 	if (ptp_device_type(r) == PTP_DEV_EOS) {
@@ -403,23 +822,40 @@ int bind_pre_take_picture(struct BindReq *bind, struct PtpRuntime *r) {
 }
 
 int bind_take_picture(struct BindReq *bind, struct PtpRuntime *r) {
-	int x = 0;
-	if (ptp_check_opcode(r, PTP_OC_InitiateCapture)) {
-		x = ptp_init_capture(r, 0, 0);
-	} else if (ptp_device_type(r) == PTP_DEV_EOS) {
-		x = ptp_eos_remote_release_on(r, 2);
-		if (ptp_get_return_code(r) != PTP_RC_OK) return sprintf(bind->buffer, "{\"error\": %d}", PTP_CHECK_CODE);
-		x = ptp_eos_remote_release_off(r, 2);
-		if (ptp_get_return_code(r) != PTP_RC_OK) return sprintf(bind->buffer, "{\"error\": %d}", PTP_CHECK_CODE);
-		x = ptp_eos_remote_release_off(r, 1);
-		if (ptp_get_return_code(r) != PTP_RC_OK) return sprintf(bind->buffer, "{\"error\": %d}", PTP_CHECK_CODE);
-	} else {
-		x = PTP_UNSUPPORTED;
-	}
-
+	int x = ptp_take_picture(r);
 	return sprintf(bind->buffer, "{\"error\": %d}", x);
 }
 
+static struct PtpBurst bind_burst_state;
+
+// params[0] shots, params[1] interval in ms, files are saved to string if set
+int bind_burst(struct BindReq *bind, struct PtpRuntime *r) {
+	struct PtpBurst *b = &bind_burst_state;
+	int x = ptp_burst(r, b, bind->params[0], bind->params[1], bind->string);
+	if (x < 0) return sprintf(bind->buffer, "{\"error\": %d}", x);
+
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"resp\": ");
+	len += ptp_burst_json(b, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
+// Wait for the object from the last capture, params[0] is a timeout in ms
+int bind_wait_new_object(struct BindReq *bind, struct PtpRuntime *r) {
+	if (ptp_device_type(r) != PTP_DEV_EOS) return sprintf(bind->buffer, "{\"error\": %d}", PTP_UNSUPPORTED);
+
+	uint32_t handle;
+	struct PtpObjectInfo oi;
+	int x = ptp_eos_wait_object(r, bind->params[0], &handle, &oi);
+	if (x < 0) return sprintf(bind->buffer, "{\"error\": %d}", x);
+	if (x == 0) return sprintf(bind->buffer, "{\"error\": 0, \"resp\": null}");
+
+	int len = sprintf(bind->buffer, "{\"error\": 0, \"handle\": %u, \"size\": %u, \"resp\": ", handle, oi.compressed_size);
+	len += ptp_object_info_json(&oi, bind->buffer + len, bind->max - len - 2);
+	len += sprintf(bind->buffer + len, "}");
+	return len;
+}
+
 int bind_cancel_af(struct BindReq *bind, struct PtpRuntime *r) {
 	int x = 0;
 	if (ptp_check_opcode(r, PTP_OC_EOS_AfCancel)) {
@@ -506,15 +942,11 @@ int bind_get_thumbnail(struct BindReq *bind, struct PtpRuntime *r) {
 		return sprintf(bind->buffer, "{\"error\": %d}", PTP_CHECK_CODE);
 	}
 
-	int curr = sprintf(bind->buffer, "{\"error\": 0, \"jpeg\": [");
+	int curr = sprintf(bind->buffer, "{\"error\": 0, \"jpeg\": ");
+	curr = bind_write_bytes(bind, curr, ptp_get_payload(r), ptp_get_payload_length(r));
+	if (curr < 0) return sprintf(bind->buffer, "{\"error\": %d}", PTP_OUT_OF_MEM);
 
-	for (int i = 0; i < ptp_get_payload_length(r); i++) {
-		char *comma = "";
-		if (i) comma = ",";
-		curr += sprintf(bind->buffer + curr, "%s%u", comma, ((uint8_t *)ptp_get_payload(r))[i]);		
-	}
-
-	curr += sprintf(bind->buffer + curr, "]}");
+	curr += sprintf(bind->buffer + curr, "}");
 	return curr;
 }
 
@@ -529,16 +961,22 @@ int bind_get_partial_object(struct BindReq *bind, struct PtpRuntime *r) {
 		return sprintf(bind->buffer, "{\"error\": %d}", PTP_CHECK_CODE);
 	}
 
-	int curr = sprintf(bind->buffer, "{\"error\": 0, \"data\": [");
+	int curr = sprintf(bind->buffer, "{\"error\": 0, \"data\": ");
+	curr = bind_write_bytes(bind, curr, ptp_get_payload(r), ptp_get_payload_length(r));
+	if (curr < 0) return sprintf(bind->buffer, "{\"error\": %d}", PTP_OUT_OF_MEM);
 
-	for (int i = 0; i < ptp_get_payload_length(r); i++) {
-		char *comma = "";
-		if (i) comma = ",";
-		curr += sprintf(bind->buffer + curr, "%s%u", comma, ((uint8_t *)ptp_get_payload(r))[i]);		
+	curr += sprintf(bind->buffer + curr, "}");
+	return curr;
+}
+
+// 0: bytes are returned as an array of integers, 1: as a base64 string
+int bind_set_bytes_mode(struct BindReq *bind, struct PtpRuntime *r) {
+	if (bind->params[0] != BIND_BYTES_ARRAY && bind->params[0] != BIND_BYTES_BASE64) {
+		return sprintf(bind->buffer, "{\"error\": %d}", PTP_UNSUPPORTED);
 	}
 
-	curr += sprintf(bind->buffer + curr, "]}");
-	return curr;
+	bind_bytes_mode = bind->params[0];
+	return sprintf(bind->buffer, "{\"error\": %d}", 0);
 }
 
 int bind_download_file(struct BindReq *bind, struct PtpRuntime *r) {
@@ -565,9 +1003,13 @@ struct RouteMap routes[] = {
 
 	{"ptp_pre_take_picture", bind_pre_take_picture},
 	{"ptp_take_picture", bind_take_picture},
+	{"ptp_wait_new_object", bind_wait_new_object},
+	{"ptp_burst", bind_burst},
 
 	{"ptp_bulb_start", bind_bulb_start},
 	{"ptp_bulb_stop", bind_bulb_stop},
+	{"ptp_bulb_exposure", bind_bulb_exposure},
+	{"ptp_bracket", bind_bracket},
 
 	{"ptp_eos_set_remote_mode", bind_eos_set_remote_mode},
 	{"ptp_eos_set_event_mode", bind_eos_set_event_mode},
@@ -577,6 +1019,8 @@ struct RouteMap routes[] = {
 	{"ptp_mirror_up", bind_mirror_up},
 	{"ptp_mirror_down", bind_mirror_down},
 	{"ptp_drive_lens", bind_drive_lens},
+	{"ptp_focus_stack", bind_focus_stack},
+	{"ptp_autofocus", bind_autofocus},
 	{"ptp_get_liveview_frame", bind_get_liveview_frame},
 	{"ptp_get_liveview_type", bind_get_liveview_type},
 	{"ptp_get_liveview_frame.jpg", bind_get_liveview_frame_jpg},
@@ -585,6 +1029,7 @@ struct RouteMap routes[] = {
 	{"ptp_get_device_type", bind_get_device_type},
 	{"ptp_get_events", bind_get_events},
 	{"ptp_get_all_props", bind_get_all_props},
+	{"ptp_get_changed_props", bind_get_changed_props},
 	{"ptp_set_property", bind_set_property},
 	{"ptp_get_enums", bind_get_enums},
 	{"ptp_get_status", bind_get_status},
@@ -597,6 +1042,31 @@ struct RouteMap routes[] = {
 	{"ptp_get_partial_object", bind_get_partial_object},
 	{"ptp_download_file", bind_download_file},
 	{"ptp_custom", bind_custom},
+	{"ptp_set_bytes_mode", bind_set_bytes_mode},
+	{"ptp_catalog_scan", bind_catalog_scan},
+	{"ptp_catalog_list", bind_catalog_list},
+	{"ptp_catalog_newest", bind_catalog_newest},
+	{"ptp_catalog_format", bind_catalog_format},
+	{"ptp_catalog_sync", bind_catalog_sync},
+	{"ptp_cache_enable", bind_cache_enable},
+	{"ptp_cache_stats", bind_cache_stats},
+	{"ptp_tether_start", bind_tether_start},
+	{"ptp_tether_stop", bind_tether_stop},
+	{"ptp_tether_shot", bind_tether_shot},
+	{"ptp_tether_poll", bind_tether_poll},
+	{"ptp_tether_stats", bind_tether_stats},
+	{"ptp_timelapse_start", bind_timelapse_start},
+	{"ptp_timelapse_stop", bind_timelapse_stop},
+	{"ptp_timelapse_stats", bind_timelapse_stats},
+	{"ptp_liveview_thread_start", bind_liveview_thread_start},
+	{"ptp_liveview_thread_stop", bind_liveview_thread_stop},
+	{"ptp_liveview_thread_stats", bind_liveview_thread_stats},
+	{"ptp_record_start", bind_record_start},
+	{"ptp_record_stop", bind_record_stop},
+	{"ptp_record_stats", bind_record_stats},
+	{"ptp_mjpeg_start", bind_mjpeg_start},
+	{"ptp_mjpeg_stop", bind_mjpeg_stop},
+	{"ptp_mjpeg_stats", bind_mjpeg_stats},
 };
 
 static int isDigit(char c) {return c >= '0' && c <= '9';}
@@ -695,7 +1165,17 @@ int bind_run_req(struct PtpRuntime *r, struct BindReq *bind, char *buffer, int m
 
 	for (int i = 0; i < (int)(sizeof(routes) / sizeof(struct RouteMap)); i++) {
 		if (!strcmp(routes[i].name, bind->name)) {
-			return routes[i].call(bind, r);
+			// Frees the lock, waits for a thread that needs it, or locks itself
+			if (routes[i].call == bind_init || routes[i].call == bind_timelapse_stop ||
+					routes[i].call == bind_liveview_thread_stop || routes[i].call == bind_get_liveview_frame) {
+				return routes[i].call(bind, r);
+			}
+
+			// Background threads (timelapse) share the connection
+			ptp_lock(r);
+			int x = routes[i].call(bind, r);
+			ptp_unlock(r);
+			return x;
 		}
 	}
 
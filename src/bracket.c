@@ -0,0 +1,103 @@
+// Exposure bracketing - settings change between frames without round trips to the app
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// The camera refuses changes while it is still writing the last frame
+#define PTP_BRACKET_BUSY_WAIT 5
+#define PTP_BRACKET_BUSY_TIMEOUT 5000
+
+// Retry while the camera reports DeviceBusy
+static int bracket_set(struct PtpRuntime *r, int code, int data) {
+	for (int t = 0; t < PTP_BRACKET_BUSY_TIMEOUT; t += PTP_BRACKET_BUSY_WAIT) {
+		int x = ptp_eos_set_prop_value(r, code, data);
+		if (x != PTP_CHECK_CODE || ptp_get_return_code(r) != PTP_RC_DeviceBusy) return x;
+		CAMLIB_SLEEP(PTP_BRACKET_BUSY_WAIT);
+	}
+
+	return PTP_CHECK_CODE;
+}
+
+// Full press and release, focus stays locked by the half press
+static int bracket_release(struct PtpRuntime *r) {
+	int x = PTP_CHECK_CODE;
+	for (int t = 0; t < PTP_BRACKET_BUSY_TIMEOUT; t += PTP_BRACKET_BUSY_WAIT) {
+		x = ptp_eos_remote_release_on(r, 2);
+		if (x != PTP_CHECK_CODE || ptp_get_return_code(r) != PTP_RC_DeviceBusy) break;
+		CAMLIB_SLEEP(PTP_BRACKET_BUSY_WAIT);
+	}
+
+	if (x) return x;
+	return ptp_eos_remote_release_off(r, 2);
+}
+
+int ptp_eos_bracket(struct PtpRuntime *r, struct PtpBracketFrame *frames, int length, struct PtpBracketResult *res) {
+	if (ptp_device_type(r) != PTP_DEV_EOS) return PTP_UNSUPPORTED;
+	if (length < 0 || length > PTP_BRACKET_MAX) return PTP_RUNTIME_ERR;
+
+	memset(res, 0, sizeof(struct PtpBracketResult));
+
+	// Convert everything before the first frame, -1 stays -1
+	int data[PTP_BRACKET_MAX][3];
+	for (int i = 0; i < length; i++) {
+		data[i][0] = frames[i].shutter < 0 ? -1 : ptp_eos_get_shutter(frames[i].shutter, 1);
+		data[i][1] = frames[i].aperture < 0 ? -1 : ptp_eos_get_aperture(frames[i].aperture, 1);
+		data[i][2] = frames[i].iso < 0 ? -1 : ptp_eos_get_iso(frames[i].iso, 1);
+	}
+
+	static const int codes[3] = {PTP_PC_EOS_ShutterSpeed, PTP_PC_EOS_Aperture, PTP_PC_EOS_ISOSpeed};
+	int current[3] = {-1, -1, -1};
+
+	ptp_lock(r);
+
+	int x = ptp_eos_remote_release_on(r, 1);
+	if (x) goto end;
+
+	res->start = ptp_time_us();
+	for (int i = 0; i < length; i++) {
+		// Only what differs from the last frame is sent
+		for (int p = 0; p < 3; p++) {
+			if (data[i][p] == -1 || data[i][p] == current[p]) continue;
+			x = bracket_set(r, codes[p], data[i][p]);
+			if (x) goto end;
+			current[p] = data[i][p];
+			res->changes++;
+		}
+
+		res->frame[i].set = ptp_time_us();
+
+		x = bracket_release(r);
+		if (x) goto end;
+
+		res->frame[i].fired = ptp_time_us();
+		res->length++;
+	}
+
+	end:;
+	res->end = ptp_time_us();
+	int y = ptp_eos_remote_release_off(r, 1);
+	ptp_unlock(r);
+	return x ? x : y;
+}
+
+int ptp_bracket_json(struct PtpBracketResult *res, char *buffer, int max) {
+	double total = (res->end - res->start) / 1000.0;
+	double fps = total > 0 ? res->length / (total / 1000.0) : 0;
+	int curr = snprintf(buffer, max, "{\"frames\": %d, \"changes\": %d, \"total\": %.1f, \"fps\": %.2f, \"times\": [",
+		res->length, res->changes, total, fps);
+
+	// [settings applied, frame taken] in ms from the start
+	for (int i = 0; i < res->length; i++) {
+		curr += snprintf(buffer + curr, max - curr, "%s[%.1f, %.1f]", i ? ", " : "",
+			(res->frame[i].set - res->start) / 1000.0, (res->frame[i].fired - res->start) / 1000.0);
+		if (curr >= max) return max;
+	}
+
+	curr += snprintf(buffer + curr, max - curr, "]}");
+	return curr;
+}
@@ -0,0 +1,127 @@
+// Bulb exposures timed by camlib instead of the caller
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// Priority of the thread that ends the exposure, if allowed
+#define PTP_BULB_PRIORITY 10
+
+struct BulbPacket {
+	uint8_t data[32];
+	int length;
+};
+
+struct BulbArgs {
+	struct PtpRuntime *r;
+	struct BulbPacket *stop;
+	struct PtpBulbResult *res;
+	uint64_t deadline;
+	int error;
+};
+
+// Commands are built ahead of time, so sending is only a copy
+static void bulb_build(struct PtpRuntime *r, struct BulbPacket *p, int code, int mode, int params) {
+	struct PtpCommand cmd;
+	cmd.code = code;
+	cmd.param_length = params;
+	cmd.params[0] = mode;
+	cmd.params[1] = 0;
+	p->length = ptp_new_cmd_packet(r, &cmd);
+	memcpy(p->data, r->data, p->length);
+}
+
+static int bulb_send(struct PtpRuntime *r, struct BulbPacket *p, uint64_t *sent, uint64_t *ack) {
+	memcpy(r->data, p->data, p->length);
+	*sent = ptp_time_us();
+	if (ptp_send_bulk_packets(r, p->length) != p->length) return PTP_IO_ERR;
+	if (ptp_recieve_bulk_packets(r) < 0) return PTP_IO_ERR;
+	*ack = ptp_time_us();
+	if (ptp_get_return_code(r) != PTP_RC_OK) return PTP_CHECK_CODE;
+	return 0;
+}
+
+static void *bulb_thread(void *arg) {
+	struct BulbArgs *a = arg;
+	ptp_sleep_until(a->deadline);
+	a->error = bulb_send(a->r, a->stop, &a->res->close_sent, &a->res->close_ack);
+	return NULL;
+}
+
+int ptp_eos_bulb_exposure(struct PtpRuntime *r, int duration, struct PtpBulbResult *res) {
+	if (ptp_device_type(r) != PTP_DEV_EOS) return PTP_UNSUPPORTED;
+
+	memset(res, 0, sizeof(struct PtpBulbResult));
+	res->duration = duration;
+
+	// Nothing else may be sent until the shutter is closed again
+	ptp_lock(r);
+
+	struct BulbPacket half, full, stop, release;
+	bulb_build(r, &half, PTP_OC_EOS_RemoteReleaseOn, 1, 2);
+	bulb_build(r, &full, PTP_OC_EOS_RemoteReleaseOn, 2, 2);
+	bulb_build(r, &stop, PTP_OC_EOS_RemoteReleaseOff, 2, 1);
+	bulb_build(r, &release, PTP_OC_EOS_RemoteReleaseOff, 1, 1);
+
+	uint64_t sent, ack;
+	int x = bulb_send(r, &half, &sent, &ack);
+	if (x) {
+		ptp_unlock(r);
+		return x;
+	}
+
+	x = bulb_send(r, &full, &res->open_sent, &res->open_ack);
+	if (x == PTP_IO_ERR) {
+		ptp_unlock(r);
+		return x;
+	}
+
+	// The shutter opens somewhere between sending and the response
+	uint64_t open = (res->open_sent + res->open_ack) / 2;
+
+	struct BulbArgs a;
+	a.r = r;
+	a.stop = &stop;
+	a.res = res;
+	a.deadline = open + ((uint64_t)duration * 1000);
+	a.error = 0;
+
+	if (x == 0) {
+		// This thread holds the lock and waits, so the stop thread has the connection
+		void *thread;
+		int rt = ptp_thread_start(&thread, bulb_thread, &a, PTP_BULB_PRIORITY);
+		if (rt < 0) {
+			bulb_thread(&a);
+		} else {
+			res->realtime = rt;
+			ptp_thread_join(thread);
+		}
+		x = a.error;
+	} else {
+		// Make sure the shutter isn't left open
+		bulb_send(r, &stop, &res->close_sent, &res->close_ack);
+	}
+
+	int y = bulb_send(r, &release, &sent, &ack);
+	ptp_unlock(r);
+	if (x) return x;
+	if (y) return y;
+
+	uint64_t close = (res->close_sent + res->close_ack) / 2;
+	res->measured = close - open;
+	res->error = (int64_t)res->measured - ((int64_t)duration * 1000);
+
+	// Half of each round trip, the most the estimate could be off by
+	res->uncertainty = ((res->open_ack - res->open_sent) + (res->close_ack - res->close_sent)) / 2;
+
+	return 0;
+}
+
+int ptp_bulb_json(struct PtpBulbResult *res, char *buffer, int max) {
+	return snprintf(buffer, max, "{\"duration\": %d, \"measured\": %.3f, \"error\": %.3f, \"uncertainty\": %.3f, \"realtime\": %d}",
+		res->duration, res->measured / 1000.0, res->error / 1000.0, res->uncertainty / 1000.0, res->realtime);
+}
@@ -36,6 +36,9 @@
 // 2mb recommended default buffer size
 #define CAMLIB_DEFAULT_SIZE 2000000
 
+// Default arena size, enough for every property description on most cameras
+#define CAMLIB_ARENA_SIZE 256000
+
 // Generic Camlib errors, not PTP return codes
 enum PtpGeneralError {
 	PTP_OK = 0,
@@ -61,6 +64,15 @@ enum PtpLiveViewType {
 	PTP_LV_ML = 3,
 };
 
+// Output of ptp_yuv444_convert
+enum PtpPixelFormat {
+	PTP_PIXEL_YUVA = 0, // Y, signed U, signed V, alpha - ptp_liveview_frame on ML
+	PTP_PIXEL_RGBA = 1,
+	PTP_PIXEL_BGRA = 2,
+	PTP_PIXEL_NV12 = 3, // Y plane, then interleaved UV at half size
+	PTP_PIXEL_I420 = 4, // Y, U and V planes, chroma at half size
+};
+
 // Detect device type - each category should have similar opcodes
 enum PtpVendors {
 	PTP_DEV_EMPTY = 0,
@@ -81,6 +93,40 @@ enum ImageFormats {
 	IMG_FORMAT_RAW_JPEG = 4,
 };
 
+// Bump allocator owned by the runtime. Parsers that need variable
+// amounts of memory take it from here instead of calling malloc.
+struct PtpArena {
+	uint8_t *base;
+	int size;
+	int used;
+
+	// Last ptp_get_prop_desc, freed by the next one if nothing came after it
+	int desc_start;
+	int desc_end;
+};
+
+struct PtpRuntime;
+struct PtpBufferPool;
+struct PtpObjectCache;
+struct PtpLock;
+struct PtpTether;
+
+// Resumable parser for a data phase that is still arriving. The backend calls
+// feed each time more packets land in r->data, with the number of payload
+// bytes that are valid so far. feed must only consume complete elements and
+// remember where it stopped in offset. done is set on the final call.
+// feed runs inside the transaction, so it must not send any commands.
+struct PtpStreamParser {
+	int (*feed)(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done);
+
+	// Payload bytes consumed so far
+	int offset;
+
+	// Number of elements produced, or an error from feed
+	int count;
+	int error;
+};
+
 struct PtpRuntime {
 	int active_connection;
 
@@ -102,6 +148,27 @@ struct PtpRuntime {
 	// For Windows compatibility, this is set to indicate lenth for a data packet
 	// that will be sent after a command packet. Will be set to zero when ptp_send_bulk_packets is called.
 	int data_phase_length;
+
+	// Last known property values, updated from events (see ptp_prop_store_update)
+	struct PtpPropStore *props;
+
+	struct PtpArena arena;
+
+	// Optional, set for the duration of a transaction to parse the
+	// data phase while it is being received (see ptp_stream_feed)
+	struct PtpStreamParser *stream;
+
+	// Optional spare buffers the size of data, see ptp_buffer_take
+	struct PtpBufferPool *pool;
+
+	// Optional, see ptp_object_cache_init
+	struct PtpObjectCache *cache;
+
+	// Optional, see ptp_lock_init
+	struct PtpLock *lock;
+
+	// Set while tethering, see ptp_tether_start
+	struct PtpTether *tether;
 };
 
 // Generic command structure - not a packet
@@ -149,6 +216,12 @@ uint32_t ptp_get_param(struct PtpRuntime *r, int index);
 int ptp_get_param_length(struct PtpRuntime *r);
 int ptp_get_last_transaction(struct PtpRuntime *r);
 
+// Called by backends after every packet, read is the number of bytes
+// received into r->data so far. ptp_stream_finish delivers the rest once
+// the transaction is complete, for backends that can't stream.
+void ptp_stream_feed(struct PtpRuntime *r, int read);
+void ptp_stream_finish(struct PtpRuntime *r);
+
 // Get ptr of packet payload, after header (includes parameters)
 uint8_t *ptp_get_payload(struct PtpRuntime *r);
 int ptp_get_payload_length(struct PtpRuntime *r);
@@ -169,9 +242,66 @@ int ptp_device_type(struct PtpRuntime *r);
 int ptp_check_opcode(struct PtpRuntime *r, int op);
 int ptp_check_prop(struct PtpRuntime *r, int code);
 
+// Arena allocation, returns NULL when full. Memory is 8 byte aligned.
+void *ptp_arena_alloc(struct PtpRuntime *r, int size);
+void ptp_arena_reset(struct PtpRuntime *r);
+
+// Save and restore the arena position, for temporary allocations
+int ptp_arena_mark(struct PtpRuntime *r);
+void ptp_arena_rewind(struct PtpRuntime *r, int mark);
+
+// Optional multi buffer mode. count buffers (including r->data) are kept,
+// all data_length bytes. After a transaction, ptp_buffer_take hands the
+// response buffer to the caller and gives r->data a spare one, so the next
+// command can be sent while the old response is still being parsed or drawn.
+// Take returns NULL if every spare is in use. Release may be called from any
+// thread. Every buffer must be released before ptp_generic_close.
+int ptp_buffer_pool_init(struct PtpRuntime *r, int count);
+void ptp_buffer_pool_close(struct PtpRuntime *r);
+uint8_t *ptp_buffer_take(struct PtpRuntime *r);
+void ptp_buffer_release(struct PtpRuntime *r, uint8_t *buffer);
+
+// Same as ptp_get_payload/ptp_get_payload_length, for a taken buffer
+uint8_t *ptp_buffer_payload(uint8_t *buffer);
+int ptp_buffer_payload_length(uint8_t *buffer);
+
+// Needed when more than one thread talks to the camera (see ptp_timelapse_start).
+// Hold the lock for a whole sequence of commands. Lock and unlock do
+// nothing if ptp_lock_init wasn't called.
+int ptp_lock_init(struct PtpRuntime *r);
+void ptp_lock_close(struct PtpRuntime *r);
+void ptp_lock(struct PtpRuntime *r);
+void ptp_unlock(struct PtpRuntime *r);
+
+// Monotonic clock in microseconds, for timing and latency stats
+uint64_t ptp_time_us(void);
+
+// Sleep until an absolute ptp_time_us time
+void ptp_sleep_until(uint64_t us);
+
+// Start a thread, with SCHED_FIFO at priority if it's above 0 and allowed.
+// Returns 1 if it got the priority, 0 if it runs normally, or a negative error.
+int ptp_thread_start(void **thread, void *(*fn)(void *), void *arg, int priority);
+void ptp_thread_join(void *thread);
+
 // Write r->data to a file called DUMP
 int ptp_dump(struct PtpRuntime *r);
 
+// Base64 encoder - output is not null terminated, dst must have room
+// for ptp_base64_length(length) bytes. Returns the number of chars written.
+int ptp_base64_length(int length);
+int ptp_base64_encode(char *dst, const uint8_t *src, int length);
+int ptp_base64_encode_scalar(char *dst, const uint8_t *src, int length);
+
+// Convert packed YUV444 (ML liveview) into dst, which must hold
+// ptp_yuv444_size bytes. NV12 and I420 need an even width and height.
+// Returns the number of bytes written.
+int ptp_yuv444_size(int width, int height, int format);
+int ptp_yuv444_convert(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha);
+int ptp_yuv444_convert_scalar(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha);
+// Same for YUVA (4 byte) frames from ptp_liveview_frame, RGBA or BGRA only
+int ptp_yuva_convert(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha);
+
 // Badly named header files will be included in case
 // there is interference in the future
 #include "ptpdata.h"
@@ -38,7 +38,7 @@ int ptp_eos_drive_lens(struct PtpRuntime *r, int steps) {
 		steps = 0x8000 + (steps * -1);
 	}
 	
-	printf("%X\n", steps);
+	PTPLOG("Drive lens %X\n", steps);
 
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_EOS_DriveLens;
@@ -109,7 +109,61 @@ int ptp_eos_get_event(struct PtpRuntime *r) {
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_EOS_GetEvent;
 	cmd.param_length = 0;
-	return ptp_generic_send(r, &cmd);	
+	int x = ptp_generic_send(r, &cmd);
+	if (x) return x;
+
+	// Keep the host side property table and object cache in sync
+	ptp_prop_store_update(r);
+	ptp_object_cache_update(r);
+
+	// Any caller of GetEvent can see a transfer request, not just the tether poll
+	if (r->tether != NULL) ptp_tether_queue_events(r, r->tether);
+	return 0;
+}
+
+// Poll events until the camera reports a new object, usually after a capture.
+// Info comes from the ObjectAddedEx record, no GetObjectInfo is needed.
+// Returns 1 if an object was found, 0 on timeout.
+int ptp_eos_wait_object(struct PtpRuntime *r, int timeout, uint32_t *handle, struct PtpObjectInfo *oi) {
+	for (int t = 0; t <= timeout; t += 50) {
+		int x = ptp_eos_get_event(r);
+		if (x) return x;
+
+		struct PtpCanonEvent ce;
+		void *e = ptp_open_eos_events(r);
+		while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+			if (ce.type != PTP_EC_EOS_ObjectAddedEx) continue;
+			if (ptp_eos_object_info(&ce, oi)) continue;
+			*handle = ce.code;
+			return 1;
+		}
+
+		CAMLIB_SLEEP(50);
+	}
+
+	return 0;
+}
+
+// Same as ptp_eos_get_event, but fn is called for each record as soon as it
+// arrives, rather than after the whole response has been received.
+int ptp_eos_get_event_stream(struct PtpRuntime *r, int (*fn)(struct PtpRuntime *, struct PtpCanonEvent *, void *), void *arg) {
+	struct PtpEOSEventStream s;
+	memset(&s, 0, sizeof(s));
+	s.p.feed = ptp_eos_event_stream_feed;
+	s.fn = fn;
+	s.arg = arg;
+
+	struct PtpCommand cmd;
+	cmd.code = PTP_OC_EOS_GetEvent;
+	cmd.param_length = 0;
+
+	r->stream = &s.p;
+	int x = ptp_generic_send(r, &cmd);
+	r->stream = NULL;
+
+	if (x) return x;
+	if (s.p.error) return s.p.error;
+	return s.p.count;
 }
 
 int ptp_eos_ping(struct PtpRuntime *r) {
@@ -141,6 +195,14 @@ int ptp_eos_hdd_capacity_pop(struct PtpRuntime *r) {
 	return ptp_generic_send(r, &cmd);
 }
 
+int ptp_eos_transfer_complete(struct PtpRuntime *r, uint32_t handle) {
+	struct PtpCommand cmd;
+	cmd.code = PTP_OC_EOS_TransferComplete;
+	cmd.param_length = 1;
+	cmd.params[0] = handle;
+	return ptp_generic_send(r, &cmd);
+}
+
 int ptp_eos_bulb_start(struct PtpRuntime *r) {
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_EOS_BulbStart;
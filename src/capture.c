@@ -0,0 +1,239 @@
+// Capture pipeline - shoots a burst while earlier shots are downloaded
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// Downloads are split up so a trigger is never held back by more than one slice
+#define PTP_BURST_SLICE 1000000
+
+// Give up on objects that haven't shown up this long after the last shot
+#define PTP_BURST_TIMEOUT 10000000
+
+int ptp_take_picture(struct PtpRuntime *r) {
+	if (ptp_check_opcode(r, PTP_OC_InitiateCapture)) {
+		return ptp_init_capture(r, 0, 0);
+	} else if (ptp_device_type(r) == PTP_DEV_EOS) {
+		int x = ptp_eos_remote_release_on(r, 2);
+		if (x) return x;
+		x = ptp_eos_remote_release_off(r, 2);
+		if (x) return x;
+		return ptp_eos_remote_release_off(r, 1);
+	}
+
+	return PTP_UNSUPPORTED;
+}
+
+// New objects go to the oldest shot that doesn't have one yet. Extra
+// objects (RAW+JPEG) go to the newest shot.
+static void burst_object(struct PtpBurst *b, uint32_t handle, struct PtpObjectInfo *oi) {
+	if (oi->obj_format == PTP_OF_Association) return;
+	if (b->fired == 0) return;
+
+	uint64_t now = ptp_time_us();
+
+	int s = b->fired - 1;
+	for (int i = 0; i < b->fired; i++) {
+		if (b->shot[i].objects == 0) {
+			s = i;
+			break;
+		}
+	}
+
+	struct PtpBurstShot *shot = &b->shot[s];
+	if (shot->objects == 0) shot->landed = now;
+	shot->objects++;
+	b->last_object = now;
+
+	if (b->dir[0] == '\0') {
+		shot->saved = now;
+		return;
+	}
+
+	if (b->queue_length >= PTP_BURST_FILES) {
+		b->errors++;
+		return;
+	}
+
+	struct PtpBurstFile *f = &b->queue[b->queue_length];
+	memset(f, 0, sizeof(struct PtpBurstFile));
+	f->handle = handle;
+	f->shot = s;
+	f->size = oi->compressed_size;
+	snprintf(f->filename, sizeof(f->filename), "%s", oi->filename);
+	for (int i = 0; f->filename[i] != '\0'; i++) {
+		if (f->filename[i] == '/' || f->filename[i] == '\\') f->filename[i] = '_';
+	}
+	if (f->filename[0] == '\0') snprintf(f->filename, sizeof(f->filename), "IMG_%08X", handle);
+
+	b->queue_length++;
+}
+
+static int burst_events(struct PtpRuntime *r, struct PtpBurst *b) {
+	if (ptp_device_type(r) == PTP_DEV_EOS) {
+		int x = ptp_eos_get_event(r);
+		if (x) return x;
+
+		struct PtpCanonEvent ce;
+		void *e = ptp_open_eos_events(r);
+		while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+			if (ce.type != PTP_EC_EOS_ObjectAddedEx) continue;
+			struct PtpObjectInfo oi;
+			if (ptp_eos_object_info(&ce, &oi)) continue;
+			burst_object(b, ce.code, &oi);
+		}
+
+		return 0;
+	}
+
+	// Handles come first, info can only be fetched once the interrupt queue is empty
+	uint32_t added[16];
+	int length = 0;
+	while (length < 16) {
+		struct PtpEventContainer ec;
+		int x = ptp_get_event(r, &ec);
+		if (x < 0) return x;
+		if (x < 12) break;
+		if (ec.code == PTP_EC_ObjectAdded) added[length++] = ec.params[0];
+	}
+
+	for (int i = 0; i < length; i++) {
+		struct PtpObjectInfo oi;
+		int x = ptp_get_object_info(r, added[i], &oi);
+		if (x == PTP_IO_ERR) return x;
+		if (x) continue;
+		burst_object(b, added[i], &oi);
+	}
+
+	return 0;
+}
+
+// Download one slice of the oldest file
+static int burst_download(struct PtpRuntime *r, struct PtpBurst *b) {
+	struct PtpBurstFile *f = &b->queue[0];
+
+	if (f->stream == NULL) {
+		char path[sizeof(b->dir) + 64];
+		snprintf(path, sizeof(path), "%s/%s", b->dir, f->filename);
+		f->stream = fopen(path, "wb");
+		if (f->stream == NULL) return PTP_RUNTIME_ERR;
+	}
+
+	int max = r->data_length - (r->max_packet_size * 2);
+	if (max > PTP_BURST_SLICE) max = PTP_BURST_SLICE;
+
+	int x = ptp_get_partial_object(r, f->handle, f->offset, max);
+	int length = 0;
+	if (x == 0) {
+		length = ptp_get_payload_length(r);
+		if (length > 0 && fwrite(ptp_get_payload(r), 1, length, f->stream) != (size_t)length) {
+			x = PTP_RUNTIME_ERR;
+		}
+	}
+
+	if (x == 0 && length > 0) {
+		f->offset += length;
+		b->bytes += length;
+		if (length == max && (f->size == 0 || f->offset < f->size)) return 0;
+	}
+
+	if (fclose(f->stream) && x == 0) x = PTP_RUNTIME_ERR;
+	if (x == 0) {
+		b->files++;
+		b->shot[f->shot].saved = ptp_time_us();
+	} else {
+		b->errors++;
+	}
+
+	b->queue_length--;
+	memmove(&b->queue[0], &b->queue[1], b->queue_length * sizeof(struct PtpBurstFile));
+
+	if (x == PTP_IO_ERR) return x;
+	return 0;
+}
+
+static void burst_close(struct PtpBurst *b) {
+	for (int i = 0; i < b->queue_length; i++) {
+		if (b->queue[i].stream != NULL) fclose(b->queue[i].stream);
+	}
+	b->queue_length = 0;
+}
+
+int ptp_burst(struct PtpRuntime *r, struct PtpBurst *b, int shots, int interval, char *dir) {
+	// Both come straight from bindings, a bad value would never finish
+	if (shots < 1 || shots > PTP_BURST_MAX || interval < 0) return PTP_RUNTIME_ERR;
+
+	memset(b, 0, sizeof(struct PtpBurst));
+	b->shots = shots;
+	b->interval = interval;
+	if (dir != NULL) snprintf(b->dir, sizeof(b->dir), "%s", dir);
+
+	uint64_t start = ptp_time_us();
+	while (1) {
+		uint64_t now = ptp_time_us();
+
+		if (b->fired < shots && now >= start + ((uint64_t)b->fired * interval * 1000)) {
+			int x = ptp_take_picture(r);
+			if (x) {
+				burst_close(b);
+				return x;
+			}
+
+			b->shot[b->fired].fired = now;
+			b->fired++;
+			continue;
+		}
+
+		// Everything fired, wait for the objects that are still coming
+		if (b->fired == shots && b->queue_length == 0) {
+			int missing = 0;
+			for (int i = 0; i < b->fired; i++) {
+				if (b->shot[i].objects == 0) missing++;
+			}
+
+			if (missing == 0) break;
+
+			uint64_t last = b->last_object > b->shot[shots - 1].fired ? b->last_object : b->shot[shots - 1].fired;
+			if (now - last > PTP_BURST_TIMEOUT) {
+				b->errors += missing;
+				break;
+			}
+		}
+
+		int x = burst_events(r, b);
+		if (x == 0 && b->queue_length) x = burst_download(r, b);
+		if (x) {
+			burst_close(b);
+			return x;
+		}
+
+		if (b->queue_length == 0) CAMLIB_SLEEP(10);
+	}
+
+	return b->files;
+}
+
+int ptp_burst_json(struct PtpBurst *b, char *buffer, int max) {
+	int curr = snprintf(buffer, max, "{\"fired\": %d, \"files\": %d, \"errors\": %d, \"bytes\": %llu, \"shots\": [",
+		b->fired, b->files, b->errors, (unsigned long long)b->bytes);
+	if (curr >= max) return max;
+
+	// Milliseconds from the trigger, -1 if it never happened
+	for (int i = 0; i < b->fired; i++) {
+		struct PtpBurstShot *s = &b->shot[i];
+		double landed = s->landed ? (s->landed - s->fired) / 1000.0 : -1;
+		double saved = s->saved ? (s->saved - s->fired) / 1000.0 : -1;
+		double at = (s->fired - b->shot[0].fired) / 1000.0;
+		curr += snprintf(buffer + curr, max - curr, "%s[%.1f, %.1f, %.1f, %d]",
+			i ? ", " : "", at, landed, saved, s->objects);
+		if (curr >= max) return max;
+	}
+
+	curr += snprintf(buffer + curr, max - curr, "]}");
+	if (curr >= max) return max;
+	return curr;
+}
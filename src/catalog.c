@@ -0,0 +1,375 @@
+// In memory object catalog, built from a single scan of a storage
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+void ptp_catalog_init(struct PtpCatalog *c) {
+	memset(c, 0, sizeof(struct PtpCatalog));
+}
+
+void ptp_catalog_free(struct PtpCatalog *c) {
+	free(c->handle);
+	free(c->parent);
+	free(c->format);
+	free(c->size);
+	free(c->date);
+	free(c->name);
+	free(c->names);
+	free(c->name_table);
+	free(c->handle_table);
+	free(c->by_parent);
+	free(c->by_date);
+	free(c->by_format);
+	ptp_catalog_init(c);
+}
+
+void ptp_catalog_clear(struct PtpCatalog *c) {
+	c->length = 0;
+	c->names_used = 0;
+	c->name_count = 0;
+	c->dirty = 1;
+	if (c->name_table) memset(c->name_table, 0, c->name_table_size * sizeof(uint32_t));
+	if (c->handle_table) memset(c->handle_table, 0xff, c->handle_table_size * sizeof(int));
+}
+
+// PTP dates are "YYYYMMDDThhmmss", with optional tenths and timezone.
+// Returns seconds since 1970 (timezone ignored), 0 if empty or invalid.
+uint32_t ptp_parse_date(char *s) {
+	int v[6] = {0};
+	int widths[6] = {4, 2, 2, 2, 2, 2};
+	for (int i = 0; i < 6; i++) {
+		if (i == 3) {
+			if (*s != 'T') return 0;
+			s++;
+		}
+		for (int j = 0; j < widths[i]; j++) {
+			if (*s < '0' || *s > '9') return 0;
+			v[i] = (v[i] * 10) + (*s - '0');
+			s++;
+		}
+	}
+
+	int y = v[0], m = v[1], d = v[2];
+	if (y < 1970 || m < 1 || m > 12 || d < 1 || d > 31) return 0;
+
+	// Days from civil (Howard Hinnant)
+	y -= m <= 2;
+	int era = y / 400;
+	int yoe = y - (era * 400);
+	int doy = ((153 * (m + (m > 2 ? -3 : 9))) + 2) / 5 + d - 1;
+	int doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+	int64_t days = ((int64_t)era * 146097) + doe - 719468;
+
+	return (uint32_t)((days * 86400) + (v[3] * 3600) + (v[4] * 60) + v[5]);
+}
+
+static uint32_t catalog_hash(const char *s) {
+	uint32_t h = 2166136261u;
+	while (*s) {
+		h = (h ^ (uint8_t)*s) * 16777619u;
+		s++;
+	}
+
+	return h;
+}
+
+static int catalog_grow_names(struct PtpCatalog *c) {
+	int size = c->name_table_size ? c->name_table_size * 2 : 1024;
+	uint32_t *table = calloc(size, sizeof(uint32_t));
+	if (table == NULL) return PTP_OUT_OF_MEM;
+
+	// Entries are name offsets + 1, zero is empty
+	for (int i = 0; i < c->name_table_size; i++) {
+		uint32_t e = c->name_table[i];
+		if (e == 0) continue;
+		uint32_t slot = catalog_hash(c->names + e - 1) & (size - 1);
+		while (table[slot]) slot = (slot + 1) & (size - 1);
+		table[slot] = e;
+	}
+
+	free(c->name_table);
+	c->name_table = table;
+	c->name_table_size = size;
+	return 0;
+}
+
+// Returns the offset of the name in the pool, adding it if needed
+static int catalog_intern(struct PtpCatalog *c, const char *name) {
+	if ((c->name_count + 1) * 2 > c->name_table_size) {
+		int x = catalog_grow_names(c);
+		if (x) return x;
+	}
+
+	uint32_t slot = catalog_hash(name) & (c->name_table_size - 1);
+	while (c->name_table[slot]) {
+		uint32_t of = c->name_table[slot] - 1;
+		if (!strcmp(c->names + of, name)) return of;
+		slot = (slot + 1) & (c->name_table_size - 1);
+	}
+
+	int length = strlen(name) + 1;
+	if (c->names_used + length > c->names_size) {
+		int size = c->names_size ? c->names_size * 2 : 16384;
+		while (size < c->names_used + length) size *= 2;
+		char *names = realloc(c->names, size);
+		if (names == NULL) return PTP_OUT_OF_MEM;
+		c->names = names;
+		c->names_size = size;
+	}
+
+	int of = c->names_used;
+	memcpy(c->names + of, name, length);
+	c->names_used += length;
+	c->name_table[slot] = of + 1;
+	c->name_count++;
+	return of;
+}
+
+static int catalog_grow(struct PtpCatalog *c) {
+	int cap = c->capacity ? c->capacity * 2 : 256;
+
+	#define CATALOG_GROW(col) { \
+		void *p = realloc(c->col, cap * sizeof(c->col[0])); \
+		if (p == NULL) return PTP_OUT_OF_MEM; \
+		c->col = p; }
+
+	CATALOG_GROW(handle)
+	CATALOG_GROW(parent)
+	CATALOG_GROW(format)
+	CATALOG_GROW(size)
+	CATALOG_GROW(date)
+	CATALOG_GROW(name)
+
+	#undef CATALOG_GROW
+
+	c->capacity = cap;
+	return 0;
+}
+
+// Table is kept at most half full, for at least length rows
+static int catalog_rebuild_handles(struct PtpCatalog *c, int length) {
+	int size = 1024;
+	while (size < length * 2) size *= 2;
+	if (size != c->handle_table_size) {
+		free(c->handle_table);
+		c->handle_table = malloc(size * sizeof(int));
+		if (c->handle_table == NULL) {
+			c->handle_table_size = 0;
+			return PTP_OUT_OF_MEM;
+		}
+		c->handle_table_size = size;
+	}
+
+	memset(c->handle_table, 0xff, size * sizeof(int));
+	for (int i = 0; i < c->length; i++) {
+		uint32_t slot = (c->handle[i] * 2654435761u) & (size - 1);
+		while (c->handle_table[slot] != -1) slot = (slot + 1) & (size - 1);
+		c->handle_table[slot] = i;
+	}
+
+	return 0;
+}
+
+int ptp_catalog_find(struct PtpCatalog *c, uint32_t handle) {
+	if (c->handle_table_size == 0) return -1;
+	uint32_t slot = (handle * 2654435761u) & (c->handle_table_size - 1);
+	while (c->handle_table[slot] != -1) {
+		int row = c->handle_table[slot];
+		if (c->handle[row] == handle) return row;
+		slot = (slot + 1) & (c->handle_table_size - 1);
+	}
+
+	return -1;
+}
+
+int ptp_catalog_add(struct PtpCatalog *c, uint32_t handle, struct PtpObjectInfo *oi) {
+	int row = ptp_catalog_find(c, handle);
+	if (row == -1) {
+		if (c->length == c->capacity) {
+			int x = catalog_grow(c);
+			if (x) return x;
+		}
+
+		if ((c->length + 1) * 2 > c->handle_table_size) {
+			int x = catalog_rebuild_handles(c, c->length + 1);
+			if (x) return x;
+		}
+
+		uint32_t slot = (handle * 2654435761u) & (c->handle_table_size - 1);
+		while (c->handle_table[slot] != -1) slot = (slot + 1) & (c->handle_table_size - 1);
+		c->handle_table[slot] = c->length;
+
+		row = c->length;
+		c->length++;
+	}
+
+	int name = catalog_intern(c, oi->filename);
+	if (name < 0) return name;
+
+	c->handle[row] = handle;
+	c->parent[row] = oi->parent_obj;
+	c->format[row] = oi->obj_format;
+	c->size[row] = oi->compressed_size;
+	c->date[row] = ptp_parse_date(oi->date_created);
+	c->name[row] = name;
+	c->dirty = 1;
+	return row;
+}
+
+// Last row is moved into the gap, the name stays in the pool
+int ptp_catalog_remove(struct PtpCatalog *c, uint32_t handle) {
+	int row = ptp_catalog_find(c, handle);
+	if (row == -1) return 0;
+
+	int last = c->length - 1;
+	c->handle[row] = c->handle[last];
+	c->parent[row] = c->parent[last];
+	c->format[row] = c->format[last];
+	c->size[row] = c->size[last];
+	c->date[row] = c->date[last];
+	c->name[row] = c->name[last];
+	c->length--;
+	c->dirty = 1;
+
+	// Removal is rare, so the handle table is just rebuilt
+	catalog_rebuild_handles(c, c->length);
+	return 1;
+}
+
+static int catalog_compare(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// Sort rows by key, keys are packed above the row so equal keys keep row order
+static int catalog_sort(struct PtpCatalog *c, uint32_t **index, uint64_t *tmp, uint32_t (*key)(struct PtpCatalog *, int)) {
+	uint32_t *rows = realloc(*index, (c->length ? c->length : 1) * sizeof(uint32_t));
+	if (rows == NULL) return PTP_OUT_OF_MEM;
+	*index = rows;
+
+	for (int i = 0; i < c->length; i++) {
+		tmp[i] = ((uint64_t)key(c, i) << 32) | (uint32_t)i;
+	}
+
+	qsort(tmp, c->length, sizeof(uint64_t), catalog_compare);
+
+	for (int i = 0; i < c->length; i++) {
+		rows[i] = (uint32_t)tmp[i];
+	}
+
+	return 0;
+}
+
+static uint32_t catalog_key_parent(struct PtpCatalog *c, int i) {
+	return c->parent[i];
+}
+
+// Newest first
+static uint32_t catalog_key_date(struct PtpCatalog *c, int i) {
+	return ~c->date[i];
+}
+
+static uint32_t catalog_key_format(struct PtpCatalog *c, int i) {
+	return c->format[i];
+}
+
+int ptp_catalog_build_index(struct PtpCatalog *c) {
+	if (!c->dirty) return 0;
+
+	uint64_t *tmp = malloc((c->length ? c->length : 1) * sizeof(uint64_t));
+	if (tmp == NULL) return PTP_OUT_OF_MEM;
+
+	int x = catalog_sort(c, &c->by_parent, tmp, catalog_key_parent);
+	if (!x) x = catalog_sort(c, &c->by_date, tmp, catalog_key_date);
+	if (!x) x = catalog_sort(c, &c->by_format, tmp, catalog_key_format);
+	free(tmp);
+	if (x) return x;
+
+	c->dirty = 0;
+	return 0;
+}
+
+// Range of rows in index where column == value
+static int catalog_range(struct PtpCatalog *c, uint32_t *index, uint32_t (*key)(struct PtpCatalog *, int), uint32_t value, uint32_t **rows) {
+	int lo = 0, hi = c->length;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (key(c, index[mid]) < value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	int end = lo;
+	while (end < c->length && key(c, index[end]) == value) end++;
+
+	*rows = index + lo;
+	return end - lo;
+}
+
+int ptp_catalog_children(struct PtpCatalog *c, uint32_t parent, uint32_t **rows) {
+	int x = ptp_catalog_build_index(c);
+	if (x) return x;
+	return catalog_range(c, c->by_parent, catalog_key_parent, parent, rows);
+}
+
+int ptp_catalog_with_format(struct PtpCatalog *c, int format, uint32_t **rows) {
+	int x = ptp_catalog_build_index(c);
+	if (x) return x;
+	return catalog_range(c, c->by_format, catalog_key_format, format, rows);
+}
+
+int ptp_catalog_newest(struct PtpCatalog *c, int n, uint32_t **rows) {
+	int x = ptp_catalog_build_index(c);
+	if (x) return x;
+	*rows = c->by_date;
+	return (n < c->length) ? n : c->length;
+}
+
+char *ptp_catalog_name(struct PtpCatalog *c, int row) {
+	return c->names + c->name[row];
+}
+
+static int catalog_scan_add(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi, void *arg) {
+	int x = ptp_catalog_add((struct PtpCatalog *)arg, handle, oi);
+	if (x < 0) return x;
+	return 0;
+}
+
+int ptp_catalog_scan(struct PtpRuntime *r, struct PtpCatalog *c, int storage_id) {
+	ptp_catalog_clear(c);
+	c->storage_id = storage_id;
+	c->stale = 0;
+
+	int x = ptp_get_all_object_info(r, storage_id, catalog_scan_add, c);
+	if (x < 0) return x;
+
+	int y = ptp_catalog_build_index(c);
+	if (y) return y;
+	return x;
+}
+
+int ptp_catalog_json(struct PtpCatalog *c, uint32_t *rows, int length, char *buffer, int max) {
+	int curr = snprintf(buffer, max, "[");
+	for (int i = 0; i < length; i++) {
+		int row = rows[i];
+
+		// Longest possible entry, names are at most 64 bytes (not escaped)
+		if (curr + 200 >= max) return PTP_OUT_OF_MEM;
+		curr += snprintf(buffer + curr, max - curr,
+			"%s{\"handle\": %u, \"parent\": %u, \"format\": %u, \"size\": %u, \"date\": %u, \"filename\": \"%s\"}",
+			i ? "," : "", c->handle[row], c->parent[row], c->format[row], c->size[row], c->date[row],
+			ptp_catalog_name(c, row));
+	}
+
+	if (curr + 2 >= max) return PTP_OUT_OF_MEM;
+	curr += snprintf(buffer + curr, max - curr, "]");
+	return curr;
+}
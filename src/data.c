@@ -7,7 +7,8 @@
 #include <camlib.h>
 #include <ptp.h>
 
-int ptp_get_data_size(void *d, int type) {
+// Size of a scalar data type, 0 for arrays and strings
+static int ptp_get_data_size(int type) {
 	switch (type) {
 	case PTP_TC_INT8:
 	case PTP_TC_UINT8:
@@ -21,93 +22,209 @@ int ptp_get_data_size(void *d, int type) {
 	case PTP_TC_INT64:
 	case PTP_TC_UINT64:
 		return 8;
-	case PTP_TC_UINT8ARRAY:
-	case PTP_TC_UINT16ARRAY:
-	case PTP_TC_UINT32ARRAY:
-	case PTP_TC_UINT64ARRAY:
-		return ((uint32_t*)d)[0];
-	case PTP_TC_STRING:
-		return ((uint8_t*)d)[0];
+	case PTP_TC_INT128:
+	case PTP_TC_UINT128:
+		return 16;
 	}
 
 	return 0;
 }
 
-int ptp_parse_data(void **d, int type) {
+static uint64_t ptp_read_le(uint8_t *d, int size) {
+	uint64_t x = 0;
+	for (int i = size - 1; i >= 0; i--) {
+		x = (x << 8) | d[i];
+	}
+
+	return x;
+}
+
+// Sign extend signed types to 64 bits
+static uint64_t ptp_sign_extend(uint64_t x, int type) {
 	switch (type) {
 	case PTP_TC_INT8:
-	case PTP_TC_UINT8:
-		return (uint8_t)ptp_read_uint8(d);
+		return (uint64_t)(int64_t)(int8_t)x;
 	case PTP_TC_INT16:
-	case PTP_TC_UINT16:
-		return (uint16_t)ptp_read_uint16(d);
+		return (uint64_t)(int64_t)(int16_t)x;
 	case PTP_TC_INT32:
-	case PTP_TC_UINT32:
-		return (uint32_t)ptp_read_uint32(d);
+		return (uint64_t)(int64_t)(int32_t)x;
 	}
 
-	return ptp_get_data_size(*d, type);
+	return x;
 }
 
-int ptp_parse_prop_desc(struct PtpRuntime *r, struct PtpDevPropDesc *oi) {
-	void *d = ptp_get_payload(r);
-	memcpy(oi, d, PTP_PROP_DESC_VAR_START);
-	d += PTP_PROP_DESC_VAR_START;
-	oi->default_value = ptp_parse_data(&d, oi->data_type);
-	oi->current_value = ptp_parse_data(&d, oi->data_type);
+// PTP strings are a character count (including the null) followed by UTF-16
+static int ptp_parse_string_value(struct PtpRuntime *r, uint8_t **d, uint8_t *end, struct PtpPropValue *v) {
+	if (*d + 1 > end) return PTP_RUNTIME_ERR;
+	int chars = **d;
+	(*d)++;
+	if (*d + (chars * 2) > end) return PTP_RUNTIME_ERR;
+
+	// Worst case is 3 bytes of UTF-8 per UTF-16 unit
+	char *str = ptp_arena_alloc(r, (chars * 3) + 1);
+	if (str == NULL) return PTP_OUT_OF_MEM;
+
+	int len = 0;
+	for (int i = 0; i < chars; i++) {
+		uint16_t c = (*d)[0] | ((*d)[1] << 8);
+		*d += 2;
+		if (c == 0) continue;
+		if (c < 0x80) {
+			str[len++] = c;
+		} else if (c < 0x800) {
+			str[len++] = 0xc0 | (c >> 6);
+			str[len++] = 0x80 | (c & 0x3f);
+		} else {
+			str[len++] = 0xe0 | (c >> 12);
+			str[len++] = 0x80 | ((c >> 6) & 0x3f);
+			str[len++] = 0x80 | (c & 0x3f);
+		}
+	}
 
-	// TODO: Form flag + form (for properties like date/time)
+	str[len] = '\0';
+	v->value = 0;
+	v->data = str;
+	v->length = len;
 	return 0;
 }
 
-int ptp_parse_object_info(struct PtpRuntime *r, struct PtpObjectInfo *oi) {
-	void *d = ptp_get_payload(r);
-	memcpy(oi, d, PTP_OBJ_INFO_VAR_START);
-	d += PTP_OBJ_INFO_VAR_START;
-	ptp_read_string(&d, oi->filename, sizeof(oi->filename));
-	ptp_read_string(&d, oi->date_created, sizeof(oi->date_created));
-	ptp_read_string(&d, oi->date_modified, sizeof(oi->date_modified));
-	ptp_read_string(&d, oi->keywords, sizeof(oi->keywords));
+int ptp_parse_prop_value(struct PtpRuntime *r, uint8_t **d, uint8_t *end, int type, struct PtpPropValue *v) {
+	v->value = 0;
+	v->data = NULL;
+	v->length = 0;
 
-	return 0;
-}
+	if (type == PTP_TC_STRING) {
+		return ptp_parse_string_value(r, d, end, v);
+	}
 
-int ptp_pack_object_info(struct PtpRuntime *r, struct PtpObjectInfo *oi) {
-	void *d = ptp_get_payload(r);
-	memcpy(oi, d, PTP_OBJ_INFO_VAR_START);
-	d += PTP_OBJ_INFO_VAR_START;
+	// Arrays are a 32 bit count followed by elements of the base type
+	if (type & 0x4000) {
+		int size = ptp_get_data_size(type & 0xff);
+		if (size == 0 || size > 8) return PTP_UNSUPPORTED;
+		if (*d + 4 > end) return PTP_RUNTIME_ERR;
+		uint32_t count = ptp_read_le(*d, 4);
+		*d += 4;
+		if (count > (uint32_t)(end - *d) / size) return PTP_RUNTIME_ERR;
+
+		void *arr = ptp_arena_alloc(r, count * size);
+		if (arr == NULL && count != 0) return PTP_OUT_OF_MEM;
+		for (uint32_t i = 0; i < count; i++) {
+			uint64_t x = ptp_read_le(*d, size);
+			switch (size) {
+			case 1: ((uint8_t *)arr)[i] = x; break;
+			case 2: ((uint16_t *)arr)[i] = x; break;
+			case 4: ((uint32_t *)arr)[i] = x; break;
+			case 8: ((uint64_t *)arr)[i] = x; break;
+			}
+			*d += size;
+		}
+
+		v->data = arr;
+		v->length = count;
+		return 0;
+	}
+
+	int size = ptp_get_data_size(type);
+	if (size == 0) return PTP_UNSUPPORTED;
+	if (*d + size > end) return PTP_RUNTIME_ERR;
 
-	ptp_write_string(&d, oi->filename);
-	ptp_write_string(&d, oi->date_created);
-	ptp_write_string(&d, oi->date_modified);
-	ptp_write_string(&d, oi->keywords);
+	if (size == 16) {
+		v->data = ptp_arena_alloc(r, 16);
+		if (v->data == NULL) return PTP_OUT_OF_MEM;
+		memcpy(v->data, *d, 16);
+		v->length = 16;
+		size = 8;
+	}
 
+	v->value = ptp_sign_extend(ptp_read_le(*d, size), type);
+	*d += ptp_get_data_size(type);
 	return 0;
 }
 
-int ptp_parse_device_info(struct PtpRuntime *r, struct PtpDeviceInfo *di) {
-	// Skip packet header
-	void *e = ptp_get_payload(r);
+int ptp_prop_value_size(uint8_t *d, int length, int type) {
+	if (type == PTP_TC_STRING) {
+		if (length < 1) return 0;
+		int size = 1 + (d[0] * 2);
+		return (size > length) ? 0 : size;
+	}
+
+	if (type & 0x4000) {
+		int size = ptp_get_data_size(type & 0xff);
+		if (size == 0) return PTP_UNSUPPORTED;
+		if (length < 4) return 0;
+		uint32_t count = ptp_read_le(d, 4);
+		if (count > (uint32_t)(length - 4) / size) return 0;
+		return 4 + (count * size);
+	}
 
-	di->standard_version = ptp_read_uint16(&e);
-	di->vendor_ext_id = ptp_read_uint32(&e);
-	di->version = ptp_read_uint16(&e);
+	int size = ptp_get_data_size(type);
+	if (size == 0) return PTP_UNSUPPORTED;
+	return (size > length) ? 0 : size;
+}
 
-	ptp_read_string(&e, di->extensions, sizeof(di->extensions));
+int ptp_parse_prop_desc(struct PtpRuntime *r, struct PtpDevPropDesc *oi) {
+	uint8_t *d = ptp_get_payload(r);
+	uint8_t *end = d + ptp_get_payload_length(r);
+
+	int x = ptp_read_prop_desc(d, end - d, oi);
+	if (x < 0) return x;
+	d += x;
+
+	oi->form_type = PTP_FORM_NONE;
+	oi->enum_length = 0;
+	oi->enum_values = NULL;
+
+	x = ptp_parse_prop_value(r, &d, end, oi->data_type, &oi->default_value);
+	if (x) return x;
+	x = ptp_parse_prop_value(r, &d, end, oi->data_type, &oi->current_value);
+	if (x) return x;
+
+	// Form flag is optional in some older devices
+	if (d >= end) return 0;
+	oi->form_type = *d;
+	d++;
+
+	switch (oi->form_type) {
+	case PTP_FORM_RANGE:
+		x = ptp_parse_prop_value(r, &d, end, oi->data_type, &oi->range_min);
+		if (x) return x;
+		x = ptp_parse_prop_value(r, &d, end, oi->data_type, &oi->range_max);
+		if (x) return x;
+		return ptp_parse_prop_value(r, &d, end, oi->data_type, &oi->range_step);
+	case PTP_FORM_ENUM: {
+		if (d + 2 > end) return PTP_RUNTIME_ERR;
+		int length = ptp_read_le(d, 2);
+		d += 2;
+
+		oi->enum_values = ptp_arena_alloc(r, sizeof(struct PtpPropValue) * length);
+		if (oi->enum_values == NULL && length != 0) return PTP_OUT_OF_MEM;
+		for (int i = 0; i < length; i++) {
+			x = ptp_parse_prop_value(r, &d, end, oi->data_type, &oi->enum_values[i]);
+			if (x) return x;
+			oi->enum_length++;
+		}
+		} return 0;
+	}
 
-	di->functional_mode = ptp_read_uint16(&e);
+	return 0;
+}
 
-	di->ops_supported_length = ptp_read_uint16_array(&e, di->ops_supported, sizeof(di->ops_supported) / 2);
-	di->events_supported_length = ptp_read_uint16_array(&e, di->events_supported, sizeof(di->events_supported) / 2);
-	di->props_supported_length = ptp_read_uint16_array(&e, di->props_supported, sizeof(di->props_supported) / 2);
-	di->capture_formats_length = ptp_read_uint16_array(&e, di->capture_formats, sizeof(di->capture_formats) / 2);
-	di->playback_formats_length = ptp_read_uint16_array(&e, di->playback_formats, sizeof(di->playback_formats) / 2);
+int ptp_parse_object_info(struct PtpRuntime *r, struct PtpObjectInfo *oi) {
+	int x = ptp_read_object_info(ptp_get_payload(r), ptp_get_payload_length(r), oi);
+	if (x < 0) return x;
+	return 0;
+}
 
-	ptp_read_string(&e, di->manufacturer, sizeof(di->manufacturer));
-	ptp_read_string(&e, di->model, sizeof(di->model));
+// Write object info into the payload of r->data, returns the length
+int ptp_pack_object_info(struct PtpRuntime *r, struct PtpObjectInfo *oi) {
+	uint8_t *d = ptp_get_payload(r);
+	int max = r->data_length - (d - r->data);
+	return ptp_write_object_info(d, max, oi);
+}
 
-	ptp_read_string(&e, di->device_version, sizeof(di->device_version));
-	ptp_read_string(&e, di->serial_number, sizeof(di->serial_number));
+int ptp_parse_device_info(struct PtpRuntime *r, struct PtpDeviceInfo *di) {
+	int x = ptp_read_device_info(ptp_get_payload(r), ptp_get_payload_length(r), di);
+	if (x < 0) return x;
 
 	r->di = di;
 
@@ -212,15 +329,315 @@ int ptp_storage_info_json(struct PtpStorageInfo *so, char *buffer, int max) {
 	int len = sprintf(buffer, "{");
 	len += snprintf(buffer + len, max - len, "\"storage_type\": \"%s\",", eval_storage_type(so->storage_type));
 	len += snprintf(buffer + len, max - len, "\"fs_type\": %u,", so->fs_type);
-	len += snprintf(buffer + len, max - len, "\"max_capacity\": %lu,", so->max_capacity);
-	len += snprintf(buffer + len, max - len, "\"free_space\": %lu", so->free_space);
+	len += snprintf(buffer + len, max - len, "\"max_capacity\": %llu,", (unsigned long long)so->max_capacity);
+	len += snprintf(buffer + len, max - len, "\"free_space\": %llu", (unsigned long long)so->free_space);
 	len += snprintf(buffer + len, max - len, "}");
 	return len;
 }
 
-int ptp_eos_prop_json(void **d, char *buffer, int max) {
-	int code = ptp_read_uint32(d);
-	int data_value = ptp_read_uint32(d);
+void *ptp_open_eos_events(struct PtpRuntime *r) {
+	if (ptp_get_payload_length(r) <= 0) return NULL;
+	return ptp_get_payload(r);
+}
+
+// Decode the record at p, returns the next record or NULL
+static uint8_t *ptp_eos_event_decode(uint8_t *p, uint8_t *end, struct PtpCanonEvent *ce) {
+	if (p + 8 > end) return NULL;
+
+	void *d = p;
+	uint32_t size = ptp_read_uint32(&d);
+	uint32_t type = ptp_read_uint32(&d);
+
+	// Terminating record has a zero type
+	if (type == 0 || size < 8 || size > (uint32_t)(end - p)) return NULL;
+
+	ce->type = type;
+	ce->code = 0;
+	ce->value = 0;
+	ce->data_type = 0;
+
+	// Number of fixed words decoded into ce before the variable data
+	int words = 0;
+	switch (type) {
+	case PTP_EC_EOS_PropValueChanged:
+		words = 1;
+		break;
+	case PTP_EC_EOS_AvailListChanged:
+		words = 3;
+		break;
+	case PTP_EC_EOS_ObjectAddedEx:
+	case PTP_EC_EOS_ObjectRemoved:
+	case PTP_EC_EOS_RequestObjectTransfer:
+	case PTP_EC_EOS_ObjectInfoChangedEx:
+	case PTP_EC_EOS_ObjectContentChanged:
+		words = 1;
+		break;
+	}
+
+	if (8 + (words * 4) > (int)size) words = (size - 8) / 4;
+
+	if (words > 0) ce->code = ptp_read_uint32(&d);
+	if (words > 1) ce->data_type = ptp_read_uint32(&d);
+	if (words > 2) ce->value = ptp_read_uint32(&d);
+
+	ce->data = (uint8_t *)d;
+	ce->data_length = size - 8 - (words * 4);
+
+	// Property values are at least 32 bits
+	if (type == PTP_EC_EOS_PropValueChanged && ce->data_length >= 4) {
+		void *v = ce->data;
+		ce->value = ptp_read_uint32(&v);
+	}
+
+	return p + size;
+}
+
+void *ptp_get_eos_event(struct PtpRuntime *r, void *e, struct PtpCanonEvent *ce) {
+	if (e == NULL) return NULL;
+
+	uint8_t *end = ptp_get_payload(r) + ptp_get_payload_length(r);
+	if (end > r->data + r->data_length) end = r->data + r->data_length;
+
+	return ptp_eos_event_decode((uint8_t *)e, end, ce);
+}
+
+uint8_t *ptp_eos_viewfinder_next(uint8_t *p, uint8_t *end, struct PtpEOSViewFinderBlock *block) {
+	if (p == NULL || p + 8 > end) return NULL;
+
+	// Each block is a length (including this header) and a type
+	void *d = p;
+	uint32_t size = ptp_read_uint32(&d);
+	uint32_t type = ptp_read_uint32(&d);
+	if (type == 0 || size < 8 || size > (uint32_t)(end - p)) return NULL;
+
+	block->type = type;
+	block->data = p + 8;
+	block->length = size - 8;
+	return p + size;
+}
+
+void *ptp_open_eos_viewfinder(struct PtpRuntime *r) {
+	if (ptp_get_payload_length(r) <= 0) return NULL;
+	return ptp_get_payload(r);
+}
+
+void *ptp_get_eos_viewfinder_block(struct PtpRuntime *r, void *b, struct PtpEOSViewFinderBlock *block) {
+	uint8_t *end = ptp_get_payload(r) + ptp_get_payload_length(r);
+	if (end > r->data + r->data_length) end = r->data + r->data_length;
+
+	return ptp_eos_viewfinder_next((uint8_t *)b, end, block);
+}
+
+int ptp_eos_viewfinder_jpeg(uint8_t *payload, int length, struct PtpEOSViewFinderBlock *block) {
+	uint8_t *p = payload;
+	while ((p = ptp_eos_viewfinder_next(p, payload + length, block)) != NULL) {
+		if (block->type == PTP_EOS_VF_JPEG || block->type == PTP_EOS_VF_JPEG_NEW || block->type == PTP_EOS_VF_JPEG_NEW2) {
+			return 0;
+		}
+	}
+
+	return PTP_RUNTIME_ERR;
+}
+
+int ptp_eos_event_stream_feed(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done) {
+	struct PtpEOSEventStream *s = (struct PtpEOSEventStream *)p;
+	uint8_t *payload = ptp_get_payload(r);
+	if (s->finished) {
+		p->offset = avail;
+		return 0;
+	}
+
+	while (p->offset + 8 <= avail) {
+		void *d = payload + p->offset;
+		uint32_t size = ptp_read_uint32(&d);
+		uint32_t type = ptp_read_uint32(&d);
+
+		// Terminator, nothing else to parse
+		if (type == 0) {
+			s->finished = 1;
+			p->offset = avail;
+			return 0;
+		}
+
+		if (size < 8) return PTP_RUNTIME_ERR;
+
+		// Wait for the rest of the record
+		if (size > (uint32_t)(avail - p->offset)) break;
+
+		struct PtpCanonEvent ce;
+		ptp_eos_event_decode(payload + p->offset, payload + avail, &ce);
+		p->offset += size;
+		p->count++;
+
+		// Same hooks as ptp_eos_get_event
+		ptp_prop_store_apply(r, &ce);
+		ptp_object_cache_apply(r, &ce);
+		if (r->tether != NULL) ptp_tether_queue_event(r, r->tether, &ce);
+
+		if (s->fn != NULL) {
+			int x = s->fn(r, &ce, s->arg);
+			if (x < 0) return x;
+		}
+	}
+
+	if (done && p->offset < avail) return PTP_RUNTIME_ERR;
+	return 0;
+}
+
+int ptp_handle_stream_feed(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done) {
+	struct PtpHandleStream *s = (struct PtpHandleStream *)p;
+	uint8_t *payload = ptp_get_payload(r);
+
+	// Number of handles comes first
+	if (p->offset == 0) {
+		if (avail < 4) return done ? PTP_RUNTIME_ERR : 0;
+		void *d = payload;
+		s->length = ptp_read_uint32(&d);
+		p->offset = 4;
+	}
+
+	while (p->offset + 4 <= avail && (uint32_t)p->count < s->length) {
+		void *d = payload + p->offset;
+		uint32_t handle = ptp_read_uint32(&d);
+		p->offset += 4;
+		p->count++;
+
+		int x = s->fn(r, handle, s->arg);
+		if (x < 0) return x;
+	}
+
+	if (done && (uint32_t)p->count < s->length) return PTP_RUNTIME_ERR;
+	return 0;
+}
+
+// ObjectAddedEx record, offsets are from the start of the record
+// 0x0c storage id, 0x10 format, 0x1c size, 0x20 parent, 0x28 filename
+// RequestObjectTransfer is shorter, the object is only in camera RAM
+// 0x0c format, 0x14 size, 0x1c filename
+int ptp_eos_object_info(struct PtpCanonEvent *ce, struct PtpObjectInfo *oi) {
+	memset(oi, 0, sizeof(struct PtpObjectInfo));
+
+	// ce->data starts after the handle
+	int length = ce->data_length + 0x0c;
+	uint8_t *d = ce->data - 0x0c;
+
+	int name;
+	if (ce->type == PTP_EC_EOS_ObjectAddedEx) {
+		if (length < 0x28) return PTP_RUNTIME_ERR;
+		oi->storage_id = ptp_read_le(d + 0x0c, 4);
+		oi->obj_format = ptp_read_le(d + 0x10, 2);
+		oi->compressed_size = ptp_read_le(d + 0x1c, 4);
+		oi->parent_obj = ptp_read_le(d + 0x20, 4);
+		name = 0x28;
+	} else if (ce->type == PTP_EC_EOS_RequestObjectTransfer) {
+		if (length < 0x1c) return PTP_RUNTIME_ERR;
+		oi->obj_format = ptp_read_le(d + 0x0c, 2);
+		oi->compressed_size = ptp_read_le(d + 0x14, 4);
+		name = 0x1c;
+	} else {
+		return PTP_RUNTIME_ERR;
+	}
+
+	// Null terminated ASCII, not a PTP string
+	int i = 0;
+	for (; i < (int)sizeof(oi->filename) - 1 && name + i < length; i++) {
+		if (d[name + i] == '\0') break;
+		oi->filename[i] = d[name + i];
+	}
+	oi->filename[i] = '\0';
+
+	return 0;
+}
+
+// Value is complete, size checked by the caller
+static void ptp_obj_prop_apply(struct PtpObjectInfo *oi, int code, int type, uint8_t *d) {
+	int size = ptp_get_data_size(type);
+	uint32_t x = 0;
+	if (size != 0) x = ptp_read_le(d, size > 4 ? 4 : size);
+
+	void *e = d;
+	switch (code) {
+	case PTP_OPC_StorageID:
+		oi->storage_id = x; break;
+	case PTP_OPC_ObjectFormat:
+		oi->obj_format = x; break;
+	case PTP_OPC_ProtectionStatus:
+		oi->protection = x; break;
+	case PTP_OPC_ObjectSize:
+		oi->compressed_size = x; break;
+	case PTP_OPC_ParentObject:
+		oi->parent_obj = x; break;
+	}
+
+	if (type != PTP_TC_STRING) return;
+
+	switch (code) {
+	case PTP_OPC_ObjectFileName:
+		ptp_read_string(&e, oi->filename, sizeof(oi->filename)); break;
+	case PTP_OPC_DateCreated:
+		ptp_read_string(&e, oi->date_created, sizeof(oi->date_created)); break;
+	case PTP_OPC_DateModified:
+		ptp_read_string(&e, oi->date_modified, sizeof(oi->date_modified)); break;
+	case PTP_OPC_Keywords:
+		ptp_read_string(&e, oi->keywords, sizeof(oi->keywords)); break;
+	}
+}
+
+static int ptp_obj_prop_list_emit(struct PtpRuntime *r, struct PtpObjPropListStream *s) {
+	s->have_object = 0;
+	if (s->storage_id != 0 && s->oi.storage_id != s->storage_id) return 0;
+
+	s->p.count++;
+	return s->fn(r, s->handle, &s->oi, s->arg);
+}
+
+// Elements are handle, property code, data type, value
+int ptp_obj_prop_list_feed(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done) {
+	struct PtpObjPropListStream *s = (struct PtpObjPropListStream *)p;
+	uint8_t *payload = ptp_get_payload(r);
+
+	if (p->offset == 0) {
+		if (avail < 4) return done ? PTP_RUNTIME_ERR : 0;
+		s->length = ptp_read_le(payload, 4);
+		p->offset = 4;
+	}
+
+	while (s->elements < s->length && p->offset + 8 <= avail) {
+		uint8_t *d = payload + p->offset;
+		uint32_t handle = ptp_read_le(d, 4);
+		int code = ptp_read_le(d + 4, 2);
+		int type = ptp_read_le(d + 6, 2);
+
+		int size = ptp_prop_value_size(d + 8, avail - p->offset - 8, type);
+		if (size < 0) return size;
+		if (size == 0) break;
+
+		if (s->have_object && handle != s->handle) {
+			int x = ptp_obj_prop_list_emit(r, s);
+			if (x < 0) return x;
+		}
+
+		if (!s->have_object) {
+			memset(&s->oi, 0, sizeof(s->oi));
+			s->handle = handle;
+			s->have_object = 1;
+		}
+
+		ptp_obj_prop_apply(&s->oi, code, type, d + 8);
+		p->offset += 8 + size;
+		s->elements++;
+	}
+
+	if (!done) return 0;
+	if (s->elements < s->length) return PTP_RUNTIME_ERR;
+	if (s->have_object) return ptp_obj_prop_list_emit(r, s);
+	return 0;
+}
+
+// Friendly name and value for a property, value is set if it's a string
+static char *eos_prop_value(struct PtpCanonEvent *ce, int *data, char **string) {
+	int code = ce->code;
+	int data_value = ce->value;
 
 	char *name = ptp_get_enum_all(code);
 	char *value = NULL;
@@ -244,8 +661,12 @@ int ptp_eos_prop_json(void **d, char *buffer, int max) {
 		name = "battery";
 		break;
 	case PTP_PC_EOS_ImageFormat: {
-			int data[5] = {data_value, ptp_read_uint32(d), ptp_read_uint32(d),
-				ptp_read_uint32(d), ptp_read_uint32(d)};
+			if (ce->data_length < (int)sizeof(int) * 5) break;
+			int data[5];
+			void *d = ce->data;
+			for (int i = 0; i < 5; i++) {
+				data[i] = ptp_read_uint32(&d);
+			}
 			if (data_value == 1) {
 				data_value = ptp_eos_get_imgformat_value(data);
 			} else {
@@ -278,6 +699,17 @@ int ptp_eos_prop_json(void **d, char *buffer, int max) {
 		break;
 	}
 
+	*data = data_value;
+	*string = value;
+	return name;
+}
+
+int ptp_eos_prop_json(struct PtpCanonEvent *ce, char *buffer, int max) {
+	int code = ce->code;
+	int data_value;
+	char *value;
+	char *name = eos_prop_value(ce, &data_value, &value);
+
 	int curr = 0;
 	if (name == enum_null) {
 		curr = snprintf(buffer + curr, max - curr, "[%u, %u]\n", code, data_value);
@@ -292,256 +724,145 @@ int ptp_eos_prop_json(void **d, char *buffer, int max) {
 	return curr;
 }
 
-int ptp_eos_events_json(struct PtpRuntime *r, char *buffer, int max) {
-	//struct PtpCanonEvent ce;
-	void *dp = ptp_get_payload(r);
+int ptp_eos_avail_json(struct PtpPropEntry *e, char *buffer, int max) {
+	struct PtpCanonEvent ce;
+	ce.type = PTP_EC_EOS_AvailListChanged;
+	ce.code = e->code;
+	ce.value = 0;
+	ce.data = NULL;
+	ce.data_length = 0;
 
-	int curr = sprintf(buffer, "[\n");
+	int data_value;
+	char *value;
+	char *name = eos_prop_value(&ce, &data_value, &value);
 
-	int tmp = 0;
-	while (dp != NULL) {
-		void *d = dp;
-		uint32_t size = ptp_read_uint32(&d);
-		uint32_t type = ptp_read_uint32(&d);
+	int curr;
+	if (name == enum_null) {
+		curr = snprintf(buffer, max, "[%u, [", e->code);
+	} else {
+		curr = snprintf(buffer, max, "[\"%s\", [", name);
+	}
+
+	for (int i = 0; i < e->avail_length; i++) {
+		if (curr >= max) return curr;
 
-		dp += size;
+		ce.value = e->avail[i];
+		eos_prop_value(&ce, &data_value, &value);
 
-		if (type == 0) break;
-		if (dp >= (void*)ptp_get_payload(r) + ptp_get_data_length(r)) break;
+		char *comma = i ? ", " : "";
+		if (value == NULL) {
+			curr += snprintf(buffer + curr, max - curr, "%s%u", comma, data_value);
+		} else {
+			curr += snprintf(buffer + curr, max - curr, "%s\"%s\"", comma, value);
+		}
+	}
 
-		// Don't put comma for last entry
-		char *end = "";
-		if (tmp) end = ",";
-		tmp++;
+	if (curr >= max) return curr;
+	curr += snprintf(buffer + curr, max - curr, "]]\n");
+	return curr;
+}
 
-		curr += sprintf(buffer + curr, "%s", end);
+int ptp_eos_events_json(struct PtpRuntime *r, char *buffer, int max) {
+	struct PtpCanonEvent ce;
+	void *e = ptp_open_eos_events(r);
 
-		switch (type) {
+	int curr = snprintf(buffer, max, "[\n");
+
+	// Don't put comma for last entry
+	char *comma = "";
+	while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+		if (curr >= max) return 0;
+
+		switch (ce.type) {
 		case PTP_EC_EOS_PropValueChanged:
-			curr += ptp_eos_prop_json(&d, buffer + curr, max - curr);
+			curr += snprintf(buffer + curr, max - curr, "%s", comma);
+			curr += ptp_eos_prop_json(&ce, buffer + curr, max - curr);
 			break;
 		case PTP_EC_EOS_InfoCheckComplete:
 		case PTP_PC_EOS_FocusInfoEx:
-			curr += sprintf(buffer + curr, "[\"%s\", %u]\n", ptp_get_enum_all(type), type);
+			curr += snprintf(buffer + curr, max - curr, "%s[\"%s\", %u]\n", comma, ptp_get_enum_all(ce.type), ce.type);
 			break;
 		case PTP_EC_EOS_RequestObjectTransfer: {
-			int a = ptp_read_uint32(&d);
-			int b = ptp_read_uint32(&d);
-			curr += sprintf(buffer + curr, "[%u, %u]\n", a, b);
+			uint32_t b = 0;
+			if (ce.data_length >= 4) {
+				void *d = ce.data;
+				b = ptp_read_uint32(&d);
+			}
+			curr += snprintf(buffer + curr, max - curr, "%s[%u, %u]\n", comma, ce.code, b);
 			} break;
 		case PTP_EC_EOS_ObjectAddedEx: {
-			struct PtpEOSObject *obj = (struct PtpEOSObject *)d;
-			curr += sprintf(buffer + curr, "[\"new object\", %u]\n", obj->a);
+			struct PtpObjectInfo oi;
+			ptp_eos_object_info(&ce, &oi);
+			curr += snprintf(buffer + curr, max - curr, "%s[\"new object\", %u, \"%s\", %u]\n",
+				comma, ce.code, oi.filename, oi.compressed_size);
 			} break;
 		default:
-			printf("Unknown event code 0x%X\n", type);
-			// Unknown event, delete the comma
-			curr -= strlen(end);
-			if (tmp == 1) tmp = 0;
+			// Unknown event, leave it out
+			PTPLOG("Unknown event code 0x%X\n", ce.type);
+			continue;
 		}
 
-		if (curr >= max) return 0;
+		comma = ",";
 	}
 
-	curr += sprintf(buffer + curr, "]");
+	if (curr >= max) return 0;
+
+	curr += snprintf(buffer + curr, max - curr, "]");
 	return curr;
 }
 
-struct CanonShutterSpeed {
-	int value; // value times 100000
-	int data; // data from camera
-}canon_shutter[] = {
-	{0, 0xc}, // BULB 1300D
-	{0, 0x4}, // BULB 5dmk3
-	{3000000,0x10},
-	{2500000,0x13},
-	{2000000,0x15},
-	{1500000,0x18},
-	{1300000,0x1b},
-	{1000000,0x1d},
-	{800000,0x20},
-	{600000,0x23},
-	{500000,0x25},
-	{400000,0x28},
-	{320000,0x2b},
-	{250000,0x2d},
-	{200000,0x30},
-	{160000,0x33},
-	{130000,0x35},
-	{100000,0x38},
-	{80000,0x3b},
-	{60000,0x3d},
-	{50000,0x40},
-	{40000,0x43},
-	{30000,0x45},
-	{25000,0x48},
-	{20000,0x4b},
-	{16666,0x4d},
-	{12500,0x50},
-	{100000 / 10,0x53},
-	{100000 / 13,0x55},
-	{100000 / 15,0x58},
-	{100000 / 20,0x5b},
-	{100000 / 25,0x5d},
-	{100000 / 30,0x60},
-	{100000 / 40,0x63},
-	{100000 / 50,0x65},
-	{100000 / 60,0x68},
-	{100000 / 80,0x6b},
-	{100000 / 100,0x6d},
-	{100000 / 125,0x70},
-	{100000 / 160,0x73},
-	{100000 / 200,0x75},
-	{100000 / 250,0x78},
-	{100000 / 320,0x7b},
-	{100000 / 400,0x7d},
-	{100000 / 500,0x80},
-	{100000 / 640,0x83},
-	{100000 / 800,0x85},
-	{100000 / 1000,0x88},
-	{100000 / 1250,0x8b},
-	{100000 / 1600,0x8d},
-	{100000 / 2000,0x90},
-	{100000 / 2500,0x93},
-	{100000 / 3200,0x95},
-	{100000 / 4000,0x98},
-	{100000 / 5000,0x9a},
-	{100000 / 6400,0x9d},
-	{100000 / 8000,0xa0},
-};
+// Zero means AUTO or BULB, so it's only ever matched exactly. Only stop
+// tables (snap set) are snapped, enums like white balance are not ordered.
+static int ptp_eos_table_lookup(const struct PtpEOSTable *t, int data, int dir, int snap) {
+	if (dir == 0) {
+		if (data < 0 || data > 0xff || t->value[data] == -1) return data;
+		return t->value[data];
+	}
 
-int ptp_eos_get_shutter(int data, int dir) {
-	for (int i = 0; i < (int)(sizeof(canon_shutter) / sizeof(struct CanonShutterSpeed)); i++) {
-		if (dir) {
-			if (canon_shutter[i].value == data) {
-				return canon_shutter[i].data;
-			}
+	// First entry with a value >= data
+	int lo = 0, hi = t->length;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (t->sorted[mid].value < data) {
+			lo = mid + 1;
 		} else {
-			if (canon_shutter[i].data == data) {
-				return canon_shutter[i].value;
-			}
+			hi = mid;
 		}
 	}
 
-	return data;
-}
+	if (lo < t->length && t->sorted[lo].value == data) return t->sorted[lo].data;
+	if (data <= 0 || !snap) return data;
 
-struct CanonISO {
-	int value;
-	int data;
-}canon_iso[] = {
-	{0, 0}, // AUTO
-	{50, 0x40},
-	{100, 0x48},
-	{125, 0x4b},
-	{160, 0x4d},
-	{200, 0x50},
-	{250, 0x53},
-	{320, 0x55},
-	{400, 0x58},
-	{500, 0x5b},
-	{640, 0x5b},
-	{800, 0x60},
-	{1000, 0x63},
-	{1250, 0x65},
-	{1600, 0x68},
-	{3200, 0x70},
-	{6400, 0x78},
-	{12800, 0x78+8},
-};
+	// Snap to the closest neighbour, by ratio since these are all stops
+	const struct PtpEOSPair *below = NULL, *above = NULL;
+	if (lo > 0 && t->sorted[lo - 1].value > 0) below = &t->sorted[lo - 1];
+	if (lo < t->length) above = &t->sorted[lo];
 
-int ptp_eos_get_iso(int data, int dir) {
-	for (int i = 0; i < (int)(sizeof(canon_iso) / sizeof(struct CanonISO)); i++) {
-		if (dir) {
-			if (canon_iso[i].value == data) {
-				return canon_iso[i].data;
-			}
-		} else {
-			if (canon_iso[i].data == data) {
-				return canon_iso[i].value;
-			}
-		}
+	if (below == NULL && above == NULL) return data;
+	if (below == NULL) return above->data;
+	if (above == NULL) return below->data;
+
+	if ((uint64_t)data * data < (uint64_t)below->value * above->value) {
+		return below->data;
 	}
 
-	return data;
+	return above->data;
 }
 
-struct CanonWhiteBalance {
-	int value;
-	int data;
-}canon_white_balance[] = {
-	{0, 0}, // AUTO
-	{1, 1}, // Daylight
-	{2, 8}, // Shade
-	{3, 3}, // Tungsten/Incandescent
-	{4, 4}, // White florescent
-};
-
-int ptp_eos_get_white_balance(int data, int dir) {
-	for (int i = 0; i < (int)(sizeof(struct CanonWhiteBalance) / sizeof(struct CanonWhiteBalance)); i++) {
-		if (dir) {
-			if (canon_white_balance[i].value == data) {
-				return canon_white_balance[i].data;
-			}
-		} else {
-			if (canon_white_balance[i].data == data) {
-				return canon_white_balance[i].value;
-			}
-		}
-	}
+int ptp_eos_get_shutter(int data, int dir) {
+	return ptp_eos_table_lookup(&ptp_eos_shutter_table, data, dir, 1);
+}
 
-	return data;
+int ptp_eos_get_iso(int data, int dir) {
+	return ptp_eos_table_lookup(&ptp_eos_iso_table, data, dir, 1);
 }
 
-struct CanonAperture {
-	int value;
-	int data;
-}canon_aperture[] = {
-	{12, 0xd},
-	{14, 0x10},
-	{16, 0x13},
-	{18, 0x15},
-	{20, 0x18},
-	{22, 0x1b},
-	{25, 0x1d},
-	{28, 0x20},
-	{32, 0x23},
-	{35, 0x25},
-	{40, 0x28},
-	{45, 0x2b},
-	{50, 0x2d},
-	{56, 0x30},
-	{63, 0x33},
-	{71, 0x35},
-	{80, 0x38},
-	{90, 0x3b},
-	{100, 0x3d},
-	{110, 0x40},
-	{130, 0x43},
-	{140, 0x45},
-	{160, 0x48},
-	{180, 0x4b},
-	{200, 0x4d},
-	{220, 0x50},
-	{250, 0x53},
-	{290, 0x55},
-	{320, 0x58},
-};
+int ptp_eos_get_white_balance(int data, int dir) {
+	return ptp_eos_table_lookup(&ptp_eos_white_balance_table, data, dir, 0);
+}
 
 int ptp_eos_get_aperture(int data, int dir) {
-	for (int i = 0; i < (int)(sizeof(canon_aperture) / sizeof(struct CanonAperture)); i++) {
-		if (dir) {
-			if (canon_aperture[i].value == data) {
-				return canon_aperture[i].data;
-			}
-		} else {
-			if (canon_aperture[i].data == data) {
-				return canon_aperture[i].value;
-			}
-		}
-	}
-
-	return data;
+	return ptp_eos_table_lookup(&ptp_eos_aperture_table, data, dir, 1);
 }
 
 // Lots of confusing types (resolutions, raw+jpeg, superfine, etc)
@@ -0,0 +1,413 @@
+// autogenerated file, see datasets.py
+#include <stdint.h>
+#include <string.h>
+#include <camlib.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+static inline uint8_t ld_u8(uint8_t *d) {
+	return d[0];
+}
+
+static inline uint16_t ld_u16(uint8_t *d) {
+	return (uint16_t)(d[0] | (d[1] << 8));
+}
+
+static inline uint32_t ld_u32(uint8_t *d) {
+	return (uint32_t)d[0] | ((uint32_t)d[1] << 8) | ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+}
+
+static inline uint64_t ld_u64(uint8_t *d) {
+	return (uint64_t)ld_u32(d) | ((uint64_t)ld_u32(d + 4) << 32);
+}
+
+static inline void st_u8(uint8_t *d, uint8_t x) {
+	d[0] = x;
+}
+
+static inline void st_u16(uint8_t *d, uint16_t x) {
+	d[0] = x; d[1] = x >> 8;
+}
+
+static inline void st_u32(uint8_t *d, uint32_t x) {
+	d[0] = x; d[1] = x >> 8; d[2] = x >> 16; d[3] = x >> 24;
+}
+
+static inline void st_u64(uint8_t *d, uint64_t x) {
+	st_u32(d, (uint32_t)x); st_u32(d + 4, (uint32_t)(x >> 32));
+}
+
+// UTF-16 to UTF-8, truncated to fit max (including the null)
+static int unpack_string(uint8_t *d, int length, char *out, int max) {
+	if (length < 1) return PTP_RUNTIME_ERR;
+	int chars = d[0];
+	if (length < 1 + (chars * 2)) return PTP_RUNTIME_ERR;
+
+	int len = 0;
+	for (int i = 0; i < chars; i++) {
+		uint16_t c = ld_u16(d + 1 + (i * 2));
+		if (c == 0) break;
+		if (c < 0x80) {
+			if (len + 1 >= max) break;
+			out[len++] = c;
+		} else if (c < 0x800) {
+			if (len + 2 >= max) break;
+			out[len++] = 0xc0 | (c >> 6);
+			out[len++] = 0x80 | (c & 0x3f);
+		} else {
+			if (len + 3 >= max) break;
+			out[len++] = 0xe0 | (c >> 12);
+			out[len++] = 0x80 | ((c >> 6) & 0x3f);
+			out[len++] = 0x80 | (c & 0x3f);
+		}
+	}
+
+	out[len] = '\0';
+	return 1 + (chars * 2);
+}
+
+// ASCII/Latin-1 to UTF-16, an empty string is a single zero count
+static int pack_string(uint8_t *d, int max, char *in) {
+	int len = strlen(in);
+	if (len > 254) len = 254;
+	int chars = len ? len + 1 : 0;
+	if (max < 1 + (chars * 2)) return PTP_OUT_OF_MEM;
+
+	d[0] = chars;
+	for (int i = 0; i < len; i++) {
+		st_u16(d + 1 + (i * 2), (uint8_t)in[i]);
+	}
+
+	if (chars) st_u16(d + 1 + (len * 2), 0);
+	return 1 + (chars * 2);
+}
+
+// Elements that don't fit are skipped
+static int unpack_array16(uint8_t *d, int length, uint16_t *out, int max, int *out_length) {
+	if (length < 4) return PTP_RUNTIME_ERR;
+	uint32_t n = ld_u32(d);
+	if (n > (uint32_t)(length - 4) / 2) return PTP_RUNTIME_ERR;
+
+	int count = (n > (uint32_t)max) ? max : (int)n;
+	for (int i = 0; i < count; i++) {
+		out[i] = ld_u16(d + 4 + (i * 2));
+	}
+
+	*out_length = count;
+	return 4 + (n * 2);
+}
+
+static int unpack_array32(uint8_t *d, int length, uint32_t *out, int max, int *out_length) {
+	if (length < 4) return PTP_RUNTIME_ERR;
+	uint32_t n = ld_u32(d);
+	if (n > (uint32_t)(length - 4) / 4) return PTP_RUNTIME_ERR;
+
+	int count = (n > (uint32_t)max) ? max : (int)n;
+	for (int i = 0; i < count; i++) {
+		out[i] = ld_u32(d + 4 + (i * 4));
+	}
+
+	*out_length = count;
+	return 4 + (n * 4);
+}
+
+static int pack_array16(uint8_t *d, int max, uint16_t *in, int length) {
+	if (max < 4 + (length * 2)) return PTP_OUT_OF_MEM;
+	st_u32(d, length);
+	for (int i = 0; i < length; i++) {
+		st_u16(d + 4 + (i * 2), in[i]);
+	}
+
+	return 4 + (length * 2);
+}
+
+static int pack_array32(uint8_t *d, int max, uint32_t *in, int length) {
+	if (max < 4 + (length * 4)) return PTP_OUT_OF_MEM;
+	st_u32(d, length);
+	for (int i = 0; i < length; i++) {
+		st_u32(d + 4 + (i * 4), in[i]);
+	}
+
+	return 4 + (length * 4);
+}
+
+int ptp_read_device_info(uint8_t *d, int length, struct PtpDeviceInfo *out) {
+	int of = 0;
+	int x;
+
+	if (length - of < 8) return PTP_RUNTIME_ERR;
+	out->standard_version = ld_u16(d + of); of += 2;
+	out->vendor_ext_id = ld_u32(d + of); of += 4;
+	out->version = ld_u16(d + of); of += 2;
+
+	x = unpack_string(d + of, length - of, out->extensions, sizeof(out->extensions));
+	if (x < 0) return x;
+	of += x;
+
+	if (length - of < 2) return PTP_RUNTIME_ERR;
+	out->functional_mode = ld_u16(d + of); of += 2;
+
+	x = unpack_array16(d + of, length - of, out->ops_supported, sizeof(out->ops_supported) / sizeof(out->ops_supported[0]), &out->ops_supported_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_array16(d + of, length - of, out->events_supported, sizeof(out->events_supported) / sizeof(out->events_supported[0]), &out->events_supported_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_array16(d + of, length - of, out->props_supported, sizeof(out->props_supported) / sizeof(out->props_supported[0]), &out->props_supported_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_array16(d + of, length - of, out->capture_formats, sizeof(out->capture_formats) / sizeof(out->capture_formats[0]), &out->capture_formats_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_array16(d + of, length - of, out->playback_formats, sizeof(out->playback_formats) / sizeof(out->playback_formats[0]), &out->playback_formats_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->manufacturer, sizeof(out->manufacturer));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->model, sizeof(out->model));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->device_version, sizeof(out->device_version));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->serial_number, sizeof(out->serial_number));
+	if (x < 0) return x;
+	of += x;
+
+	return of;
+}
+
+int ptp_write_device_info(uint8_t *d, int max, struct PtpDeviceInfo *in) {
+	int of = 0;
+	int x;
+
+	if (max - of < 8) return PTP_OUT_OF_MEM;
+	st_u16(d + of, in->standard_version); of += 2;
+	st_u32(d + of, in->vendor_ext_id); of += 4;
+	st_u16(d + of, in->version); of += 2;
+
+	x = pack_string(d + of, max - of, in->extensions);
+	if (x < 0) return x;
+	of += x;
+
+	if (max - of < 2) return PTP_OUT_OF_MEM;
+	st_u16(d + of, in->functional_mode); of += 2;
+
+	x = pack_array16(d + of, max - of, in->ops_supported, in->ops_supported_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_array16(d + of, max - of, in->events_supported, in->events_supported_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_array16(d + of, max - of, in->props_supported, in->props_supported_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_array16(d + of, max - of, in->capture_formats, in->capture_formats_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_array16(d + of, max - of, in->playback_formats, in->playback_formats_length);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->manufacturer);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->model);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->device_version);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->serial_number);
+	if (x < 0) return x;
+	of += x;
+
+	return of;
+}
+
+int ptp_read_object_info(uint8_t *d, int length, struct PtpObjectInfo *out) {
+	int of = 0;
+	int x;
+
+	if (length - of < 52) return PTP_RUNTIME_ERR;
+	out->storage_id = ld_u32(d + of); of += 4;
+	out->obj_format = ld_u16(d + of); of += 2;
+	out->protection = ld_u16(d + of); of += 2;
+	out->compressed_size = ld_u32(d + of); of += 4;
+	out->thumb_size = ld_u16(d + of); of += 2;
+	out->thumb_compressed_size = ld_u32(d + of); of += 4;
+	out->thumb_width = ld_u32(d + of); of += 4;
+	out->thumb_height = ld_u32(d + of); of += 4;
+	out->img_width = ld_u32(d + of); of += 4;
+	out->img_height = ld_u32(d + of); of += 4;
+	out->img_bit_depth = ld_u32(d + of); of += 4;
+	out->parent_obj = ld_u32(d + of); of += 4;
+	out->assoc_type = ld_u16(d + of); of += 2;
+	out->assoc_desc = ld_u32(d + of); of += 4;
+	out->sequence_num = ld_u32(d + of); of += 4;
+
+	x = unpack_string(d + of, length - of, out->filename, sizeof(out->filename));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->date_created, sizeof(out->date_created));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->date_modified, sizeof(out->date_modified));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->keywords, sizeof(out->keywords));
+	if (x < 0) return x;
+	of += x;
+
+	return of;
+}
+
+int ptp_write_object_info(uint8_t *d, int max, struct PtpObjectInfo *in) {
+	int of = 0;
+	int x;
+
+	if (max - of < 52) return PTP_OUT_OF_MEM;
+	st_u32(d + of, in->storage_id); of += 4;
+	st_u16(d + of, in->obj_format); of += 2;
+	st_u16(d + of, in->protection); of += 2;
+	st_u32(d + of, in->compressed_size); of += 4;
+	st_u16(d + of, in->thumb_size); of += 2;
+	st_u32(d + of, in->thumb_compressed_size); of += 4;
+	st_u32(d + of, in->thumb_width); of += 4;
+	st_u32(d + of, in->thumb_height); of += 4;
+	st_u32(d + of, in->img_width); of += 4;
+	st_u32(d + of, in->img_height); of += 4;
+	st_u32(d + of, in->img_bit_depth); of += 4;
+	st_u32(d + of, in->parent_obj); of += 4;
+	st_u16(d + of, in->assoc_type); of += 2;
+	st_u32(d + of, in->assoc_desc); of += 4;
+	st_u32(d + of, in->sequence_num); of += 4;
+
+	x = pack_string(d + of, max - of, in->filename);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->date_created);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->date_modified);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->keywords);
+	if (x < 0) return x;
+	of += x;
+
+	return of;
+}
+
+int ptp_read_storage_info(uint8_t *d, int length, struct PtpStorageInfo *out) {
+	int of = 0;
+	int x;
+
+	if (length - of < 26) return PTP_RUNTIME_ERR;
+	out->storage_type = ld_u16(d + of); of += 2;
+	out->fs_type = ld_u16(d + of); of += 2;
+	out->access_capability = ld_u16(d + of); of += 2;
+	out->max_capacity = ld_u64(d + of); of += 8;
+	out->free_space = ld_u64(d + of); of += 8;
+	out->free_objects = ld_u32(d + of); of += 4;
+
+	x = unpack_string(d + of, length - of, out->storage_description, sizeof(out->storage_description));
+	if (x < 0) return x;
+	of += x;
+
+	x = unpack_string(d + of, length - of, out->volume_identifier, sizeof(out->volume_identifier));
+	if (x < 0) return x;
+	of += x;
+
+	return of;
+}
+
+int ptp_write_storage_info(uint8_t *d, int max, struct PtpStorageInfo *in) {
+	int of = 0;
+	int x;
+
+	if (max - of < 26) return PTP_OUT_OF_MEM;
+	st_u16(d + of, in->storage_type); of += 2;
+	st_u16(d + of, in->fs_type); of += 2;
+	st_u16(d + of, in->access_capability); of += 2;
+	st_u64(d + of, in->max_capacity); of += 8;
+	st_u64(d + of, in->free_space); of += 8;
+	st_u32(d + of, in->free_objects); of += 4;
+
+	x = pack_string(d + of, max - of, in->storage_description);
+	if (x < 0) return x;
+	of += x;
+
+	x = pack_string(d + of, max - of, in->volume_identifier);
+	if (x < 0) return x;
+	of += x;
+
+	return of;
+}
+
+int ptp_read_prop_desc(uint8_t *d, int length, struct PtpDevPropDesc *out) {
+	int of = 0;
+
+	if (length - of < 5) return PTP_RUNTIME_ERR;
+	out->code = ld_u16(d + of); of += 2;
+	out->data_type = ld_u16(d + of); of += 2;
+	out->read_only = ld_u8(d + of); of += 1;
+
+	return of;
+}
+
+int ptp_write_prop_desc(uint8_t *d, int max, struct PtpDevPropDesc *in) {
+	int of = 0;
+
+	if (max - of < 5) return PTP_OUT_OF_MEM;
+	st_u16(d + of, in->code); of += 2;
+	st_u16(d + of, in->data_type); of += 2;
+	st_u8(d + of, in->read_only); of += 1;
+
+	return of;
+}
+
+int ptp_read_eos_viewfinder_data(uint8_t *d, int length, struct PtpEOSViewFinderData *out) {
+	int of = 0;
+
+	if (length - of < 8) return PTP_RUNTIME_ERR;
+	out->length = ld_u32(d + of); of += 4;
+	out->type = ld_u32(d + of); of += 4;
+
+	return of;
+}
+
+int ptp_write_eos_viewfinder_data(uint8_t *d, int max, struct PtpEOSViewFinderData *in) {
+	int of = 0;
+
+	if (max - of < 8) return PTP_OUT_OF_MEM;
+	st_u32(d + of, in->length); of += 4;
+	st_u32(d + of, in->type); of += 4;
+
+	return of;
+}
+
@@ -0,0 +1,268 @@
+# Generates dataset_dump.c, readers and writers for PTP datasets
+# Each dataset is described once here, as a list of (type, field) pairs:
+# u8/u16/u32/u64 - little endian integer
+# str            - PTP string (count + UTF-16), into a char array
+# a16/a32        - PTP array (u32 count + elements), into an array with a
+#                  <field>_length int next to it
+# Runs of fixed size fields are bounds checked once, and use byte loads so
+# that the output works on big endian and strict alignment targets.
+
+datasets = [
+    ("device_info", "PtpDeviceInfo", [
+        ("u16", "standard_version"),
+        ("u32", "vendor_ext_id"),
+        ("u16", "version"),
+        ("str", "extensions"),
+        ("u16", "functional_mode"),
+        ("a16", "ops_supported"),
+        ("a16", "events_supported"),
+        ("a16", "props_supported"),
+        ("a16", "capture_formats"),
+        ("a16", "playback_formats"),
+        ("str", "manufacturer"),
+        ("str", "model"),
+        ("str", "device_version"),
+        ("str", "serial_number"),
+    ]),
+    ("object_info", "PtpObjectInfo", [
+        ("u32", "storage_id"),
+        ("u16", "obj_format"),
+        ("u16", "protection"),
+        ("u32", "compressed_size"),
+        ("u16", "thumb_size"),
+        ("u32", "thumb_compressed_size"),
+        ("u32", "thumb_width"),
+        ("u32", "thumb_height"),
+        ("u32", "img_width"),
+        ("u32", "img_height"),
+        ("u32", "img_bit_depth"),
+        ("u32", "parent_obj"),
+        ("u16", "assoc_type"),
+        ("u32", "assoc_desc"),
+        ("u32", "sequence_num"),
+        ("str", "filename"),
+        ("str", "date_created"),
+        ("str", "date_modified"),
+        ("str", "keywords"),
+    ]),
+    ("storage_info", "PtpStorageInfo", [
+        ("u16", "storage_type"),
+        ("u16", "fs_type"),
+        ("u16", "access_capability"),
+        ("u64", "max_capacity"),
+        ("u64", "free_space"),
+        ("u32", "free_objects"),
+        ("str", "storage_description"),
+        ("str", "volume_identifier"),
+    ]),
+    # Fixed part only, values depend on data_type (see ptp_parse_prop_desc)
+    ("prop_desc", "PtpDevPropDesc", [
+        ("u16", "code"),
+        ("u16", "data_type"),
+        ("u8", "read_only"),
+    ]),
+    # EOS records
+    ("eos_viewfinder_data", "PtpEOSViewFinderData", [
+        ("u32", "length"),
+        ("u32", "type"),
+    ]),
+]
+
+sizes = {"u8": 1, "u16": 2, "u32": 4, "u64": 8}
+
+# Split a field list into runs of fixed size fields and single variable fields
+def runs(fields):
+    out = []
+    for f in fields:
+        if f[0] in sizes:
+            if len(out) and out[-1][0] == "fixed":
+                out[-1][1].append(f)
+            else:
+                out.append(("fixed", [f]))
+        else:
+            out.append(("var", f))
+    return out
+
+def gen_unpack(name, struct, fields):
+    s = "int ptp_read_" + name + "(uint8_t *d, int length, struct " + struct + " *out) {\n"
+    s += "\tint of = 0;\n"
+    if any(t not in sizes for t, n in fields):
+        s += "\tint x;\n"
+    for kind, f in runs(fields):
+        if kind == "fixed":
+            total = sum(sizes[t] for t, n in f)
+            s += "\n\tif (length - of < " + str(total) + ") return PTP_RUNTIME_ERR;\n"
+            for t, n in f:
+                s += "\tout->" + n + " = ld_" + t + "(d + of); of += " + str(sizes[t]) + ";\n"
+        else:
+            t, n = f
+            if t == "str":
+                s += "\n\tx = unpack_string(d + of, length - of, out->" + n + ", sizeof(out->" + n + "));\n"
+            else:
+                elem = t[1:]
+                s += "\n\tx = unpack_array" + elem + "(d + of, length - of, out->" + n + ", sizeof(out->" + n + ") / sizeof(out->" + n + "[0]), &out->" + n + "_length);\n"
+            s += "\tif (x < 0) return x;\n\tof += x;\n"
+    s += "\n\treturn of;\n}\n\n"
+    return s
+
+def gen_pack(name, struct, fields):
+    s = "int ptp_write_" + name + "(uint8_t *d, int max, struct " + struct + " *in) {\n"
+    s += "\tint of = 0;\n"
+    if any(t not in sizes for t, n in fields):
+        s += "\tint x;\n"
+    for kind, f in runs(fields):
+        if kind == "fixed":
+            total = sum(sizes[t] for t, n in f)
+            s += "\n\tif (max - of < " + str(total) + ") return PTP_OUT_OF_MEM;\n"
+            for t, n in f:
+                s += "\tst_" + t + "(d + of, in->" + n + "); of += " + str(sizes[t]) + ";\n"
+        else:
+            t, n = f
+            if t == "str":
+                s += "\n\tx = pack_string(d + of, max - of, in->" + n + ");\n"
+            else:
+                elem = t[1:]
+                s += "\n\tx = pack_array" + elem + "(d + of, max - of, in->" + n + ", in->" + n + "_length);\n"
+            s += "\tif (x < 0) return x;\n\tof += x;\n"
+    s += "\n\treturn of;\n}\n\n"
+    return s
+
+helpers = r"""static inline uint8_t ld_u8(uint8_t *d) {
+	return d[0];
+}
+
+static inline uint16_t ld_u16(uint8_t *d) {
+	return (uint16_t)(d[0] | (d[1] << 8));
+}
+
+static inline uint32_t ld_u32(uint8_t *d) {
+	return (uint32_t)d[0] | ((uint32_t)d[1] << 8) | ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
+}
+
+static inline uint64_t ld_u64(uint8_t *d) {
+	return (uint64_t)ld_u32(d) | ((uint64_t)ld_u32(d + 4) << 32);
+}
+
+static inline void st_u8(uint8_t *d, uint8_t x) {
+	d[0] = x;
+}
+
+static inline void st_u16(uint8_t *d, uint16_t x) {
+	d[0] = x; d[1] = x >> 8;
+}
+
+static inline void st_u32(uint8_t *d, uint32_t x) {
+	d[0] = x; d[1] = x >> 8; d[2] = x >> 16; d[3] = x >> 24;
+}
+
+static inline void st_u64(uint8_t *d, uint64_t x) {
+	st_u32(d, (uint32_t)x); st_u32(d + 4, (uint32_t)(x >> 32));
+}
+
+// UTF-16 to UTF-8, truncated to fit max (including the null)
+static int unpack_string(uint8_t *d, int length, char *out, int max) {
+	if (length < 1) return PTP_RUNTIME_ERR;
+	int chars = d[0];
+	if (length < 1 + (chars * 2)) return PTP_RUNTIME_ERR;
+
+	int len = 0;
+	for (int i = 0; i < chars; i++) {
+		uint16_t c = ld_u16(d + 1 + (i * 2));
+		if (c == 0) break;
+		if (c < 0x80) {
+			if (len + 1 >= max) break;
+			out[len++] = c;
+		} else if (c < 0x800) {
+			if (len + 2 >= max) break;
+			out[len++] = 0xc0 | (c >> 6);
+			out[len++] = 0x80 | (c & 0x3f);
+		} else {
+			if (len + 3 >= max) break;
+			out[len++] = 0xe0 | (c >> 12);
+			out[len++] = 0x80 | ((c >> 6) & 0x3f);
+			out[len++] = 0x80 | (c & 0x3f);
+		}
+	}
+
+	out[len] = '\0';
+	return 1 + (chars * 2);
+}
+
+// ASCII/Latin-1 to UTF-16, an empty string is a single zero count
+static int pack_string(uint8_t *d, int max, char *in) {
+	int len = strlen(in);
+	if (len > 254) len = 254;
+	int chars = len ? len + 1 : 0;
+	if (max < 1 + (chars * 2)) return PTP_OUT_OF_MEM;
+
+	d[0] = chars;
+	for (int i = 0; i < len; i++) {
+		st_u16(d + 1 + (i * 2), (uint8_t)in[i]);
+	}
+
+	if (chars) st_u16(d + 1 + (len * 2), 0);
+	return 1 + (chars * 2);
+}
+
+// Elements that don't fit are skipped
+static int unpack_array16(uint8_t *d, int length, uint16_t *out, int max, int *out_length) {
+	if (length < 4) return PTP_RUNTIME_ERR;
+	uint32_t n = ld_u32(d);
+	if (n > (uint32_t)(length - 4) / 2) return PTP_RUNTIME_ERR;
+
+	int count = (n > (uint32_t)max) ? max : (int)n;
+	for (int i = 0; i < count; i++) {
+		out[i] = ld_u16(d + 4 + (i * 2));
+	}
+
+	*out_length = count;
+	return 4 + (n * 2);
+}
+
+static int unpack_array32(uint8_t *d, int length, uint32_t *out, int max, int *out_length) {
+	if (length < 4) return PTP_RUNTIME_ERR;
+	uint32_t n = ld_u32(d);
+	if (n > (uint32_t)(length - 4) / 4) return PTP_RUNTIME_ERR;
+
+	int count = (n > (uint32_t)max) ? max : (int)n;
+	for (int i = 0; i < count; i++) {
+		out[i] = ld_u32(d + 4 + (i * 4));
+	}
+
+	*out_length = count;
+	return 4 + (n * 4);
+}
+
+static int pack_array16(uint8_t *d, int max, uint16_t *in, int length) {
+	if (max < 4 + (length * 2)) return PTP_OUT_OF_MEM;
+	st_u32(d, length);
+	for (int i = 0; i < length; i++) {
+		st_u16(d + 4 + (i * 2), in[i]);
+	}
+
+	return 4 + (length * 2);
+}
+
+static int pack_array32(uint8_t *d, int max, uint32_t *in, int length) {
+	if (max < 4 + (length * 4)) return PTP_OUT_OF_MEM;
+	st_u32(d, length);
+	for (int i = 0; i < length; i++) {
+		st_u32(d + 4 + (i * 4), in[i]);
+	}
+
+	return 4 + (length * 4);
+}
+
+"""
+
+output = "// autogenerated file, see datasets.py\n#include <stdint.h>\n#include <string.h>\n#include <camlib.h>\n\n"
+output += "#ifdef __GNUC__\n#pragma GCC diagnostic ignored \"-Wunused-function\"\n#endif\n\n"
+output += helpers
+for name, struct, fields in datasets:
+    output += gen_unpack(name, struct, fields)
+    output += gen_pack(name, struct, fields)
+
+print("Compiled", len(datasets), "datasets")
+f = open("dataset_dump.c", "w")
+f.write(output)
+f.close()
@@ -61,6 +61,7 @@ struct PtpEnum ptp_enums[] = {
 {PTP_OC, PTP_DEV_EOS, "SetRemoteMode", 0x9114},
 {PTP_OC, PTP_DEV_EOS, "SetEventMode", 0x9115},
 {PTP_OC, PTP_DEV_EOS, "GetEvent", 0x9116},
+{PTP_OC, PTP_DEV_EOS, "TransferComplete", 0x9117},
 {PTP_OC, PTP_DEV_EOS, "PCHDDCapacity", 0x911A},
 {PTP_OC, PTP_DEV_EOS, "SetUILock", 0x911B},
 {PTP_OC, PTP_DEV_EOS, "ResetUILock", 0x911C},
@@ -78,6 +79,8 @@ struct PtpEnum ptp_enums[] = {
 {PTP_OC, PTP_DEV_EOS, "DoAutoFocus", 0x9154},
 {PTP_OC, PTP_DEV_EOS, "AfCancel", 0x9160},
 {PTP_OC, PTP_DEV_EOS, "SetDefaultSetting", 0x91BE},
+{PTP_OC, PTP_DEV_FUJI, "SendObjectInfo", 0x900c},
+{PTP_OC, PTP_DEV_FUJI, "SendObject", 0x901d},
 {PTP_ENUM, 0, "EOS_DESTINATION_CAM", 0x2},
 {PTP_ENUM, 0, "EOS_DESTINATION_PC", 0x4},
 {PTP_ENUM, 0, "EOS_DESTINATION_BOTH", 0x6},
@@ -223,6 +226,16 @@ struct PtpEnum ptp_enums[] = {
 {PTP_PC, PTP_DEV_EMPTY, "FocalDistance", 0x5009},
 {PTP_PC, PTP_DEV_EMPTY, "FocusMode", 0x500A},
 {PTP_PC, PTP_DEV_EMPTY, "DateTime", 0x5011},
+{PTP_ENUM, 0, "PTP_OPC_StorageID", 0xDC01},
+{PTP_ENUM, 0, "PTP_OPC_ObjectFormat", 0xDC02},
+{PTP_ENUM, 0, "PTP_OPC_ProtectionStatus", 0xDC03},
+{PTP_ENUM, 0, "PTP_OPC_ObjectSize", 0xDC04},
+{PTP_ENUM, 0, "PTP_OPC_ObjectFileName", 0xDC07},
+{PTP_ENUM, 0, "PTP_OPC_DateCreated", 0xDC08},
+{PTP_ENUM, 0, "PTP_OPC_DateModified", 0xDC09},
+{PTP_ENUM, 0, "PTP_OPC_Keywords", 0xDC0A},
+{PTP_ENUM, 0, "PTP_OPC_ParentObject", 0xDC0B},
+{PTP_ENUM, 0, "PTP_OPC_Name", 0xDC44},
 {PTP_PC, PTP_DEV_CANON, "BeepCode", 0xD001},
 {PTP_PC, PTP_DEV_CANON, "ViewFinderMode", 0xD003},
 {PTP_PC, PTP_DEV_CANON, "ImageQuality", 0xD006},
@@ -340,4 +353,4 @@ struct PtpEnum ptp_enums[] = {
 {PTP_ENUM, 0, "USB_RECIP_ENDPOINT", 0x02},
 {PTP_ENUM, 0, "USB_TYPE_CLASS", 0x20},
 
-};int ptp_enums_length = 338;
+};int ptp_enums_length = 351;
@@ -0,0 +1,254 @@
+// autogenerated file, see eostables.py
+#include <camlib.h>
+
+static const struct PtpEOSPair shutter_sorted[] = {
+	{0, 0xc},
+	{6, 0xa8},
+	{7, 0xa5},
+	{10, 0xa3},
+	{12, 0xa0},
+	{15, 0x9d},
+	{20, 0x9b},
+	{25, 0x98},
+	{31, 0x95},
+	{40, 0x93},
+	{50, 0x90},
+	{62, 0x8d},
+	{80, 0x8b},
+	{100, 0x88},
+	{125, 0x85},
+	{156, 0x83},
+	{200, 0x80},
+	{250, 0x7d},
+	{312, 0x7b},
+	{400, 0x78},
+	{500, 0x75},
+	{625, 0x73},
+	{800, 0x70},
+	{1000, 0x6d},
+	{1250, 0x6b},
+	{1666, 0x68},
+	{2000, 0x65},
+	{2500, 0x63},
+	{3333, 0x60},
+	{4000, 0x5d},
+	{5000, 0x5b},
+	{6666, 0x58},
+	{7692, 0x55},
+	{10000, 0x53},
+	{12500, 0x50},
+	{16666, 0x4d},
+	{20000, 0x4b},
+	{25000, 0x48},
+	{30000, 0x45},
+	{40000, 0x43},
+	{50000, 0x40},
+	{60000, 0x3d},
+	{80000, 0x3b},
+	{100000, 0x38},
+	{130000, 0x35},
+	{160000, 0x33},
+	{200000, 0x30},
+	{250000, 0x2d},
+	{320000, 0x2b},
+	{400000, 0x28},
+	{500000, 0x25},
+	{600000, 0x23},
+	{800000, 0x20},
+	{1000000, 0x1d},
+	{1300000, 0x1b},
+	{1500000, 0x18},
+	{2000000, 0x15},
+	{2500000, 0x13},
+	{3000000, 0x10},
+};
+
+const struct PtpEOSTable ptp_eos_shutter_table = {
+	{
+		-1,-1,-1,-1,0,-1,-1,-1,-1,-1,-1,-1,0,-1,-1,-1,
+		3000000,-1,-1,2500000,-1,2000000,-1,-1,1500000,-1,-1,1300000,-1,1000000,-1,-1,
+		800000,-1,-1,600000,-1,500000,-1,-1,400000,-1,-1,320000,-1,250000,-1,-1,
+		200000,-1,-1,160000,-1,130000,-1,-1,100000,-1,-1,80000,-1,60000,-1,-1,
+		50000,-1,-1,40000,-1,30000,-1,-1,25000,-1,-1,20000,-1,16666,-1,-1,
+		12500,-1,-1,10000,-1,7692,-1,-1,6666,-1,-1,5000,-1,4000,-1,-1,
+		3333,-1,-1,2500,-1,2000,-1,-1,1666,-1,-1,1250,-1,1000,-1,-1,
+		800,-1,-1,625,-1,500,-1,-1,400,-1,-1,312,-1,250,-1,-1,
+		200,-1,-1,156,-1,125,-1,-1,100,-1,-1,80,-1,62,-1,-1,
+		50,-1,-1,40,-1,31,-1,-1,25,-1,-1,20,-1,15,-1,-1,
+		12,-1,-1,10,-1,7,-1,-1,6,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	},
+	shutter_sorted,
+	59,
+};
+
+static const struct PtpEOSPair iso_sorted[] = {
+	{0, 0x0},
+	{50, 0x40},
+	{100, 0x48},
+	{125, 0x4b},
+	{160, 0x4d},
+	{200, 0x50},
+	{250, 0x53},
+	{320, 0x55},
+	{400, 0x58},
+	{500, 0x5b},
+	{640, 0x5d},
+	{800, 0x60},
+	{1000, 0x63},
+	{1250, 0x65},
+	{1600, 0x68},
+	{2000, 0x6b},
+	{2500, 0x6d},
+	{3200, 0x70},
+	{4000, 0x73},
+	{5000, 0x75},
+	{6400, 0x78},
+	{8000, 0x7b},
+	{10000, 0x7d},
+	{12800, 0x80},
+	{16000, 0x83},
+	{20000, 0x85},
+	{25600, 0x88},
+	{32000, 0x8b},
+	{40000, 0x8d},
+	{51200, 0x90},
+	{64000, 0x93},
+	{80000, 0x95},
+	{102400, 0x98},
+	{204800, 0xa0},
+	{409600, 0xa8},
+	{819200, 0xb0},
+};
+
+const struct PtpEOSTable ptp_eos_iso_table = {
+	{
+		0,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		50,-1,-1,-1,-1,-1,-1,-1,100,-1,-1,125,-1,160,-1,-1,
+		200,-1,-1,250,-1,320,-1,-1,400,-1,-1,500,-1,640,-1,-1,
+		800,-1,-1,1000,-1,1250,-1,-1,1600,-1,-1,2000,-1,2500,-1,-1,
+		3200,-1,-1,4000,-1,5000,-1,-1,6400,-1,-1,8000,-1,10000,-1,-1,
+		12800,-1,-1,16000,-1,20000,-1,-1,25600,-1,-1,32000,-1,40000,-1,-1,
+		51200,-1,-1,64000,-1,80000,-1,-1,102400,-1,-1,-1,-1,-1,-1,-1,
+		204800,-1,-1,-1,-1,-1,-1,-1,409600,-1,-1,-1,-1,-1,-1,-1,
+		819200,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	},
+	iso_sorted,
+	36,
+};
+
+static const struct PtpEOSPair white_balance_sorted[] = {
+	{0, 0x0},
+	{1, 0x1},
+	{2, 0x8},
+	{3, 0x3},
+	{4, 0x4},
+};
+
+const struct PtpEOSTable ptp_eos_white_balance_table = {
+	{
+		0,1,-1,3,4,-1,-1,-1,2,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	},
+	white_balance_sorted,
+	5,
+};
+
+static const struct PtpEOSPair aperture_sorted[] = {
+	{10, 0x8},
+	{11, 0xb},
+	{12, 0xd},
+	{14, 0x10},
+	{16, 0x13},
+	{18, 0x15},
+	{20, 0x18},
+	{22, 0x1b},
+	{25, 0x1d},
+	{28, 0x20},
+	{32, 0x23},
+	{35, 0x25},
+	{40, 0x28},
+	{45, 0x2b},
+	{50, 0x2d},
+	{56, 0x30},
+	{63, 0x33},
+	{67, 0x34},
+	{71, 0x35},
+	{80, 0x38},
+	{90, 0x3b},
+	{95, 0x3c},
+	{100, 0x3d},
+	{110, 0x40},
+	{130, 0x43},
+	{140, 0x45},
+	{160, 0x48},
+	{180, 0x4b},
+	{190, 0x4c},
+	{200, 0x4d},
+	{220, 0x50},
+	{250, 0x53},
+	{270, 0x54},
+	{290, 0x55},
+	{320, 0x58},
+	{360, 0x5b},
+	{380, 0x5c},
+	{400, 0x5d},
+	{450, 0x60},
+	{510, 0x63},
+	{540, 0x64},
+	{570, 0x65},
+	{640, 0x68},
+	{720, 0x6b},
+	{760, 0x6c},
+	{810, 0x6d},
+	{910, 0x70},
+};
+
+const struct PtpEOSTable ptp_eos_aperture_table = {
+	{
+		-1,-1,-1,-1,-1,-1,-1,-1,10,-1,-1,11,12,12,-1,-1,
+		14,-1,-1,16,18,18,-1,-1,20,-1,-1,22,25,25,-1,-1,
+		28,-1,-1,32,35,35,-1,-1,40,-1,-1,45,45,50,-1,-1,
+		56,-1,-1,63,67,71,-1,-1,80,-1,-1,90,95,100,-1,-1,
+		110,-1,-1,130,130,140,-1,-1,160,-1,-1,180,190,200,-1,-1,
+		220,-1,-1,250,270,290,-1,-1,320,-1,-1,360,380,400,-1,-1,
+		450,-1,-1,510,540,570,-1,-1,640,-1,-1,720,760,810,-1,-1,
+		910,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	},
+	aperture_sorted,
+	47,
+};
+
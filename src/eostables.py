@@ -0,0 +1,108 @@
+# Generates eostable_dump.c, conversion tables for EOS property values
+# Each table maps camera data (0-255) to a camlib value, and the other way
+# around through a list sorted by value. When a value maps to more than one
+# data code, the first one listed here wins (1/3 stop codes before 1/2 stop).
+
+# value is the exposure time times 100000
+shutter = [
+    (0, 0xc), # BULB 1300D
+    (0, 0x4), # BULB 5dmk3
+    (3000000, 0x10), (2500000, 0x13), (2000000, 0x15),
+    (1500000, 0x18), (1300000, 0x1b), (1000000, 0x1d),
+    (800000, 0x20), (600000, 0x23), (500000, 0x25),
+    (400000, 0x28), (320000, 0x2b), (250000, 0x2d),
+    (200000, 0x30), (160000, 0x33), (130000, 0x35),
+    (100000, 0x38), (80000, 0x3b), (60000, 0x3d),
+    (50000, 0x40), (40000, 0x43), (30000, 0x45),
+    (25000, 0x48), (20000, 0x4b), (16666, 0x4d),
+]
+
+# Fractions of a second, 1/8 to 1/16000
+for denom, data in [(8, 0x50), (10, 0x53), (13, 0x55), (15, 0x58), (20, 0x5b), (25, 0x5d),
+        (30, 0x60), (40, 0x63), (50, 0x65), (60, 0x68), (80, 0x6b), (100, 0x6d),
+        (125, 0x70), (160, 0x73), (200, 0x75), (250, 0x78), (320, 0x7b), (400, 0x7d),
+        (500, 0x80), (640, 0x83), (800, 0x85), (1000, 0x88), (1250, 0x8b), (1600, 0x8d),
+        (2000, 0x90), (2500, 0x93), (3200, 0x95), (4000, 0x98), (5000, 0x9b), (6400, 0x9d),
+        (8000, 0xa0), (10000, 0xa3), (12800, 0xa5), (16000, 0xa8)]:
+    shutter.append((100000 // denom, data))
+
+# Full 1/3 stop range, 50 to 819200
+iso = [
+    (0, 0), # AUTO
+    (50, 0x40), (100, 0x48), (125, 0x4b), (160, 0x4d),
+    (200, 0x50), (250, 0x53), (320, 0x55), (400, 0x58),
+    (500, 0x5b), (640, 0x5d), (800, 0x60), (1000, 0x63),
+    (1250, 0x65), (1600, 0x68), (2000, 0x6b), (2500, 0x6d),
+    (3200, 0x70), (4000, 0x73), (5000, 0x75), (6400, 0x78),
+    (8000, 0x7b), (10000, 0x7d), (12800, 0x80), (16000, 0x83),
+    (20000, 0x85), (25600, 0x88), (32000, 0x8b), (40000, 0x8d),
+    (51200, 0x90), (64000, 0x93), (80000, 0x95), (102400, 0x98),
+    (204800, 0xa0), (409600, 0xa8), (819200, 0xb0),
+]
+
+# camlib value, see bind.c
+white_balance = [
+    (0, 0), # AUTO
+    (1, 1), # Daylight
+    (2, 8), # Shade
+    (3, 3), # Tungsten/Incandescent
+    (4, 4), # White florescent
+]
+
+# value is the f-number times 10
+aperture = [
+    (10, 0x08), (11, 0x0b), (12, 0x0d), (14, 0x10), (16, 0x13), (18, 0x15),
+    (20, 0x18), (22, 0x1b), (25, 0x1d), (28, 0x20), (32, 0x23), (35, 0x25),
+    (40, 0x28), (45, 0x2b), (50, 0x2d), (56, 0x30), (63, 0x33), (71, 0x35),
+    (80, 0x38), (90, 0x3b), (100, 0x3d), (110, 0x40), (130, 0x43), (140, 0x45),
+    (160, 0x48), (180, 0x4b), (200, 0x4d), (220, 0x50), (250, 0x53), (290, 0x55),
+    (320, 0x58), (360, 0x5b), (400, 0x5d), (450, 0x60), (510, 0x63), (570, 0x65),
+    (640, 0x68), (720, 0x6b), (810, 0x6d), (910, 0x70),
+    # 1/2 stop codes
+    (12, 0x0c), (18, 0x14), (25, 0x1c), (35, 0x24), (45, 0x2c), (67, 0x34),
+    (95, 0x3c), (130, 0x44), (190, 0x4c), (270, 0x54), (380, 0x5c), (540, 0x64),
+    (760, 0x6c),
+]
+
+tables = [
+    ("shutter", shutter),
+    ("iso", iso),
+    ("white_balance", white_balance),
+    ("aperture", aperture),
+]
+
+def gen_table(name, pairs):
+    values = [-1] * 256
+    for v, d in pairs:
+        if values[d] == -1:
+            values[d] = v
+
+    seen = set()
+    by_value = []
+    for v, d in pairs:
+        if v not in seen:
+            seen.add(v)
+            by_value.append((v, d))
+    by_value.sort()
+
+    s = "static const struct PtpEOSPair " + name + "_sorted[] = {\n"
+    for v, d in by_value:
+        s += "\t{" + str(v) + ", " + hex(d) + "},\n"
+    s += "};\n\n"
+
+    s += "const struct PtpEOSTable ptp_eos_" + name + "_table = {\n\t{"
+    for i in range(256):
+        if i % 16 == 0:
+            s += "\n\t\t"
+        s += str(values[i]) + ","
+    s += "\n\t},\n\t" + name + "_sorted,\n\t" + str(len(by_value)) + ",\n};\n\n"
+    return s
+
+output = "// autogenerated file, see eostables.py\n#include <camlib.h>\n\n"
+for name, pairs in tables:
+    output += gen_table(name, pairs)
+
+print("Compiled", len(tables), "tables")
+f = open("eostable_dump.c", "w")
+f.write(output)
+f.close()
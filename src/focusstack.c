@@ -0,0 +1,128 @@
+// Focus stacking - step the lens, wait for it to settle, take a frame
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// Lens is considered settled after this many empty event polls in a row
+#define PTP_STACK_IDLE_POLLS 2
+#define PTP_STACK_POLL 5
+
+// Drive commands are refused while the lens is still moving
+static int stack_drive(struct PtpRuntime *r, int step, int timeout) {
+	for (int t = 0; t <= timeout; t += PTP_STACK_POLL) {
+		int x = ptp_eos_drive_lens(r, step);
+		if (x != PTP_CHECK_CODE || ptp_get_return_code(r) != PTP_RC_DeviceBusy) return x;
+		CAMLIB_SLEEP(PTP_STACK_POLL);
+	}
+
+	return PTP_CHECK_CODE;
+}
+
+// Returns 1 if the lens reported its position, 0 for an idle event queue
+static int stack_settle(struct PtpRuntime *r, struct PtpFocusStack *s, uint64_t moved) {
+	int idle = 0;
+	while (1) {
+		int x = ptp_eos_get_event(r);
+		if (x) return x;
+
+		int records = 0;
+		int focus = 0;
+		struct PtpCanonEvent ce;
+		void *e = ptp_open_eos_events(r);
+		while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+			records++;
+			if (ce.type == PTP_EC_EOS_PropValueChanged && ce.code == PTP_PC_EOS_FocusInfoEx) focus = 1;
+		}
+
+		uint64_t waited = ptp_time_us() - moved;
+		if (focus && waited >= (uint64_t)s->settle_min * 1000) {
+			s->by_event++;
+			return 1;
+		}
+
+		idle = records ? 0 : idle + 1;
+		if (idle >= PTP_STACK_IDLE_POLLS && waited >= (uint64_t)s->settle_min * 1000) {
+			s->by_idle++;
+			return 0;
+		}
+
+		if (waited >= (uint64_t)s->settle_max * 1000) {
+			s->timeouts++;
+			return 0;
+		}
+
+		CAMLIB_SLEEP(PTP_STACK_POLL);
+	}
+}
+
+int ptp_eos_focus_stack(struct PtpRuntime *r, struct PtpFocusStack *s) {
+	if (ptp_device_type(r) != PTP_DEV_EOS) return PTP_UNSUPPORTED;
+
+	s->taken = 0;
+	s->steps = 0;
+	s->by_event = 0;
+	s->by_idle = 0;
+	s->timeouts = 0;
+	s->settle_total = 0;
+	s->settle_worst = 0;
+
+	ptp_lock(r);
+	s->start = ptp_time_us();
+
+	int x = 0;
+	for (int i = 0; i < s->frames; i++) {
+		if (i != 0) {
+			for (int m = 0; m < s->moves; m++) {
+				x = stack_drive(r, s->step, s->settle_max);
+				if (x) goto end;
+				uint64_t moved = ptp_time_us();
+				s->steps++;
+
+				// A download takes about as long as the lens needs to move
+				if (s->tether != NULL && s->tether->queue_length) {
+					x = ptp_tether_download_next(r, s->tether);
+					if (x == PTP_IO_ERR) goto end;
+				}
+
+				x = stack_settle(r, s, moved);
+				if (x < 0) goto end;
+
+				uint64_t took = ptp_time_us() - moved;
+				s->settle_total += took;
+				if (took > s->settle_worst) s->settle_worst = took;
+			}
+		}
+
+		x = ptp_take_picture(r);
+		if (x) goto end;
+		s->taken++;
+	}
+
+	// Files still in camera RAM
+	if (s->tether != NULL) {
+		x = ptp_eos_get_event(r);
+		if (x == 0) {
+			x = ptp_tether_download(r, s->tether);
+			if (x > 0) x = 0;
+		}
+	}
+
+	end:;
+	s->end = ptp_time_us();
+	ptp_unlock(r);
+	return x;
+}
+
+int ptp_focus_stack_json(struct PtpFocusStack *s, char *buffer, int max) {
+	double total = (s->end - s->start) / 1000000.0;
+	double settle = s->steps ? (double)s->settle_total / s->steps / 1000.0 : 0;
+	return snprintf(buffer, max, "{\"frames\": %d, \"steps\": %d, \"seconds\": %.2f, \"steps_per_second\": %.2f, "
+		"\"settle\": {\"avg\": %.1f, \"max\": %.1f, \"by_event\": %d, \"by_idle\": %d, \"timeouts\": %d}}",
+		s->taken, s->steps, total, total > 0 ? s->steps / total : 0,
+		settle, s->settle_worst / 1000.0, s->by_event, s->by_idle, s->timeouts);
+}
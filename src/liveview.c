@@ -55,45 +55,202 @@ int ptp_liveview_size(struct PtpRuntime *r) {
 	return 0;
 }
 
+int ptp_liveview_ml_convert(struct PtpRuntime *r, uint8_t *buffer, int format) {
+	int a = ptp_custom_recieve(r, PTP_OC_ML_Live360x240);
+	if (a < 0) {
+		return PTP_IO_ERR;
+	} else if (ptp_get_return_code(r) != PTP_RC_OK) {
+		return PTP_CHECK_CODE;
+	}
+
+	if (ptp_get_payload_length(r) < PTP_ML_LvWidth * PTP_ML_LvHeight * 3) {
+		return PTP_RUNTIME_ERR;
+	}
+
+	return ptp_yuv444_convert(buffer, ptp_get_payload(r), PTP_ML_LvWidth, PTP_ML_LvHeight, format, ML_TRANSPARENCY_PIXEL);
+}
+
 int ptp_liveview_ml(struct PtpRuntime *r, uint8_t *buffer) {
-    int a = ptp_custom_recieve(r, PTP_OC_ML_Live360x240);
-    if (a < 0) {
-        return PTP_IO_ERR;
-    } else if (ptp_get_return_code(r) != PTP_RC_OK) {
-        return PTP_CHECK_CODE;
-    }
-
-    uint8_t *data = ptp_get_payload(r);
-    int length = (PTP_ML_LvWidth * PTP_ML_LvHeight);
-
-    for (int i = 0; i < length; i++) {
-        buffer[0] = data[0];
-        buffer[1] = data[1];
-        buffer[2] = data[2];
-        buffer[3] = ML_TRANSPARENCY_PIXEL;
-        buffer += 4;
-        data += 3;
-    }
-
-    return length * 4;
+	return ptp_liveview_ml_convert(r, buffer, PTP_PIXEL_YUVA);
+}
+
+// The length in the data header isn't checked against what was received
+static int eos_viewfinder_jpeg(struct PtpRuntime *r, struct PtpEOSViewFinderBlock *jpeg) {
+	uint8_t *payload = ptp_get_payload(r);
+	int length = ptp_get_payload_length(r);
+	if (length > (int)(r->data + r->data_length - payload)) length = (int)(r->data + r->data_length - payload);
+
+	return ptp_eos_viewfinder_jpeg(payload, length, jpeg);
 }
 
 // TODO: Random faults
 int ptp_liveview_eos(struct PtpRuntime *r, uint8_t *buffer) {
+	// NotReady comes back as PTP_CHECK_CODE, but the code is stale after an IO error
 	int x = ptp_eos_get_viewfinder_data(r);
-	if (x < 0) return x;
+	if (x == PTP_IO_ERR) return x;
 
 	if (ptp_get_return_code(r) == PTP_RC_CANON_NotReady) {
 		return 0;
 	}
 
-	struct PtpEOSViewFinderData *vfd = (struct PtpEOSViewFinderData *)(ptp_get_payload(r));
-	if (MAX_EOS_JPEG_SIZE < vfd->length) {
+	if (x < 0) return x;
+
+	// Newer bodies send more blocks than the JPEG, in no fixed order
+	struct PtpEOSViewFinderBlock jpeg;
+	if (eos_viewfinder_jpeg(r, &jpeg)) return 0;
+	if (jpeg.length > MAX_EOS_JPEG_SIZE) return 0;
+
+	memcpy(buffer, jpeg.data, jpeg.length);
+	return jpeg.length;
+}
+
+int ptp_liveview_frame_take(struct PtpRuntime *r, uint8_t **buffer, uint8_t **frame) {
+	*buffer = NULL;
+	*frame = NULL;
+	if (ptp_liveview_type(r) != PTP_LV_EOS) return PTP_UNSUPPORTED;
+
+	// No point asking for a frame that can't be handed out
+	if (r->pool == NULL) return PTP_RUNTIME_ERR;
+
+	int x = ptp_eos_get_viewfinder_data(r);
+	if (x == PTP_IO_ERR) return x;
+
+	if (ptp_get_return_code(r) == PTP_RC_CANON_NotReady) {
 		return 0;
 	}
 
-	memcpy(buffer, ptp_get_payload(r) + 8, vfd->length);
-	return vfd->length;
+	if (x < 0) return x;
+
+	struct PtpEOSViewFinderBlock jpeg;
+	if (eos_viewfinder_jpeg(r, &jpeg)) return 0;
+	int offset = jpeg.data - ptp_get_payload(r);
+
+	*buffer = ptp_buffer_take(r);
+	if (*buffer == NULL) return PTP_OUT_OF_MEM;
+
+	*frame = ptp_buffer_payload(*buffer) + offset;
+	return jpeg.length;
+}
+
+// Wait after NotReady while the interval is unknown, short so the first
+// frames are timed closely. It only grows if the camera sends nothing.
+#define PACE_BACKOFF_START 2000
+#define PACE_BACKOFF_MIN 1000
+#define PACE_BACKOFF_MAX 50000
+#define PACE_PATIENCE 25
+
+// Requests aim this much (1/n of the interval) after the frame is due,
+// so small errors in the estimate don't turn into retries
+#define PACE_MARGIN 32
+
+// After this many frames without a retry, requests move earlier by a
+// growing step, so a too long interval is always caught
+#define PACE_CREEP_AFTER 8
+#define PACE_CREEP 64
+
+void ptp_liveview_pacer_reset(struct PtpLiveviewPacer *p) {
+	memset(p, 0, sizeof(struct PtpLiveviewPacer));
+}
+
+void ptp_liveview_pacer_update(struct PtpLiveviewPacer *p, int length, uint64_t sent, uint64_t done) {
+	if (p->start == 0) p->start = sent;
+	p->last = done;
+	p->requests++;
+
+	uint64_t rtt = done - sent;
+	p->cost = p->cost ? ((p->cost * 7) + rtt) / 8 : rtt;
+
+	// When the camera looked for a frame, about halfway through
+	uint64_t check = sent + (rtt / 2);
+
+	if (length == 0) {
+		p->not_ready++;
+		p->misses++;
+		p->last_miss = check;
+
+		uint64_t start = p->interval ? p->interval / 32 : PACE_BACKOFF_START;
+		uint64_t max = p->interval ? p->interval / 2 : PACE_BACKOFF_MAX;
+		if (start < PACE_BACKOFF_MIN) start = PACE_BACKOFF_MIN;
+		if (max < start) max = start;
+
+		if (p->backoff == 0 || (p->interval == 0 && p->misses < PACE_PATIENCE)) {
+			p->backoff = start;
+		} else if (p->backoff < max) {
+			p->backoff *= 2;
+			if (p->backoff > max) p->backoff = max;
+		}
+
+		p->next = done + p->backoff;
+		return;
+	}
+
+	p->frames++;
+
+	uint64_t ready;
+	if (p->last_miss) {
+		// The frame arrived between the miss and this request, which pins
+		// down the camera's timing. Every frame since the last time that
+		// happened was taken once, so the gap is split between them.
+		ready = (p->last_miss + check) / 2;
+		uint32_t n = p->frames - p->anchor_frame;
+		if (p->anchor && ready > p->anchor && n != 0) {
+			uint64_t sample = (ready - p->anchor) / n;
+			if (p->interval == 0 || sample < (p->interval * 3) / 4) {
+				// Frames can't come faster than this, the old value spanned a drop
+				p->interval = sample;
+			} else {
+				p->interval = ((p->interval * 3) + sample) / 4;
+			}
+		}
+		p->anchor = ready;
+		p->anchor_frame = p->frames;
+		p->streak = 0;
+	} else {
+		// It could have been waiting for a while, so keep to the expected
+		// time and creep earlier until a miss measures it again
+		ready = check;
+		if (p->interval) {
+			if (p->arrival + p->interval < ready) ready = p->arrival + p->interval;
+			int over = p->streak - PACE_CREEP_AFTER;
+			if (over >= 0) ready -= (p->interval / PACE_CREEP) << (over < 4 ? over : 4);
+		}
+		p->streak++;
+	}
+
+	p->arrival = ready;
+	p->last_miss = 0;
+	p->misses = 0;
+	p->backoff = 0;
+
+	if (p->interval) {
+		p->next = p->arrival + p->interval + (p->interval / PACE_MARGIN) - (p->cost / 2);
+	} else {
+		p->next = done;
+	}
+}
+
+int ptp_liveview_paced_frame(struct PtpRuntime *r, struct PtpLiveviewPacer *p, void *buffer) {
+	if (p->next > ptp_time_us()) ptp_sleep_until(p->next);
+
+	ptp_lock(r);
+	uint64_t sent = ptp_time_us();
+	int x = ptp_liveview_frame(r, buffer);
+	uint64_t done = ptp_time_us();
+	ptp_unlock(r);
+
+	if (x < 0) return x;
+
+	ptp_liveview_pacer_update(p, x, sent, done);
+	return x;
+}
+
+int ptp_liveview_pacer_json(struct PtpLiveviewPacer *p, char *buffer, int max) {
+	double seconds = p->last > p->start ? (p->last - p->start) / 1000000.0 : 0;
+	return snprintf(buffer, max, "{\"fps\": %.2f, \"camera_fps\": %.2f, \"requests\": %u, \"wasted\": %u, "
+		"\"waste\": %.3f, \"interval\": %.2f, \"cost\": %.2f}",
+		seconds > 0 ? p->frames / seconds : 0, p->interval ? 1000000.0 / p->interval : 0,
+		p->requests, p->not_ready, p->requests ? (double)p->not_ready / p->requests : 0,
+		p->interval / 1000.0, p->cost / 1000.0);
 }
 
 int ptp_liveview_init(struct PtpRuntime *r) {
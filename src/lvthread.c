@@ -0,0 +1,213 @@
+// Liveview on its own thread - frames go into a ring, readers take the newest
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+// Frame refs are the only shared state. The producer claims a frame by
+// swapping refs 0 -> -1, readers by adding to it while it's not -1.
+// The newest frame is never claimed by the producer, so readers can't
+// be starved, and a slow reader only holds back the frame it has.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+#define PTP_LV_DEFAULT_SLOTS 4
+
+// Oldest frame that nobody holds
+static int lv_claim(struct PtpLiveviewThread *lv) {
+	int latest = __atomic_load_n(&lv->latest, __ATOMIC_ACQUIRE);
+	int oldest = -1;
+	for (int i = 0; i < lv->slots; i++) {
+		if (i == latest) continue;
+		if (__atomic_load_n(&lv->ring[i].refs, __ATOMIC_ACQUIRE) != 0) continue;
+		if (oldest == -1 || lv->ring[i].seq < lv->ring[oldest].seq) oldest = i;
+	}
+
+	if (oldest == -1) return -1;
+
+	// A reader may have taken it since
+	int free = 0;
+	if (!__atomic_compare_exchange_n(&lv->ring[oldest].refs, &free, -1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		return -1;
+	}
+
+	return oldest;
+}
+
+static void *lv_thread(void *arg) {
+	struct PtpLiveviewThread *lv = arg;
+	struct PtpRuntime *r = lv->r;
+
+	while (!lv->stop) {
+		int i = lv_claim(lv);
+		if (i == -1) {
+			lv->stalls++;
+			CAMLIB_SLEEP(1);
+			continue;
+		}
+
+		struct PtpLiveviewFrame *f = &lv->ring[i];
+		if (f->seq != 0 && !__atomic_load_n(&f->taken, __ATOMIC_RELAXED)) lv->dropped++;
+
+		// Waits for the next frame to be due, outside of the lock
+		int x = ptp_liveview_paced_frame(r, &lv->pacer, f->data);
+		if (x == 0) {
+			__atomic_store_n(&f->refs, 0, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		if (x < 0) {
+			__atomic_store_n(&f->refs, 0, __ATOMIC_RELEASE);
+			lv->error = x;
+			break;
+		}
+
+		f->length = x;
+		f->time = ptp_time_us();
+		f->seq = ++lv->seq;
+		__atomic_store_n(&f->taken, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&f->refs, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&lv->latest, i, __ATOMIC_RELEASE);
+		lv->produced++;
+	}
+
+	lv->end = ptp_time_us();
+	lv->running = 0;
+	return NULL;
+}
+
+int ptp_liveview_thread_start(struct PtpRuntime *r, struct PtpLiveviewThread *lv) {
+	if (lv->thread != NULL) {
+		if (lv->running) return PTP_RUNTIME_ERR;
+		ptp_liveview_thread_stop(r, lv);
+	}
+
+	int size = ptp_liveview_size(r);
+	if (size == 0) return PTP_UNSUPPORTED;
+
+	if (lv->slots <= 0) lv->slots = PTP_LV_DEFAULT_SLOTS;
+	if (lv->slots < 3 || lv->slots > PTP_LV_RING_MAX) return PTP_RUNTIME_ERR;
+
+	if (r->lock == NULL) {
+		int x = ptp_lock_init(r);
+		if (x) return x;
+	}
+
+	memset(lv->ring, 0, sizeof(lv->ring));
+	for (int i = 0; i < lv->slots; i++) {
+		lv->ring[i].data = malloc(size);
+		if (lv->ring[i].data == NULL) {
+			for (int j = 0; j < i; j++) free(lv->ring[j].data);
+			return PTP_OUT_OF_MEM;
+		}
+	}
+
+	lv->r = r;
+	lv->latest = -1;
+	lv->seq = 0;
+	lv->stop = 0;
+	lv->error = 0;
+	lv->produced = 0;
+	lv->consumed = 0;
+	lv->dropped = 0;
+	lv->stalls = 0;
+	lv->age_total = 0;
+	lv->age_max = 0;
+	lv->start = ptp_time_us();
+	lv->end = 0;
+	ptp_liveview_pacer_reset(&lv->pacer);
+	lv->running = 1;
+
+	int x = ptp_thread_start(&lv->thread, lv_thread, lv, lv->priority);
+	if (x < 0) {
+		lv->running = 0;
+		for (int i = 0; i < lv->slots; i++) free(lv->ring[i].data);
+		return x;
+	}
+
+	lv->realtime = x;
+	return 0;
+}
+
+// Don't hold the lock or any frames while calling this
+int ptp_liveview_thread_stop(struct PtpRuntime *r, struct PtpLiveviewThread *lv) {
+	if (lv->thread == NULL) return 0;
+
+	// Readers check this after taking a ref, so anyone past it is counted below
+	__atomic_store_n(&lv->stop, 1, __ATOMIC_SEQ_CST);
+	ptp_thread_join(lv->thread);
+	lv->thread = NULL;
+	__atomic_store_n(&lv->latest, -1, __ATOMIC_RELEASE);
+
+	// Other threads may still be reading
+	for (int i = 0; i < lv->slots; i++) {
+		while (__atomic_load_n(&lv->ring[i].refs, __ATOMIC_SEQ_CST) > 0) CAMLIB_SLEEP(1);
+		free(lv->ring[i].data);
+		lv->ring[i].data = NULL;
+	}
+
+	return lv->error;
+}
+
+struct PtpLiveviewFrame *ptp_liveview_thread_take(struct PtpLiveviewThread *lv, uint32_t after) {
+	struct PtpLiveviewFrame *f;
+	while (1) {
+		if (__atomic_load_n(&lv->stop, __ATOMIC_ACQUIRE)) return NULL;
+		int i = __atomic_load_n(&lv->latest, __ATOMIC_ACQUIRE);
+		if (i == -1) return NULL;
+
+		f = &lv->ring[i];
+		int refs = __atomic_load_n(&f->refs, __ATOMIC_ACQUIRE);
+
+		// Being rewritten means a newer frame is already out, look again
+		if (refs < 0) continue;
+		if (__atomic_compare_exchange_n(&f->refs, &refs, refs + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)) break;
+	}
+
+	// The ring is about to be freed
+	if (__atomic_load_n(&lv->stop, __ATOMIC_SEQ_CST)) {
+		ptp_liveview_thread_release(lv, f);
+		return NULL;
+	}
+
+	if (f->seq <= after) {
+		ptp_liveview_thread_release(lv, f);
+		return NULL;
+	}
+
+	__atomic_store_n(&f->taken, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&lv->consumed, 1, __ATOMIC_RELAXED);
+
+	uint64_t age = ptp_time_us() - f->time;
+	__atomic_fetch_add(&lv->age_total, age, __ATOMIC_RELAXED);
+	uint64_t max = __atomic_load_n(&lv->age_max, __ATOMIC_RELAXED);
+	while (age > max && !__atomic_compare_exchange_n(&lv->age_max, &max, age, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return f;
+}
+
+void ptp_liveview_thread_release(struct PtpLiveviewThread *lv, struct PtpLiveviewFrame *f) {
+	__atomic_fetch_sub(&f->refs, 1, __ATOMIC_RELEASE);
+}
+
+int ptp_liveview_thread_json(struct PtpLiveviewThread *lv, char *buffer, int max) {
+	uint64_t end = lv->running ? ptp_time_us() : lv->end;
+	double seconds = lv->start && end > lv->start ? (end - lv->start) / 1000000.0 : 0;
+	uint32_t consumed = __atomic_load_n(&lv->consumed, __ATOMIC_RELAXED);
+	int curr = snprintf(buffer, max, "{\"running\": %d, \"realtime\": %d, \"error\": %d, \"slots\": %d, "
+		"\"producer_fps\": %.2f, \"consumer_fps\": %.2f, \"produced\": %u, \"consumed\": %u, "
+		"\"dropped\": %u, \"stalls\": %u, \"age\": {\"avg\": %.2f, \"max\": %.2f}, \"pacing\": ",
+		lv->running, lv->realtime, lv->error, lv->slots,
+		seconds > 0 ? lv->produced / seconds : 0, seconds > 0 ? consumed / seconds : 0,
+		lv->produced, consumed, lv->dropped, lv->stalls,
+		consumed ? (double)lv->age_total / consumed / 1000.0 : 0, lv->age_max / 1000.0);
+	if (curr >= max) return max;
+
+	curr += ptp_liveview_pacer_json(&lv->pacer, buffer + curr, max - curr);
+	if (curr >= max) return max;
+
+	curr += snprintf(buffer + curr, max - curr, "}");
+	return curr;
+}
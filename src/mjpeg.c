@@ -0,0 +1,376 @@
+// MJPEG over HTTP - one liveview stream from a PtpLiveviewThread to many clients
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+// A single thread polls every socket. Each client holds a ref on the
+// frame it's sending, and clients on the same frame share it. A client
+// only starts on the newest frame, anything it was too slow for is
+// dropped. The number of different frames held is capped below the ring
+// size so the producer always has one to write. Past that, clients still
+// on the oldest frame get a copy of it, which only happens to slow ones.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+#define MJPEG_BOUNDARY "camlibframe"
+
+// How often clients waiting on a frame are looked at
+#define PTP_MJPEG_POLL 2
+#define PTP_MJPEG_IDLE_POLL 50
+
+// Clients that don't send a request, or accept no data for this long, are closed
+#define PTP_MJPEG_TIMEOUT 5000000
+
+static const char mjpeg_ok[] = "HTTP/1.0 200 OK\r\n"
+	"Content-Type: multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY "\r\n"
+	"Cache-Control: no-cache\r\n"
+	"Connection: close\r\n\r\n";
+
+static const char mjpeg_busy[] = "HTTP/1.0 503 Service Unavailable\r\n"
+	"Content-Length: 0\r\n"
+	"Connection: close\r\n\r\n";
+
+static void mjpeg_close(struct PtpMjpegServer *srv, struct PtpMjpegClient *c) {
+	if (c->frame != NULL) ptp_liveview_thread_release(srv->lv, c->frame);
+	c->frame = NULL;
+	c->data = NULL;
+	free(c->spill);
+	c->spill = NULL;
+	close(c->fd);
+	c->fd = -1;
+	srv->clients--;
+}
+
+static void mjpeg_accept(struct PtpMjpegServer *srv) {
+	int fd = accept(srv->fd, NULL, NULL);
+	if (fd < 0) return;
+
+	struct PtpMjpegClient *c = NULL;
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+		if (srv->client[i].fd == -1) {
+			c = &srv->client[i];
+			break;
+		}
+	}
+
+	if (c == NULL) {
+		send(fd, mjpeg_busy, sizeof(mjpeg_busy) - 1, MSG_NOSIGNAL);
+		close(fd);
+		srv->rejected++;
+		return;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+	memset(c, 0, sizeof(struct PtpMjpegClient));
+	c->fd = fd;
+	c->progress = ptp_time_us();
+	srv->clients++;
+	srv->connections++;
+}
+
+// Request is read and ignored, any path gets the stream
+static int mjpeg_read(struct PtpMjpegServer *srv, struct PtpMjpegClient *c) {
+	char buffer[512];
+	int x = recv(c->fd, buffer, sizeof(buffer), 0);
+	if (x == 0) return -1;
+	if (x < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+	for (int i = 0; i < x && !c->streaming; i++) {
+		// Looking for \r\n\r\n, \r is skipped
+		if (buffer[i] == '\r') continue;
+		c->newlines = buffer[i] == '\n' ? c->newlines + 1 : 0;
+		if (c->newlines == 2) c->streaming = 1;
+	}
+
+	return 0;
+}
+
+// Number of different frames held, 1 in shared if f is one of them
+static int mjpeg_held(struct PtpMjpegServer *srv, struct PtpLiveviewFrame *f, int *shared, struct PtpLiveviewFrame **oldest) {
+	int distinct = 0;
+	*shared = 0;
+	*oldest = NULL;
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+		struct PtpLiveviewFrame *h = srv->client[i].frame;
+		if (h == NULL) continue;
+		if (h == f) *shared = 1;
+		if (*oldest == NULL || h->seq < (*oldest)->seq) *oldest = h;
+
+		int first = 1;
+		for (int j = 0; j < i; j++) {
+			if (srv->client[j].frame == h) first = 0;
+		}
+		distinct += first;
+	}
+
+	return distinct;
+}
+
+// Slow clients finish a frame from their own copy, so the ring frame can go back
+static int mjpeg_spill(struct PtpMjpegServer *srv, struct PtpLiveviewFrame *f) {
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+		struct PtpMjpegClient *c = &srv->client[i];
+		if (c->frame != f) continue;
+
+		if (c->spill_size < f->length) {
+			uint8_t *spill = realloc(c->spill, f->length);
+			if (spill == NULL) return PTP_OUT_OF_MEM;
+			c->spill = spill;
+			c->spill_size = f->length;
+		}
+
+		memcpy(c->spill, f->data, f->length);
+		c->data = c->spill;
+		c->frame = NULL;
+		ptp_liveview_thread_release(srv->lv, f);
+		srv->copies++;
+	}
+
+	return 0;
+}
+
+// Start on the newest frame, 1 if there is one
+static int mjpeg_next(struct PtpMjpegServer *srv, struct PtpMjpegClient *c) {
+	struct PtpLiveviewFrame *f = ptp_liveview_thread_take(srv->lv, c->seq);
+	if (f == NULL) return 0;
+
+	// The producer needs one frame besides the newest
+	int shared;
+	struct PtpLiveviewFrame *oldest;
+	if (mjpeg_held(srv, f, &shared, &oldest) >= srv->lv->slots - 2 && !shared) {
+		if (mjpeg_spill(srv, oldest)) {
+			ptp_liveview_thread_release(srv->lv, f);
+			return 0;
+		}
+	}
+
+	if (c->seq != 0 && f->seq > c->seq + 1) {
+		c->dropped += f->seq - c->seq - 1;
+		srv->dropped += f->seq - c->seq - 1;
+	}
+
+	c->frame = f;
+	c->data = f->data;
+	c->length = f->length;
+	c->seq = f->seq;
+	c->sent = 0;
+	c->progress = ptp_time_us();
+	c->head_length = 0;
+	if (c->frames == 0) {
+		memcpy(c->head, mjpeg_ok, sizeof(mjpeg_ok) - 1);
+		c->head_length = sizeof(mjpeg_ok) - 1;
+	}
+
+	c->head_length += snprintf(c->head + c->head_length, sizeof(c->head) - c->head_length,
+		"--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\n\r\n", f->length);
+	return 1;
+}
+
+// Header, frame, then the line ending before the next boundary
+static int mjpeg_write(struct PtpMjpegServer *srv, struct PtpMjpegClient *c) {
+	int length = c->length;
+	int total = c->head_length + length + 2;
+	while (c->sent < total) {
+		const void *p;
+		int n;
+		if (c->sent < c->head_length) {
+			p = c->head + c->sent;
+			n = c->head_length - c->sent;
+		} else if (c->sent < c->head_length + length) {
+			p = c->data + (c->sent - c->head_length);
+			n = c->head_length + length - c->sent;
+		} else {
+			p = "\r\n" + (c->sent - c->head_length - length);
+			n = total - c->sent;
+		}
+
+		int x = send(c->fd, p, n, MSG_NOSIGNAL);
+		if (x < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+		c->sent += x;
+		c->progress = ptp_time_us();
+		srv->bytes += x;
+	}
+
+	if (c->frame != NULL) ptp_liveview_thread_release(srv->lv, c->frame);
+	c->frame = NULL;
+	c->data = NULL;
+	c->frames++;
+	srv->frames++;
+	return 0;
+}
+
+static void *mjpeg_thread(void *arg) {
+	struct PtpMjpegServer *srv = arg;
+	struct pollfd fds[PTP_MJPEG_MAX_CLIENTS + 1];
+	int which[PTP_MJPEG_MAX_CLIENTS + 1];
+
+	while (!srv->stop) {
+		// Frames held by clients are freed along with the ring once it stops
+		if (!srv->lv->running) {
+			srv->error = srv->lv->error ? srv->lv->error : PTP_RUNTIME_ERR;
+			break;
+		}
+
+		// Clients between frames get the newest one, if there is one
+		int waiting = 0;
+		for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+			struct PtpMjpegClient *c = &srv->client[i];
+			if (c->fd == -1 || !c->streaming || c->data != NULL) continue;
+			if (!mjpeg_next(srv, c)) waiting = 1;
+		}
+
+		int n = 0;
+		fds[n].fd = srv->fd;
+		fds[n].events = POLLIN;
+		which[n++] = -1;
+		for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+			struct PtpMjpegClient *c = &srv->client[i];
+			if (c->fd == -1) continue;
+			fds[n].fd = c->fd;
+			fds[n].events = POLLIN | (c->data != NULL ? POLLOUT : 0);
+			which[n++] = i;
+		}
+
+		if (poll(fds, n, waiting ? PTP_MJPEG_POLL : PTP_MJPEG_IDLE_POLL) < 0) {
+			if (errno == EINTR) continue;
+			srv->error = PTP_IO_ERR;
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) mjpeg_accept(srv);
+
+		uint64_t now = ptp_time_us();
+		for (int i = 1; i < n; i++) {
+			struct PtpMjpegClient *c = &srv->client[which[i]];
+			if (c->fd == -1) continue;
+
+			int x = 0;
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) x = mjpeg_read(srv, c);
+			if (x == 0 && c->data != NULL && (fds[i].revents & POLLOUT)) x = mjpeg_write(srv, c);
+			if (x == 0 && (c->data != NULL || !c->streaming) && c->progress + PTP_MJPEG_TIMEOUT < now) {
+				srv->timeouts++;
+				x = -1;
+			}
+
+			if (x) mjpeg_close(srv, c);
+		}
+	}
+
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+		if (srv->client[i].fd != -1) mjpeg_close(srv, &srv->client[i]);
+	}
+
+	srv->running = 0;
+	return NULL;
+}
+
+int ptp_mjpeg_server_start(struct PtpRuntime *r, struct PtpMjpegServer *srv, struct PtpLiveviewThread *lv) {
+	if (srv->thread != NULL) {
+		if (srv->running) return PTP_RUNTIME_ERR;
+		ptp_mjpeg_server_stop(srv);
+	}
+
+	// Only JPEG can go in the stream
+	if (ptp_liveview_type(r) != PTP_LV_EOS) return PTP_UNSUPPORTED;
+	if (!lv->running) return PTP_RUNTIME_ERR;
+
+	srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (srv->fd < 0) return PTP_OPEN_FAIL;
+
+	int one = 1;
+	setsockopt(srv->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(srv->port);
+	addr.sin_addr.s_addr = htonl(srv->public ? INADDR_ANY : INADDR_LOOPBACK);
+
+	socklen_t size = sizeof(addr);
+	if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(srv->fd, 8) ||
+			getsockname(srv->fd, (struct sockaddr *)&addr, &size)) {
+		close(srv->fd);
+		return PTP_OPEN_FAIL;
+	}
+	fcntl(srv->fd, F_SETFL, fcntl(srv->fd, F_GETFL) | O_NONBLOCK);
+
+	// Port 0 picks a free one
+	srv->port = ntohs(addr.sin_port);
+
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS; i++) {
+		srv->client[i].fd = -1;
+		srv->client[i].frame = NULL;
+		srv->client[i].spill = NULL;
+	}
+
+	srv->lv = lv;
+	srv->stop = 0;
+	srv->error = 0;
+	srv->clients = 0;
+	srv->connections = 0;
+	srv->rejected = 0;
+	srv->timeouts = 0;
+	srv->frames = 0;
+	srv->dropped = 0;
+	srv->copies = 0;
+	srv->bytes = 0;
+	srv->running = 1;
+
+	int x = ptp_thread_start(&srv->thread, mjpeg_thread, srv, 0);
+	if (x < 0) {
+		srv->running = 0;
+		close(srv->fd);
+		return x;
+	}
+
+	return 0;
+}
+
+int ptp_mjpeg_server_stop(struct PtpMjpegServer *srv) {
+	if (srv->thread == NULL) return 0;
+
+	srv->stop = 1;
+	ptp_thread_join(srv->thread);
+	srv->thread = NULL;
+	close(srv->fd);
+	return srv->error;
+}
+#else
+int ptp_mjpeg_server_start(struct PtpRuntime *r, struct PtpMjpegServer *srv, struct PtpLiveviewThread *lv) {
+	return PTP_UNSUPPORTED;
+}
+
+int ptp_mjpeg_server_stop(struct PtpMjpegServer *srv) {
+	return 0;
+}
+#endif
+
+int ptp_mjpeg_server_json(struct PtpMjpegServer *srv, char *buffer, int max) {
+	return snprintf(buffer, max, "{\"running\": %d, \"error\": %d, \"port\": %d, \"clients\": %d, \"connections\": %u, "
+		"\"rejected\": %u, \"timeouts\": %u, \"frames\": %u, \"dropped\": %u, \"copies\": %u, \"megabytes\": %.2f}",
+		srv->running, srv->error, srv->port, srv->clients, srv->connections,
+		srv->rejected, srv->timeouts, srv->frames, srv->dropped, srv->copies, srv->bytes / 1000000.0);
+}
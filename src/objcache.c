@@ -0,0 +1,302 @@
+// Object info and handle list cache, kept correct from device events
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+int ptp_object_cache_init(struct PtpRuntime *r) {
+	if (r->cache != NULL) return 0;
+	r->cache = calloc(1, sizeof(struct PtpObjectCache));
+	if (r->cache == NULL) return PTP_OUT_OF_MEM;
+	return 0;
+}
+
+static void cache_drop_lists(struct PtpObjectCache *c) {
+	for (int i = 0; i < PTP_OBJ_CACHE_LISTS; i++) {
+		free(c->lists[i].list);
+		c->lists[i].list = NULL;
+	}
+}
+
+void ptp_object_cache_close(struct PtpRuntime *r) {
+	if (r->cache == NULL) return;
+	cache_drop_lists(r->cache);
+	free(r->cache);
+	r->cache = NULL;
+}
+
+void ptp_object_cache_attach(struct PtpRuntime *r, struct PtpCatalog *catalog) {
+	if (r->cache == NULL) return;
+	r->cache->catalog = catalog;
+}
+
+// Direct mapped, a collision evicts the old entry
+static struct PtpObjectCacheEntry *cache_slot(struct PtpObjectCache *c, uint32_t handle) {
+	return &c->entries[((handle * 2654435761u) >> 16) & (PTP_OBJ_CACHE_SIZE - 1)];
+}
+
+int ptp_object_cache_get(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return 0;
+
+	struct PtpObjectCacheEntry *e = cache_slot(c, handle);
+	if (e->valid && e->handle == handle && !e->partial) {
+		memcpy(oi, &e->oi, sizeof(struct PtpObjectInfo));
+		c->hits++;
+		return 1;
+	}
+
+	c->misses++;
+	return 0;
+}
+
+// Partial entries too, for the fields events carry (size, format, filename)
+int ptp_object_cache_peek(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return 0;
+
+	struct PtpObjectCacheEntry *e = cache_slot(c, handle);
+	if (!e->valid || e->handle != handle) return 0;
+	memcpy(oi, &e->oi, sizeof(struct PtpObjectInfo));
+	return 1;
+}
+
+static void cache_put(struct PtpObjectCache *c, uint32_t handle, struct PtpObjectInfo *oi, int partial) {
+	struct PtpObjectCacheEntry *e = cache_slot(c, handle);
+	e->handle = handle;
+	e->valid = 1;
+	e->partial = partial;
+	memcpy(&e->oi, oi, sizeof(struct PtpObjectInfo));
+}
+
+void ptp_object_cache_put(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+	cache_put(c, handle, oi, 0);
+}
+
+struct UintArray *ptp_object_cache_get_handles(struct PtpRuntime *r, int id, int format, int in) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return NULL;
+
+	for (int i = 0; i < PTP_OBJ_CACHE_LISTS; i++) {
+		struct PtpHandleList *l = &c->lists[i];
+		if (l->list != NULL && l->id == id && l->format == format && l->in == in) {
+			c->hits++;
+			return l->list;
+		}
+	}
+
+	c->misses++;
+	return NULL;
+}
+
+// Copy the GetObjectHandles response in r->data
+void ptp_object_cache_put_handles(struct PtpRuntime *r, int id, int format, int in) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+
+	void *d = ptp_get_payload(r);
+	int payload = ptp_get_payload_length(r);
+	if (payload < 4) return;
+	uint32_t length = ptp_read_uint32(&d);
+	if (length > (uint32_t)(payload - 4) / 4) return;
+
+	struct UintArray *list = malloc(sizeof(struct UintArray) + (length * sizeof(uint32_t)));
+	if (list == NULL) return;
+	list->length = length;
+	for (uint32_t i = 0; i < length; i++) {
+		list->data[i] = ptp_read_uint32(&d);
+	}
+
+	struct PtpHandleList *l = &c->lists[c->next_list];
+	c->next_list = (c->next_list + 1) % PTP_OBJ_CACHE_LISTS;
+	free(l->list);
+	l->list = list;
+	l->id = id;
+	l->format = format;
+	l->in = in;
+}
+
+void ptp_object_cache_invalidate(struct PtpRuntime *r) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+
+	for (int i = 0; i < PTP_OBJ_CACHE_SIZE; i++) {
+		c->entries[i].valid = 0;
+	}
+
+	cache_drop_lists(c);
+	c->invalidations++;
+}
+
+void ptp_object_cache_changed(struct PtpRuntime *r, uint32_t handle) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+
+	struct PtpObjectCacheEntry *e = cache_slot(c, handle);
+	if (e->handle == handle) e->valid = 0;
+	c->invalidations++;
+}
+
+// Info is fetched later by ptp_object_cache_sync, commands can't be sent here
+void ptp_object_cache_added(struct PtpRuntime *r, uint32_t handle) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+
+	ptp_object_cache_changed(r, handle);
+	cache_drop_lists(c);
+
+	for (int i = 0; i < c->pending_length; i++) {
+		if (c->pending[i] == handle) return;
+	}
+
+	if (c->pending_length < PTP_OBJ_CACHE_PENDING) {
+		c->pending[c->pending_length] = handle;
+		c->pending_length++;
+	} else {
+		c->pending_overflow = 1;
+	}
+}
+
+// The event only has some of the info (no dates or dimensions). It's kept for
+// ptp_object_cache_peek, the rest is still fetched by ptp_object_cache_sync.
+void ptp_object_cache_added_info(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+
+	ptp_object_cache_added(r, handle);
+	cache_put(c, handle, oi, 1);
+}
+
+void ptp_object_cache_removed(struct PtpRuntime *r, uint32_t handle) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return;
+
+	ptp_object_cache_changed(r, handle);
+	cache_drop_lists(c);
+
+	for (int i = 0; i < c->pending_length; i++) {
+		if (c->pending[i] == handle) {
+			c->pending[i] = c->pending[c->pending_length - 1];
+			c->pending_length--;
+			break;
+		}
+	}
+
+	if (c->catalog != NULL) ptp_catalog_remove(c->catalog, handle);
+}
+
+// Standard interrupt events (see ptp_get_event)
+void ptp_object_cache_event(struct PtpRuntime *r, int code, uint32_t param) {
+	switch (code) {
+	case PTP_EC_ObjectAdded:
+		ptp_object_cache_added(r, param);
+		break;
+	case PTP_EC_ObjectRemoved:
+		ptp_object_cache_removed(r, param);
+		break;
+	case PTP_EC_ObjectInfoChanged:
+		ptp_object_cache_changed(r, param);
+		break;
+	case PTP_EC_StoreAdded:
+	case PTP_EC_StoreRemoved:
+	case PTP_EC_StoreFull:
+	case PTP_EC_DeviceReset:
+		ptp_object_cache_invalidate(r);
+		if (r->cache != NULL && r->cache->catalog != NULL && code != PTP_EC_StoreFull) {
+			r->cache->catalog->stale = 1;
+		}
+		break;
+	}
+}
+
+int ptp_object_cache_apply(struct PtpRuntime *r, struct PtpCanonEvent *ce) {
+	if (r->cache == NULL) return 0;
+
+	switch (ce->type) {
+	case PTP_EC_EOS_ObjectAddedEx: {
+		struct PtpObjectInfo oi;
+		if (ptp_eos_object_info(ce, &oi)) {
+			ptp_object_cache_added(r, ce->code);
+		} else {
+			ptp_object_cache_added_info(r, ce->code, &oi);
+		}
+		} break;
+	case PTP_EC_EOS_ObjectRemoved:
+		ptp_object_cache_removed(r, ce->code);
+		break;
+	case PTP_EC_EOS_ObjectInfoChangedEx:
+	case PTP_EC_EOS_ObjectContentChanged:
+		ptp_object_cache_changed(r, ce->code);
+		break;
+	case PTP_EC_EOS_StoreAdded:
+	case PTP_EC_EOS_StoreRemoved:
+		ptp_object_cache_invalidate(r);
+		if (r->cache->catalog != NULL) r->cache->catalog->stale = 1;
+		break;
+	default:
+		return 0;
+	}
+
+	return 1;
+}
+
+// EOS GetEvent records in r->data
+int ptp_object_cache_update(struct PtpRuntime *r) {
+	if (r->cache == NULL) return 0;
+
+	int n = 0;
+	struct PtpCanonEvent ce;
+	void *e = ptp_open_eos_events(r);
+	while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+		n += ptp_object_cache_apply(r, &ce);
+	}
+
+	return n;
+}
+
+int ptp_object_cache_sync(struct PtpRuntime *r) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return 0;
+
+	int n = 0;
+	while (c->pending_length) {
+		uint32_t handle = c->pending[c->pending_length - 1];
+
+		struct PtpObjectInfo oi;
+		int x = ptp_get_object_info(r, handle, &oi);
+		if (x == PTP_IO_ERR) return x;
+
+		// Gone before it was looked at (deleted, card removed), don't let
+		// it hold up the rest
+		c->pending_length--;
+		if (x) continue;
+
+		if (c->catalog != NULL) {
+			x = ptp_catalog_add(c->catalog, handle, &oi);
+			if (x < 0) return x;
+		}
+		n++;
+	}
+
+	// Too many objects were added to track
+	if (c->pending_overflow && c->catalog != NULL) c->catalog->stale = 1;
+	c->pending_overflow = 0;
+
+	return n;
+}
+
+int ptp_object_cache_json(struct PtpRuntime *r, char *buffer, int max) {
+	struct PtpObjectCache *c = r->cache;
+	if (c == NULL) return snprintf(buffer, max, "null");
+
+	uint32_t total = c->hits + c->misses;
+	double rate = total ? (double)c->hits / total : 0;
+	return snprintf(buffer, max, "{\"hits\": %u, \"misses\": %u, \"hit_rate\": %.3f, \"invalidations\": %u, \"pending\": %d}",
+		c->hits, c->misses, rate, c->invalidations, c->pending_length);
+}
@@ -17,6 +17,8 @@ int ptp_get_event(struct PtpRuntime *r, struct PtpEventContainer *ec) {
 		memcpy(ec, r->data, sizeof(struct PtpEventContainer));
 	}
 
+	if (x >= 12) ptp_object_cache_event(r, ec->code, ec->params[0]);
+
 	return x;
 }
 
@@ -30,6 +32,10 @@ int ptp_custom_recieve(struct PtpRuntime *r, int code) {
 
 int ptp_open_session(struct PtpRuntime *r) {
 	r->session++;
+	ptp_arena_reset(r);
+
+	// Handles are only valid within a session
+	ptp_object_cache_invalidate(r);
 
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_OpenSession;
@@ -52,6 +58,8 @@ int ptp_open_session(struct PtpRuntime *r) {
 }
 
 int ptp_close_session(struct PtpRuntime *r) {
+	ptp_object_cache_invalidate(r);
+
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_CloseSession;
 	cmd.param_length = 0;
@@ -119,12 +127,11 @@ int ptp_get_storage_info(struct PtpRuntime *r, int id, struct PtpStorageInfo *si
 	cmd.params[0] = id;
 
 	int x = ptp_generic_send(r, &cmd);
-	if (x) {
-		return x;
-	} else {
-		memcpy(si, ptp_get_payload(r), sizeof(struct PtpStorageInfo));
-		return 0;
-	}
+	if (x) return x;
+
+	x = ptp_read_storage_info(ptp_get_payload(r), ptp_get_payload_length(r), si);
+	if (x < 0) return x;
+	return 0;
 }
 
 int ptp_get_partial_object(struct PtpRuntime *r, uint32_t handle, int offset, int max) {
@@ -142,17 +149,21 @@ int ptp_get_partial_object(struct PtpRuntime *r, uint32_t handle, int offset, in
 }
 
 int ptp_get_object_info(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi) {
+	if (ptp_object_cache_get(r, handle, oi)) return 0;
+
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_GetObjectInfo;
 	cmd.param_length = 1;
 	cmd.params[0] = handle;
 
 	int x = ptp_generic_send(r, &cmd);
-	if (x) {
-		return x;
-	} else {
-		return ptp_parse_object_info(r, oi);
-	}
+	if (x) return x;
+
+	x = ptp_parse_object_info(r, oi);
+	if (x) return x;
+
+	ptp_object_cache_put(r, handle, oi);
+	return 0;
 }
 
 int ptp_get_object_handles(struct PtpRuntime *r, int id, int format, int in, struct UintArray **a) {
@@ -163,11 +174,112 @@ int ptp_get_object_handles(struct PtpRuntime *r, int id, int format, int in, str
 	cmd.params[1] = format;
 	cmd.params[2] = in;
 
+	*a = ptp_object_cache_get_handles(r, id, format, in);
+	if (*a != NULL) return 0;
+
 	int x = ptp_generic_send(r, &cmd);
 	*a = (void*)ptp_get_payload(r);
+	if (x == 0) ptp_object_cache_put_handles(r, id, format, in);
 	return x;
 }
 
+// Streaming version of ptp_get_object_handles, fn is called for every handle as it arrives
+int ptp_get_object_handles_stream(struct PtpRuntime *r, int id, int format, int in, int (*fn)(struct PtpRuntime *, uint32_t, void *), void *arg) {
+	struct PtpHandleStream s;
+	memset(&s, 0, sizeof(s));
+	s.p.feed = ptp_handle_stream_feed;
+	s.fn = fn;
+	s.arg = arg;
+
+	struct PtpCommand cmd;
+	cmd.code = PTP_OC_GetObjectHandles;
+	cmd.param_length = 3;
+	cmd.params[0] = id;
+	cmd.params[1] = format;
+	cmd.params[2] = in;
+
+	r->stream = &s.p;
+	int x = ptp_generic_send(r, &cmd);
+	r->stream = NULL;
+
+	if (x) return x;
+	if (s.p.error) return s.p.error;
+	return s.p.count;
+}
+
+static int ptp_get_all_object_info_mtp(struct PtpRuntime *r, int id, int (*fn)(struct PtpRuntime *, uint32_t, struct PtpObjectInfo *, void *), void *arg) {
+	struct PtpObjPropListStream s;
+	memset(&s, 0, sizeof(s));
+	s.p.feed = ptp_obj_prop_list_feed;
+	s.fn = fn;
+	s.arg = arg;
+	if (id != -1) s.storage_id = id;
+
+	// Every property of every object, at any depth. MTP only takes one
+	// property code or all of them, so the response can be large.
+	struct PtpCommand cmd;
+	cmd.code = PTP_OC_MTP_GetObjPropList;
+	cmd.param_length = 5;
+	cmd.params[0] = 0xFFFFFFFF;
+	cmd.params[1] = 0;
+	cmd.params[2] = 0xFFFFFFFF;
+	cmd.params[3] = 0;
+	cmd.params[4] = 0xFFFFFFFF;
+
+	r->stream = &s.p;
+	int x = ptp_generic_send(r, &cmd);
+	r->stream = NULL;
+
+	// Too big for r->data is found from the first packet, before any object
+	// goes to fn, so the caller can still fall back to one object at a time
+	if ((x || s.p.error) && s.p.count == 0) return PTP_UNSUPPORTED;
+	if (x) return x;
+	if (s.p.error) return s.p.error;
+	return s.p.count;
+}
+
+static int ptp_get_all_object_info_loop(struct PtpRuntime *r, int id, int (*fn)(struct PtpRuntime *, uint32_t, struct PtpObjectInfo *, void *), void *arg) {
+	struct UintArray *a;
+	int x = ptp_get_object_handles(r, id, 0, 0, &a);
+	if (x) return x;
+
+	// a is either in r->data or in the object cache
+	int length = a->length;
+	if ((uint8_t *)a == ptp_get_payload(r)) {
+		if (length < 0 || length > (ptp_get_payload_length(r) - 4) / 4) return PTP_RUNTIME_ERR;
+	}
+
+	// Handles are overwritten by the next transaction
+	int mark = ptp_arena_mark(r);
+	uint32_t *handles = ptp_arena_alloc(r, length * sizeof(uint32_t));
+	if (handles == NULL && length != 0) return PTP_OUT_OF_MEM;
+	memcpy(handles, a->data, length * sizeof(uint32_t));
+
+	int count = 0;
+	for (int i = 0; i < length; i++) {
+		struct PtpObjectInfo oi;
+		x = ptp_get_object_info(r, handles[i], &oi);
+		if (x) break;
+		count++;
+		x = fn(r, handles[i], &oi, arg);
+		if (x < 0) break;
+		x = 0;
+	}
+
+	ptp_arena_rewind(r, mark);
+	if (x) return x;
+	return count;
+}
+
+int ptp_get_all_object_info(struct PtpRuntime *r, int id, int (*fn)(struct PtpRuntime *, uint32_t, struct PtpObjectInfo *, void *), void *arg) {
+	if (ptp_check_opcode(r, PTP_OC_MTP_GetObjPropList)) {
+		int x = ptp_get_all_object_info_mtp(r, id, fn, arg);
+		if (x != PTP_UNSUPPORTED) return x;
+	}
+
+	return ptp_get_all_object_info_loop(r, id, fn, arg);
+}
+
 int ptp_get_num_objects(struct PtpRuntime *r, int id, int format, int in) {
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_GetNumObjects;
@@ -187,18 +299,51 @@ int ptp_get_prop_value(struct PtpRuntime *r, int code) {
 	return ptp_generic_send(r, &cmd);
 }
 
-int ptp_get_prop_desc(struct PtpRuntime *r, int code, struct PtpDevPropDesc *pd) {
+static int get_prop_desc(struct PtpRuntime *r, int code, struct PtpDevPropDesc *pd) {
 	struct PtpCommand cmd;
 	cmd.code = PTP_OC_GetDevicePropDesc;
 	cmd.param_length = 1;
 	cmd.params[0] = code;
 
+	int mark = ptp_arena_mark(r);
 	int x = ptp_generic_send(r, &cmd);
+	if (x == 0) x = ptp_parse_prop_desc(r, pd);
+	if (x) ptp_arena_rewind(r, mark);
+	return x;
+}
 
-	// Return this?
-	ptp_parse_prop_desc(r, pd);
+int ptp_get_prop_desc(struct PtpRuntime *r, int code, struct PtpDevPropDesc *pd) {
+	// Replaces the last description, unless something was allocated after it
+	if (r->arena.used == r->arena.desc_end) ptp_arena_rewind(r, r->arena.desc_start);
 
-	return x;
+	int start = ptp_arena_mark(r);
+	int x = get_prop_desc(r, code, pd);
+	if (x) return x;
+
+	r->arena.desc_start = start;
+	r->arena.desc_end = ptp_arena_mark(r);
+	return 0;
+}
+
+int ptp_get_all_prop_desc(struct PtpRuntime *r, struct PtpDevPropDesc **list) {
+	if (r->di == NULL) return PTP_RUNTIME_ERR;
+
+	// Every description is fetched again, so the old ones can go
+	ptp_arena_reset(r);
+
+	*list = ptp_arena_alloc(r, sizeof(struct PtpDevPropDesc) * r->di->props_supported_length);
+	if (*list == NULL) return PTP_OUT_OF_MEM;
+
+	int length = 0;
+	for (int i = 0; i < r->di->props_supported_length; i++) {
+		int x = get_prop_desc(r, r->di->props_supported[i], &(*list)[length]);
+		if (x == PTP_IO_ERR || x == PTP_OUT_OF_MEM) return x;
+
+		// Some properties are listed but can't be described, skip them
+		if (x == 0) length++;
+	}
+
+	return length;
 }
 
 // raw JPEG contents is in the payload
@@ -242,14 +387,39 @@ int ptp_delete_object(struct PtpRuntime *r, int handle, int format_code) {
 	cmd.params[0] = handle;
 	cmd.params[1] = format_code;
 
-	return ptp_generic_send(r, &cmd);	
+	int x = ptp_generic_send(r, &cmd);
+	if (x == 0) ptp_object_cache_removed(r, handle);
+	return x;
+}
+
+// GetObject straight into a file, the object doesn't have to fit in r->data
+// Returns the number of bytes written, or a negative error
+int ptp_get_object_file(struct PtpRuntime *r, uint32_t handle, FILE *f) {
+	struct PtpCommand cmd;
+	cmd.code = PTP_OC_GetObject;
+	cmd.param_length = 1;
+	cmd.params[0] = handle;
+
+	int length = ptp_new_cmd_packet(r, &cmd);
+	if (ptp_send_bulk_packets(r, length) != length) return PTP_IO_ERR;
+
+	int x = ptp_frecieve_bulk_packets(r, f, 12);
+	if (x < 0) return x;
+	if (ptp_get_return_code(r) != PTP_RC_OK) return PTP_CHECK_CODE;
+
+	return x - 12;
 }
 
 int ptp_download_file(struct PtpRuntime *r, int handle, char *file) {
 	int max = r->data_length - (r->max_packet_size * 2);
-	printf("%d\n", max);
 
-	FILE *f = fopen(file, "w");
+	// Size is known for cached objects (EOS captures come with it), which
+	// saves the request that would otherwise find the end of the file
+	uint32_t size = 0;
+	struct PtpObjectInfo oi;
+	if (ptp_object_cache_peek(r, handle, &oi)) size = oi.compressed_size;
+
+	FILE *f = fopen(file, "wb");
 	if (f == NULL) {
 		return PTP_RUNTIME_ERR;
 	}
@@ -258,19 +428,20 @@ int ptp_download_file(struct PtpRuntime *r, int handle, char *file) {
 	while (1) {
 		int x = ptp_get_partial_object(r, handle, read, max);
 		if (x) {
+			fclose(f);
 			return x;
 		}
 
-		if (ptp_get_payload_length(r) == 0) {
-			return read;
-		}
+		int length = ptp_get_payload_length(r);
+		if (length <= 0) break;
 
-		fwrite(ptp_get_payload(r), 1, ptp_get_payload_length(r), f);
-		
-		if (ptp_get_payload_length(r) < max) {
-			return read;
-		}
+		fwrite(ptp_get_payload(r), 1, length, f);
+		read += length;
 
-		read += ptp_get_payload_length(r);
+		if (length < max) break;
+		if (size != 0 && (uint32_t)read >= size) break;
 	}
+
+	fclose(f);
+	return read;
 }
@@ -9,16 +9,35 @@ int ptp_custom_recieve(struct PtpRuntime *r, int code);
 int ptp_init_capture(struct PtpRuntime *r, int storage_id, int object_format);
 int ptp_init_open_capture(struct PtpRuntime *r, int storage_id, int object_format);
 int ptp_terminate_open_capture(struct PtpRuntime *r, int trans);
+
+// InitiateCapture, or the EOS remote release sequence
+int ptp_take_picture(struct PtpRuntime *r);
 int ptp_get_storage_info(struct PtpRuntime *r, int id, struct PtpStorageInfo *si);
 int ptp_get_prop_value(struct PtpRuntime *r, int code);
 int ptp_set_prop_value(struct PtpRuntime *r, int code, int value);
+// Valid until the next call, ptp_get_all_prop_desc or session
 int ptp_get_prop_desc(struct PtpRuntime *r, int code, struct PtpDevPropDesc *pd);
+
+// Get the description of every property in r->di, allocated from the arena.
+// Resets the arena first. Returns the number of descriptions in *list, or
+// a negative error.
+int ptp_get_all_prop_desc(struct PtpRuntime *r, struct PtpDevPropDesc **list);
 int ptp_get_object_handles(struct PtpRuntime *r, int id, int format, int in, struct UintArray **a);
+int ptp_get_object_handles_stream(struct PtpRuntime *r, int id, int format, int in, int (*fn)(struct PtpRuntime *, uint32_t, void *), void *arg);
 int ptp_get_object_info(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi);
+
+// Object info for every object on storage id (-1 for all storages). Uses a
+// single MTP GetObjPropList transaction when supported and small enough for
+// r->data, otherwise one GetObjectInfo per handle. With MTP, fn runs while the data phase is still
+// arriving, so it must not send commands, and only the storage, format,
+// protection, size, parent, filename, date and keyword fields are filled.
+// Returns the number of objects, or a negative error.
+int ptp_get_all_object_info(struct PtpRuntime *r, int id, int (*fn)(struct PtpRuntime *, uint32_t, struct PtpObjectInfo *, void *), void *arg);
 int ptp_move_object(struct PtpRuntime *r, int storage_id, int handle, int folder);
 int ptp_delete_object(struct PtpRuntime *r, int handle, int format_code);
 int ptp_get_thumbnail(struct PtpRuntime *r, int handle);
 int ptp_get_partial_object(struct PtpRuntime *r, uint32_t handle, int offset, int max);
+int ptp_get_object_file(struct PtpRuntime *r, uint32_t handle, FILE *f);
 int ptp_download_file(struct PtpRuntime *r, int handle, char *file);
 
 int ptp_eos_get_viewfinder_data(struct PtpRuntime *r);
@@ -29,8 +48,13 @@ int ptp_eos_set_event_mode(struct PtpRuntime *r, int mode);
 int ptp_eos_remote_release_off(struct PtpRuntime *r, int mode);
 int ptp_eos_remote_release_on(struct PtpRuntime *r, int mode);
 int ptp_eos_get_event(struct PtpRuntime *r);
+int ptp_eos_wait_object(struct PtpRuntime *r, int timeout, uint32_t *handle, struct PtpObjectInfo *oi);
+int ptp_eos_get_event_stream(struct PtpRuntime *r, int (*fn)(struct PtpRuntime *, struct PtpCanonEvent *, void *), void *arg);
 int ptp_eos_hdd_capacity_push(struct PtpRuntime *r);
 int ptp_eos_hdd_capacity_pop(struct PtpRuntime *r);
+
+// Tells the camera an object from RequestObjectTransfer can be freed
+int ptp_eos_transfer_complete(struct PtpRuntime *r, uint32_t handle);
 int ptp_eos_get_prop_value(struct PtpRuntime *r, int code);
 int ptp_eos_bulb_start(struct PtpRuntime *r);
 int ptp_eos_bulb_stop(struct PtpRuntime *r);
@@ -51,6 +75,16 @@ int ptp_liveview_deinit(struct PtpRuntime *r);
 // Get a frame directly into buffer, can be JPEG or raw data
 int ptp_liveview_frame(struct PtpRuntime *r, void *buffer);
 
+// ML only, converts the frame straight into buffer, see enum PtpPixelFormat
+int ptp_liveview_ml_convert(struct PtpRuntime *r, uint8_t *buffer, int format);
+
+// EOS only, needs ptp_buffer_pool_init (PTP_RUNTIME_ERR without one). Gets
+// a frame without copying it:
+// *frame points into *buffer, which must be given back with
+// ptp_buffer_release. Returns the frame length, 0 if no frame is ready.
+// The other viewfinder blocks stay in the buffer, see ptp_eos_viewfinder_next.
+int ptp_liveview_frame_take(struct PtpRuntime *r, uint8_t **buffer, uint8_t **frame);
+
 int ptp_liveview_type(struct PtpRuntime *r);
 
 #endif
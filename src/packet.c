@@ -11,28 +11,30 @@ uint8_t ptp_read_uint8(void **dat) {
 	return *((uint8_t*)(dat[0]++));
 }
 
+// Byte loads, packet data is little endian and not always aligned
 uint16_t ptp_read_uint16(void **dat) {
-	uint16_t x = *((uint16_t*)(dat[0]));
+	uint8_t *d = dat[0];
 	dat[0] += 2;
-	return x;
+	return (uint16_t)(d[0] | (d[1] << 8));
 }
 
 uint32_t ptp_read_uint32(void **dat) {
-	uint32_t x = *((uint32_t*)(dat[0]));
+	uint8_t *d = dat[0];
 	dat[0] += 4;
-	return x;
+	return (uint32_t)d[0] | ((uint32_t)d[1] << 8) | ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24);
 }
 
-// Read UTF16 string
+// Read UTF16 string, characters past max are skipped
 void ptp_read_string(void **dat, char *string, int max) {
 	int length = (int)ptp_read_uint8(dat);
 
 	int y = 0;
-	while (y < length) {
-		string[y] = *((char*)dat[0]);
-		dat[0] += 2;
-		y++;
-		if (y >= max) {break;}
+	for (int i = 0; i < length; i++) {
+		uint16_t c = ptp_read_uint16(dat);
+		if (y < max - 1 && c != 0) {
+			string[y] = (char)c;
+			y++;
+		}
 	}
 
 	string[y] = '\0';
@@ -46,30 +48,37 @@ int ptp_read_uint16_array(void **dat, uint16_t *buf, int max) {
 		return -1;
 	}
 
+	// Elements past max are skipped
 	for (int i = 0; i < n; i++) {
-		// Give a zero if out of bounds
-		if (i >= max) {
-			buf[i] = 0;
-		} else {
-			buf[i] = ptp_read_uint16(dat);
-		}
+		uint16_t x = ptp_read_uint16(dat);
+		if (i < max) buf[i] = x;
 	}
 
-	return n;
+	return (n > max) ? max : n;
 }
 
 void ptp_write_uint8(void **dat, uint8_t b) {
 	*((uint8_t*)(dat[0]++)) = b;
 }
 
+// Write UTF16 string, count includes the null terminator
 void ptp_write_string(void **dat, char *string) {
 	int length = strlen(string);
-	ptp_write_uint8(dat, length);
+	if (length > 254) length = 254;
+	if (length == 0) {
+		ptp_write_uint8(dat, 0);
+		return;
+	}
+
+	ptp_write_uint8(dat, length + 1);
 
 	for (int i = 0; i < length; i++) {
 		ptp_write_uint8(dat, string[i]);
-		dat[0] += 2;
+		ptp_write_uint8(dat, 0);
 	}
+
+	ptp_write_uint8(dat, 0);
+	ptp_write_uint8(dat, 0);
 }
 
 // Generate a BulkContainer packet
@@ -175,6 +184,37 @@ uint32_t ptp_get_param(struct PtpRuntime *r, int index) {
 	return 0;
 }
 
+void ptp_stream_feed(struct PtpRuntime *r, int read) {
+	struct PtpStreamParser *p = r->stream;
+	if (p == NULL || p->error || read < 12) return;
+
+	struct PtpBulkContainer *bulk = (struct PtpBulkContainer*)(r->data);
+	if (bulk->type != PTP_PACKET_TYPE_DATA) return;
+
+	// The transfer will fail part way, so give the parser nothing
+	if (bulk->length >= (uint32_t)(r->data_length - r->max_packet_size)) {
+		p->error = PTP_OUT_OF_MEM;
+		return;
+	}
+
+	// Don't let the parser see the response packet that follows
+	if (read > (int)bulk->length) read = bulk->length;
+
+	int x = p->feed(r, p, read - 12, 0);
+	if (x < 0) p->error = x;
+}
+
+void ptp_stream_finish(struct PtpRuntime *r) {
+	struct PtpStreamParser *p = r->stream;
+	if (p == NULL || p->error) return;
+
+	struct PtpBulkContainer *bulk = (struct PtpBulkContainer*)(r->data);
+	if (bulk->type != PTP_PACKET_TYPE_DATA) return;
+
+	int x = p->feed(r, p, ptp_get_payload_length(r), 1);
+	if (x < 0) p->error = x;
+}
+
 int ptp_get_last_transaction(struct PtpRuntime *r) {
 	struct PtpBulkContainer *bulk = (struct PtpBulkContainer*)(r->data);
 	if (bulk->type == PTP_PACKET_TYPE_DATA) {
@@ -0,0 +1,134 @@
+// Host side property table, kept up to date from EOS GetEvent deltas
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// Open addressing, PTP_PROP_STORE_SIZE must be a power of two
+static int prop_store_slot(uint32_t code) {
+	return ((code * 2654435761u) >> 16) & (PTP_PROP_STORE_SIZE - 1);
+}
+
+static struct PtpPropEntry *prop_store_find(struct PtpPropStore *ps, uint32_t code, int create) {
+	int slot = prop_store_slot(code);
+	for (int i = 0; i < PTP_PROP_STORE_SIZE; i++) {
+		struct PtpPropEntry *e = &ps->entries[slot];
+		if (e->code == code) return e;
+		if (e->code == 0) {
+			if (!create) return NULL;
+			e->code = code;
+			ps->length++;
+			return e;
+		}
+
+		slot = (slot + 1) & (PTP_PROP_STORE_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+static int prop_store_set_value(struct PtpPropStore *ps, struct PtpCanonEvent *ce) {
+	struct PtpPropEntry *e = prop_store_find(ps, ce->code, 1);
+	if (e == NULL) return 0;
+
+	int length = ce->data_length;
+	if (length > PTP_PROP_VALUE_MAX) length = PTP_PROP_VALUE_MAX;
+
+	if (e->version != 0 && length == e->data_length && !memcmp(e->data, ce->data, length)) {
+		return 0;
+	}
+
+	memcpy(e->data, ce->data, length);
+	e->data_length = length;
+	e->value = ce->value;
+	e->version = ++ps->version;
+	return 1;
+}
+
+static int prop_store_set_avail(struct PtpPropStore *ps, struct PtpCanonEvent *ce) {
+	struct PtpPropEntry *e = prop_store_find(ps, ce->code, 1);
+	if (e == NULL) return 0;
+
+	// Count comes from the camera, clamp it before it's used as a size
+	uint32_t count = ce->value;
+	if (ce->data_length < 0) return 0;
+	if (count > (uint32_t)ce->data_length / 4) count = (uint32_t)ce->data_length / 4;
+	if (count > PTP_PROP_AVAIL_MAX) count = PTP_PROP_AVAIL_MAX;
+	int length = (int)count;
+
+	uint32_t avail[PTP_PROP_AVAIL_MAX];
+	void *d = ce->data;
+	for (int i = 0; i < length; i++) {
+		avail[i] = ptp_read_uint32(&d);
+	}
+
+	if (e->avail_version != 0 && length == e->avail_length && !memcmp(e->avail, avail, length * 4)) {
+		return 0;
+	}
+
+	memcpy(e->avail, avail, length * 4);
+	e->avail_length = length;
+	e->avail_version = ++ps->version;
+	return 1;
+}
+
+int ptp_prop_store_apply(struct PtpRuntime *r, struct PtpCanonEvent *ce) {
+	if (r->props == NULL) return 0;
+
+	switch (ce->type) {
+	case PTP_EC_EOS_PropValueChanged:
+		return prop_store_set_value(r->props, ce);
+	case PTP_EC_EOS_AvailListChanged:
+		return prop_store_set_avail(r->props, ce);
+	}
+
+	return 0;
+}
+
+int ptp_prop_store_update(struct PtpRuntime *r) {
+	int changed = 0;
+	struct PtpCanonEvent ce;
+	void *e = ptp_open_eos_events(r);
+	while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+		changed += ptp_prop_store_apply(r, &ce);
+	}
+
+	return changed;
+}
+
+struct PtpPropEntry *ptp_prop_store_get(struct PtpRuntime *r, int code) {
+	if (r->props == NULL) return NULL;
+	return prop_store_find(r->props, code, 0);
+}
+
+int ptp_prop_store_changed(struct PtpRuntime *r, uint32_t since, struct PtpPropEntry **list, int max) {
+	if (r->props == NULL) return 0;
+
+	int n = 0;
+	for (int i = 0; i < PTP_PROP_STORE_SIZE && n < max; i++) {
+		struct PtpPropEntry *e = &r->props->entries[i];
+		if (e->code == 0) continue;
+		if (e->version > since || e->avail_version > since) {
+			list[n] = e;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+uint32_t ptp_prop_store_version(struct PtpRuntime *r) {
+	if (r->props == NULL) return 0;
+	return r->props->version;
+}
+
+// Version is kept, so clients holding an old version see everything as changed
+void ptp_prop_store_reset(struct PtpRuntime *r) {
+	if (r->props == NULL) return;
+	uint32_t version = r->props->version;
+	memset(r->props, 0, sizeof(struct PtpPropStore));
+	r->props->version = version;
+}
@@ -100,6 +100,7 @@ struct PtpEventContainer {
 #define PTP_OC_EOS_SetRemoteMode		0x9114
 #define PTP_OC_EOS_SetEventMode			0x9115
 #define PTP_OC_EOS_GetEvent				0x9116
+#define PTP_OC_EOS_TransferComplete		0x9117
 #define PTP_OC_EOS_PCHDDCapacity		0x911A
 #define PTP_OC_EOS_SetUILock			0x911B
 #define PTP_OC_EOS_ResetUILock			0x911C
@@ -286,6 +287,18 @@ struct PtpEventContainer {
 #define PTP_PC_FocusMode		0x500A
 #define PTP_PC_DateTime			0x5011
 
+// MTP Object Property Codes
+#define PTP_OPC_StorageID		0xDC01
+#define PTP_OPC_ObjectFormat	0xDC02
+#define PTP_OPC_ProtectionStatus	0xDC03
+#define PTP_OPC_ObjectSize		0xDC04
+#define PTP_OPC_ObjectFileName	0xDC07
+#define PTP_OPC_DateCreated		0xDC08
+#define PTP_OPC_DateModified	0xDC09
+#define PTP_OPC_Keywords		0xDC0A
+#define PTP_OPC_ParentObject	0xDC0B
+#define PTP_OPC_Name			0xDC44
+
 // Canon (Not EOS) Property Codes
 #define PTP_PC_CANON_BeepCode		0xD001
 #define PTP_PC_CANON_ViewFinderMode	0xD003
@@ -26,6 +26,7 @@ int ptp_device_close(struct PtpRuntime *r);
 int ptp_fsend_packets(struct PtpRuntime *r, int length, FILE *stream);
 
 // Reads the incoming packet to file, starting after an optional offset
+// Returns the number of bytes received, the response is left in r->data
 int ptp_frecieve_bulk_packets(struct PtpRuntime *r, FILE *stream, int of);
 
 #endif
@@ -3,18 +3,10 @@
 #ifndef DATA_H
 #define DATA_H
 
-// Try and check for compatibility with 32 bit stuff
-// uint64_t is only used once
+// These are host structures, they are never overlaid on packet data.
+// Conversion to and from the wire format is done by the functions
+// generated from datasets.py (see dataset_dump.c).
 #include <stdint.h>
-#if UINTPTR_MAX == 0xffffffff
-#define BITS_32
-#elif UINTPTR_MAX == 0xffffffffffffffff
-#define BITS_64
-#endif
-
-// Need to avoid structure packing - most architectures are fine with this
-// (accessing a 32 bit integer at an unaligned address - but some might have problems)
-#pragma pack(push, 1)
 
 // 4 Seems like a good limit?
 struct PtpStorageIds {
@@ -60,17 +52,11 @@ struct PtpStorageInfo {
 	uint16_t storage_type;
 	uint16_t fs_type;
 	uint16_t access_capability;
-#ifdef BITS_32
-	uint32_t max_capacity;
-	uint32_t max_capacity_64;
-	uint32_t free_space;
-	uint32_t free_space_64;
-#endif
-#ifdef BITS_64
 	uint64_t max_capacity;
 	uint64_t free_space;
-#endif
 	uint32_t free_objects;
+	char storage_description[128];
+	char volume_identifier[128];
 };
 
 struct ObjectRequest {
@@ -99,23 +85,50 @@ struct PtpObjectInfo {
 	uint32_t assoc_desc;
 	uint32_t sequence_num;
 
-	#define PTP_OBJ_INFO_VAR_START 52
-
 	char filename[64];
 	char date_created[32];
 	char date_modified[32];
 	char keywords[64];
 };
 
+// Any PTP data type. Integers up to 64 bits are in value (signed types
+// are sign extended). Arrays, strings and 128 bit integers are copied into
+// the runtime arena, and are valid until ptp_arena_reset.
+struct PtpPropValue {
+	uint64_t value;
+
+	// Array elements in host order (uint8_t/uint16_t/uint32_t/uint64_t), or
+	// a null terminated UTF-8 string, or 16 little endian bytes for 128 bit types
+	void *data;
+
+	// Number of array elements, or string length in bytes
+	int length;
+};
+
+enum PtpFormType {
+	PTP_FORM_NONE = 0,
+	PTP_FORM_RANGE = 1,
+	PTP_FORM_ENUM = 2,
+};
+
 struct PtpDevPropDesc {
 	uint16_t code;
 	uint16_t data_type;
 	uint8_t read_only; // (get/set)
 
-	#define PTP_PROP_DESC_VAR_START 5
+	struct PtpPropValue default_value;
+	struct PtpPropValue current_value;
+
+	// See enum PtpFormType
+	uint8_t form_type;
+
+	struct PtpPropValue range_min;
+	struct PtpPropValue range_max;
+	struct PtpPropValue range_step;
 
-	int default_value;
-	int current_value;
+	// Allocated from the arena
+	int enum_length;
+	struct PtpPropValue *enum_values;
 };
 
 struct PtpObjPropDesc {
@@ -128,11 +141,27 @@ struct PtpObjPropDesc {
 	// mystery data type follows if form_flag == 0
 };
 
+// A single record from an EOS GetEvent payload, see ptp_get_eos_event.
+// data points into r->data, and is only valid until the next transaction.
 struct PtpCanonEvent {
+	// PTP_EC_EOS_*
 	int type;
-	int code;
-	int value;
-	int def;
+
+	// Property code (PropValueChanged, AvailListChanged) or
+	// object handle (ObjectAddedEx, ObjectRemoved, RequestObjectTransfer)
+	uint32_t code;
+
+	// PropValueChanged: first 32 bits of the new value
+	// AvailListChanged: number of values in the list
+	uint32_t value;
+
+	// AvailListChanged: form of the list (3 for an enumeration)
+	uint32_t data_type;
+
+	// Whatever follows the fields above: the full property value,
+	// the list of available values, or the rest of an object record
+	uint8_t *data;
+	int data_length;
 };
 
 struct PtpEOSViewFinderData {
@@ -141,27 +170,767 @@ struct PtpEOSViewFinderData {
 	// standard JPG follows
 };
 
-struct PtpEOSObject {
-	uint32_t a;
-	uint32_t b;
-	uint32_t c;
-	uint32_t d;
-	uint32_t e;
-};
-
 int ptp_parse_device_info(struct PtpRuntime *r, struct PtpDeviceInfo *di);
 int ptp_device_info_json(struct PtpDeviceInfo *di, char *buffer, int max);
 int ptp_parse_prop_desc(struct PtpRuntime *r, struct PtpDevPropDesc *oi);
+int ptp_parse_prop_value(struct PtpRuntime *r, uint8_t **d, uint8_t *end, int type, struct PtpPropValue *v);
+
+// Size of an encoded value, 0 if length is too short to hold all of it
+int ptp_prop_value_size(uint8_t *d, int length, int type);
 int ptp_parse_object_info(struct PtpRuntime *r, struct PtpObjectInfo *oi);
 int ptp_pack_object_info(struct PtpRuntime *r, struct PtpObjectInfo *oi);
 int ptp_storage_info_json(struct PtpStorageInfo *so, char *buffer, int max);
 int ptp_object_info_json(struct PtpObjectInfo *so, char *buffer, int max);
 
+// Iterate over the records in an EOS GetEvent response, without copying:
+// void *e = ptp_open_eos_events(r);
+// while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) { ... }
+// Records are bounds checked against the data length, NULL is returned
+// at the end of the list or on a malformed record.
 void *ptp_open_eos_events(struct PtpRuntime *r);
 void *ptp_get_eos_event(struct PtpRuntime *r, void *e, struct PtpCanonEvent *ce);
 
+// GetViewFinderData block types. Older bodies only send the JPEG, newer
+// ones add zoom, histogram and AF frame blocks whose numbering differs
+// between models, so those are left to the caller by number.
+#define PTP_EOS_VF_JPEG 1
+#define PTP_EOS_VF_JPEG_NEW 9
+#define PTP_EOS_VF_JPEG_NEW2 11
+
+// A single block from an EOS GetViewFinderData payload. data points into
+// the response buffer, and is only valid until the next transaction.
+struct PtpEOSViewFinderBlock {
+	int type;
+	uint8_t *data;
+	int length;
+};
+
+// Iterate over the blocks in r->data, the same way as ptp_get_eos_event
+void *ptp_open_eos_viewfinder(struct PtpRuntime *r);
+void *ptp_get_eos_viewfinder_block(struct PtpRuntime *r, void *b, struct PtpEOSViewFinderBlock *block);
+
+// Same over any buffer (such as one from ptp_buffer_take), returns the
+// next block or NULL
+uint8_t *ptp_eos_viewfinder_next(uint8_t *p, uint8_t *end, struct PtpEOSViewFinderBlock *block);
+
+// Find the liveview JPEG, returns 0 if there is one
+int ptp_eos_viewfinder_jpeg(uint8_t *payload, int length, struct PtpEOSViewFinderBlock *block);
+
+// Stream parsers (see struct PtpStreamParser). Callbacks run while the data
+// phase is still being received, and must not send commands. Returning a
+// negative value from a callback stops parsing.
+struct PtpEOSEventStream {
+	struct PtpStreamParser p;
+	int (*fn)(struct PtpRuntime *r, struct PtpCanonEvent *ce, void *arg);
+	void *arg;
+
+	// Terminator seen, anything after it is ignored
+	int finished;
+};
+
+struct PtpHandleStream {
+	struct PtpStreamParser p;
+	int (*fn)(struct PtpRuntime *r, uint32_t handle, void *arg);
+	void *arg;
+
+	// Number of handles, from the start of the data
+	uint32_t length;
+};
+
+// MTP GetObjPropList, elements for the same handle are collected into oi.
+// Only the properties found in PtpObjectInfo are kept.
+struct PtpObjPropListStream {
+	struct PtpStreamParser p;
+	int (*fn)(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi, void *arg);
+	void *arg;
+
+	// Objects on other storages are skipped, 0 for all
+	uint32_t storage_id;
+
+	// Number of elements, and number parsed so far
+	uint32_t length;
+	uint32_t elements;
+
+	uint32_t handle;
+	int have_object;
+	struct PtpObjectInfo oi;
+};
+
+int ptp_eos_event_stream_feed(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done);
+int ptp_handle_stream_feed(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done);
+int ptp_obj_prop_list_feed(struct PtpRuntime *r, struct PtpStreamParser *p, int avail, int done);
+
 int ptp_eos_events_json(struct PtpRuntime *r, char *buffer, int max);
 
+// Decode an ObjectAddedEx record: storage, format, size, parent and filename.
+// Saves a GetObjectInfo round trip for objects created by a capture.
+// RequestObjectTransfer records only have the format, size and filename.
+int ptp_eos_object_info(struct PtpCanonEvent *ce, struct PtpObjectInfo *oi);
+int ptp_eos_prop_json(struct PtpCanonEvent *ce, char *buffer, int max);
+
+// Host side copy of the camera properties, built from GetEvent deltas
+#define PTP_PROP_STORE_SIZE 256
+#define PTP_PROP_VALUE_MAX 64
+#define PTP_PROP_AVAIL_MAX 128
+
+struct PtpPropEntry {
+	// Zero if the slot is unused
+	uint32_t code;
+
+	// First 32 bits of the value, and the raw value
+	uint32_t value;
+	uint8_t data[PTP_PROP_VALUE_MAX];
+	int data_length;
+
+	// Available values, EOS sends each one as 32 bits
+	uint32_t avail[PTP_PROP_AVAIL_MAX];
+	int avail_length;
+
+	// Store version at the time of the last change
+	uint32_t version;
+	uint32_t avail_version;
+};
+
+struct PtpPropStore {
+	// Bumped once for every property value or list that changes
+	uint32_t version;
+	int length;
+	struct PtpPropEntry entries[PTP_PROP_STORE_SIZE];
+};
+
+// Apply PropValueChanged/AvailListChanged records from the EOS GetEvent
+// response in r->data. Returns the number of properties that changed.
+// ptp_eos_get_event calls this automatically.
+int ptp_prop_store_update(struct PtpRuntime *r);
+
+// Apply a single record, returns 1 if it changed anything
+int ptp_prop_store_apply(struct PtpRuntime *r, struct PtpCanonEvent *ce);
+
+// Returns NULL if the property hasn't been seen yet
+struct PtpPropEntry *ptp_prop_store_get(struct PtpRuntime *r, int code);
+
+// Fill list with up to max properties that changed after version since.
+// Passing 0 returns every property. Returns the number of entries.
+int ptp_prop_store_changed(struct PtpRuntime *r, uint32_t since, struct PtpPropEntry **list, int max);
+
+uint32_t ptp_prop_store_version(struct PtpRuntime *r);
+void ptp_prop_store_reset(struct PtpRuntime *r);
+
+// Available values of a property, as ["name", [values...]], converted the
+// same way as ptp_eos_prop_json
+int ptp_eos_avail_json(struct PtpPropEntry *e, char *buffer, int max);
+
+// Object catalog, one row per object, each field in its own array.
+// Rows are indexes into the columns. Indexes are rebuilt on the first
+// query after a change. Filenames are stored once in names.
+struct PtpCatalog {
+	uint32_t storage_id;
+	int length;
+	int capacity;
+
+	uint32_t *handle;
+	uint32_t *parent;
+	uint16_t *format;
+	uint32_t *size;
+	uint32_t *date; // seconds since 1970, see ptp_parse_date
+	uint32_t *name; // offset into names
+
+	char *names;
+	int names_used;
+	int names_size;
+	int name_count;
+	uint32_t *name_table;
+	int name_table_size;
+
+	// handle to row, -1 if empty
+	int *handle_table;
+	int handle_table_size;
+
+	// Set when events showed that only a rescan can make this correct
+	// (a storage was added or removed, or too many objects were added)
+	int stale;
+
+	// Rows sorted by parent, date (newest first) and format
+	int dirty;
+	uint32_t *by_parent;
+	uint32_t *by_date;
+	uint32_t *by_format;
+};
+
+void ptp_catalog_init(struct PtpCatalog *c);
+void ptp_catalog_free(struct PtpCatalog *c);
+void ptp_catalog_clear(struct PtpCatalog *c);
+
+// Replace the contents with every object on storage_id (-1 for all).
+// Returns the number of objects, or a negative error.
+int ptp_catalog_scan(struct PtpRuntime *r, struct PtpCatalog *c, int storage_id);
+
+// Add or update an object, returns its row
+int ptp_catalog_add(struct PtpCatalog *c, uint32_t handle, struct PtpObjectInfo *oi);
+int ptp_catalog_remove(struct PtpCatalog *c, uint32_t handle);
+
+// Returns the row of handle, or -1
+int ptp_catalog_find(struct PtpCatalog *c, uint32_t handle);
+
+// Queries return a number of rows, *rows points into the catalog and is
+// valid until the next change
+int ptp_catalog_children(struct PtpCatalog *c, uint32_t parent, uint32_t **rows);
+int ptp_catalog_with_format(struct PtpCatalog *c, int format, uint32_t **rows);
+int ptp_catalog_newest(struct PtpCatalog *c, int n, uint32_t **rows);
+int ptp_catalog_build_index(struct PtpCatalog *c);
+
+char *ptp_catalog_name(struct PtpCatalog *c, int row);
+int ptp_catalog_json(struct PtpCatalog *c, uint32_t *rows, int length, char *buffer, int max);
+uint32_t ptp_parse_date(char *s);
+
+// Cache for ptp_get_object_info and ptp_get_object_handles, enabled with
+// ptp_object_cache_init. Entries are dropped when events say an object was
+// added, removed or changed. Events are applied from ptp_get_event and
+// ptp_eos_get_event.
+#define PTP_OBJ_CACHE_SIZE 1024
+#define PTP_OBJ_CACHE_LISTS 8
+#define PTP_OBJ_CACHE_PENDING 64
+
+struct PtpObjectCacheEntry {
+	uint32_t handle;
+	int valid;
+	int partial; // From an event, ptp_object_cache_get doesn't return it
+	struct PtpObjectInfo oi;
+};
+
+struct PtpHandleList {
+	int id;
+	int format;
+	int in;
+	struct UintArray *list;
+};
+
+struct PtpObjectCache {
+	struct PtpObjectCacheEntry entries[PTP_OBJ_CACHE_SIZE];
+
+	struct PtpHandleList lists[PTP_OBJ_CACHE_LISTS];
+	int next_list;
+
+	// Objects added since the last ptp_object_cache_sync
+	uint32_t pending[PTP_OBJ_CACHE_PENDING];
+	int pending_length;
+	int pending_overflow;
+
+	// Optional, kept up to date with added and removed objects
+	struct PtpCatalog *catalog;
+
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t invalidations;
+};
+
+int ptp_object_cache_init(struct PtpRuntime *r);
+void ptp_object_cache_close(struct PtpRuntime *r);
+void ptp_object_cache_attach(struct PtpRuntime *r, struct PtpCatalog *catalog);
+
+// Returns 1 and fills oi on a hit
+int ptp_object_cache_get(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi);
+void ptp_object_cache_put(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi);
+// Also returns the partial info from EOS ObjectAddedEx events
+int ptp_object_cache_peek(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi);
+struct UintArray *ptp_object_cache_get_handles(struct PtpRuntime *r, int id, int format, int in);
+void ptp_object_cache_put_handles(struct PtpRuntime *r, int id, int format, int in);
+
+void ptp_object_cache_added(struct PtpRuntime *r, uint32_t handle);
+void ptp_object_cache_added_info(struct PtpRuntime *r, uint32_t handle, struct PtpObjectInfo *oi);
+void ptp_object_cache_removed(struct PtpRuntime *r, uint32_t handle);
+void ptp_object_cache_changed(struct PtpRuntime *r, uint32_t handle);
+void ptp_object_cache_invalidate(struct PtpRuntime *r);
+void ptp_object_cache_event(struct PtpRuntime *r, int code, uint32_t param);
+// Apply a single EOS record, returns 1 if it was an object record
+int ptp_object_cache_apply(struct PtpRuntime *r, struct PtpCanonEvent *ce);
+int ptp_object_cache_update(struct PtpRuntime *r);
+
+// Get info for objects added since the last call and add them to the
+// attached catalog. Returns the number of objects, or a negative error.
+int ptp_object_cache_sync(struct PtpRuntime *r);
+int ptp_object_cache_json(struct PtpRuntime *r, char *buffer, int max);
+
+// Tethered capture on EOS, see ptp_tether_start. Captures are kept in
+// camera RAM and announced with RequestObjectTransfer, then downloaded
+// to dir and freed, so bursts aren't limited by the card write speed.
+#define PTP_TETHER_QUEUE 64
+
+// Failed attempts to create a file before the capture is given up
+#define PTP_TETHER_OPEN_RETRIES 3
+
+struct PtpTetherItem {
+	uint32_t handle;
+	uint32_t size;
+	char filename[64];
+
+	// When the shot was taken (see ptp_tether_shot) or the request was seen
+	uint64_t start;
+};
+
+struct PtpTether {
+	char dir[256];
+	int active;
+
+	// Transfers waiting to be downloaded, oldest first
+	struct PtpTetherItem queue[PTP_TETHER_QUEUE];
+	int queue_length;
+
+	// Didn't fit in the queue, only sent TransferComplete. Grows so
+	// nothing is left without one, freed by ptp_tether_stop.
+	uint32_t *release;
+	int release_length;
+	int release_max;
+
+	// fopen failures in a row for queue[0]
+	int open_failures;
+
+	// Set by ptp_tether_shot, 0 if unknown
+	uint64_t shot;
+
+	// Optional, called after each file is closed
+	int (*fn)(struct PtpRuntime *r, char *path, struct PtpTetherItem *item, void *arg);
+	void *arg;
+
+	int count;
+	int errors;
+	uint64_t bytes;
+
+	// Time spent in transfers, for ptp_tether_estimate
+	uint64_t busy;
+
+	// Shot to disk latency in microseconds
+	uint64_t last;
+	uint64_t min;
+	uint64_t max;
+	uint64_t total;
+};
+
+// Switch the capture destination to the host, files are saved in dir
+int ptp_tether_start(struct PtpRuntime *r, struct PtpTether *t, char *dir);
+int ptp_tether_stop(struct PtpRuntime *r, struct PtpTether *t);
+
+// Mark the time the shutter was released, for latency stats
+void ptp_tether_shot(struct PtpTether *t);
+
+// Queue transfer requests from EOS GetEvent records in r->data. Called by
+// ptp_eos_get_event and ptp_eos_get_event_stream between ptp_tether_start
+// and ptp_tether_stop.
+int ptp_tether_queue_events(struct PtpRuntime *r, struct PtpTether *t);
+// Single record, returns 1 if it was queued
+int ptp_tether_queue_event(struct PtpRuntime *r, struct PtpTether *t, struct PtpCanonEvent *ce);
+
+// Download and free every queued object. Returns the number of files saved.
+int ptp_tether_download(struct PtpRuntime *r, struct PtpTether *t);
+
+// Download only the oldest object, returns 1 if a file was saved
+int ptp_tether_download_next(struct PtpRuntime *r, struct PtpTether *t);
+
+// Expected time in microseconds for ptp_tether_download_next, from past transfers
+uint64_t ptp_tether_estimate(struct PtpTether *t);
+
+// GetEvent, then download. Returns the number of files saved.
+int ptp_tether_poll(struct PtpRuntime *r, struct PtpTether *t);
+int ptp_tether_json(struct PtpTether *t, char *buffer, int max);
+
+// Burst capture, see ptp_burst. Times are ptp_time_us, 0 if not reached.
+#define PTP_BURST_MAX 256
+#define PTP_BURST_FILES 32
+
+struct PtpBurstShot {
+	uint64_t fired;
+	uint64_t landed; // First object reported by the camera
+	uint64_t saved; // Last file written to the host
+	int objects;
+};
+
+struct PtpBurstFile {
+	uint32_t handle;
+	int shot;
+	uint32_t size;
+	uint32_t offset;
+	char filename[64];
+	FILE *stream;
+};
+
+struct PtpBurst {
+	// Empty to leave files on the card
+	char dir[256];
+
+	int shots;
+	int interval;
+	int fired;
+	struct PtpBurstShot shot[PTP_BURST_MAX];
+
+	// Objects waiting to be downloaded, oldest first
+	struct PtpBurstFile queue[PTP_BURST_FILES];
+	int queue_length;
+	uint64_t last_object;
+
+	int files;
+	int errors;
+	uint64_t bytes;
+};
+
+// Take shots pictures, interval ms apart. Each new object is matched to a
+// shot, and downloaded to dir in slices between triggers while the next
+// exposures are being taken. Returns the number of files saved.
+int ptp_burst(struct PtpRuntime *r, struct PtpBurst *b, int shots, int interval, char *dir);
+
+// Per shot [start, landed, saved, objects], in ms from the trigger
+int ptp_burst_json(struct PtpBurst *b, char *buffer, int max);
+
+// Timelapse, see ptp_timelapse_start
+#define PTP_JITTER_BUCKETS 12
+
+struct PtpTimelapse {
+	int interval; // ms between shots
+	int frames; // 0 to run until stopped
+	int keepalive; // ms between EOS pings, 0 for none
+	int priority; // SCHED_FIFO priority for the thread, 0 for normal
+
+	// Optional, queued downloads are done between shots
+	struct PtpTether *tether;
+
+	volatile int running;
+	volatile int stop;
+	int realtime;
+	int error;
+	void *thread;
+
+	int fired;
+	int missed;
+
+	// How late triggers were, see ptp_timelapse_json for the buckets
+	uint32_t jitter[PTP_JITTER_BUCKETS];
+	uint64_t jitter_max;
+	uint64_t jitter_total;
+
+	// Recent worst case of each task in microseconds, idle work is only
+	// started if it should finish before the next trigger
+	uint64_t cost_capture;
+	uint64_t cost_ping;
+	uint64_t cost_event;
+};
+
+// Run on the calling thread until frames are taken or stop is set.
+// Returns the number of frames, or a negative error.
+int ptp_timelapse_run(struct PtpRuntime *r, struct PtpTimelapse *t);
+
+// Run on a new thread, this sets up ptp_lock_init. Any other thread using
+// the connection must hold ptp_lock.
+int ptp_timelapse_start(struct PtpRuntime *r, struct PtpTimelapse *t);
+int ptp_timelapse_stop(struct PtpRuntime *r, struct PtpTimelapse *t);
+int ptp_timelapse_json(struct PtpTimelapse *t, char *buffer, int max);
+
+// Result of ptp_eos_bulb_exposure, times are ptp_time_us
+struct PtpBulbResult {
+	int duration; // Requested, ms
+
+	uint64_t open_sent;
+	uint64_t open_ack;
+	uint64_t close_sent;
+	uint64_t close_ack;
+
+	// Shutter open time in microseconds, estimated from the middle of each
+	// round trip, and how far it was from the request
+	uint64_t measured;
+	int64_t error;
+	uint64_t uncertainty;
+
+	// The stop was sent from a SCHED_FIFO thread
+	int realtime;
+};
+
+// Open the shutter for duration ms. The commands are built beforehand, the
+// lock is held throughout, and the stop is sent from a separate thread on
+// a deadline measured from when the shutter opened.
+int ptp_eos_bulb_exposure(struct PtpRuntime *r, int duration, struct PtpBulbResult *res);
+int ptp_bulb_json(struct PtpBulbResult *res, char *buffer, int max);
+
+// Exposure bracketing, see ptp_eos_bracket
+#define PTP_BRACKET_MAX 64
+
+// Values are the same as ptp_eos_get_shutter/aperture/iso, -1 to leave as is
+struct PtpBracketFrame {
+	int shutter;
+	int aperture;
+	int iso;
+};
+
+struct PtpBracketShot {
+	uint64_t set; // Settings applied
+	uint64_t fired;
+};
+
+struct PtpBracketResult {
+	uint64_t start;
+	uint64_t end;
+	int length; // Frames taken
+	int changes; // Properties sent
+	struct PtpBracketShot frame[PTP_BRACKET_MAX];
+};
+
+// Take a frame for each entry in frames. Property data is converted up
+// front, only changed properties are sent, and each frame follows the last
+// with nothing but busy retries in between. Focus is locked for the sequence.
+int ptp_eos_bracket(struct PtpRuntime *r, struct PtpBracketFrame *frames, int length, struct PtpBracketResult *res);
+int ptp_bracket_json(struct PtpBracketResult *res, char *buffer, int max);
+
+// Focus stacking, see ptp_eos_focus_stack. Needs liveview and manual focus.
+struct PtpFocusStack {
+	int frames;
+	int step; // ptp_eos_drive_lens step, sign is the direction
+	int moves; // Drive commands between frames
+	int settle_min; // ms before a move can count as settled
+	int settle_max; // ms to give up waiting
+
+	// Optional, files are downloaded while the lens moves
+	struct PtpTether *tether;
+
+	int taken;
+	int steps;
+	int by_event; // Settled when the camera reported the focus position
+	int by_idle; // Settled when events went quiet
+	int timeouts;
+	uint64_t start;
+	uint64_t end;
+	uint64_t settle_total;
+	uint64_t settle_worst;
+};
+
+int ptp_eos_focus_stack(struct PtpRuntime *r, struct PtpFocusStack *s);
+int ptp_focus_stack_json(struct PtpFocusStack *s, char *buffer, int max);
+
+// Contrast detect autofocus, see ptp_eos_autofocus
+struct PtpAutofocus {
+	// Region scored on ML liveview (360x240), 0 size for the middle quarter.
+	// EOS liveview is JPEG, so the whole frame's compressed size is used,
+	// and setting a region returns PTP_UNSUPPORTED.
+	int x;
+	int y;
+	int w;
+	int h;
+
+	int settle; // ms to wait after each lens move
+	int skip; // Stale frames to drop after a move
+	int max_frames; // 0 for the default
+
+	int converged;
+	int frames;
+	int moves;
+	uint64_t metric;
+	uint64_t start;
+	uint64_t end;
+};
+
+// Needs liveview and manual focus. Hill climbs the sharpness with large,
+// then medium, then small ptp_eos_drive_lens steps.
+int ptp_eos_autofocus(struct PtpRuntime *r, struct PtpAutofocus *af);
+int ptp_autofocus_json(struct PtpAutofocus *af, char *buffer, int max);
+
+// Sum of absolute differences between neighbouring pixels of a luma plane
+uint64_t ptp_sharpness(const uint8_t *luma, int stride, int width, int height);
+uint64_t ptp_sharpness_scalar(const uint8_t *luma, int stride, int width, int height);
+
+// Schedules liveview requests for when the camera should have a new frame,
+// instead of asking again as soon as it says NotReady. Times are ptp_time_us.
+struct PtpLiveviewPacer {
+	uint64_t interval; // Estimated time between camera frames, 0 until known
+	uint64_t arrival; // When the last frame is thought to have been ready
+	uint64_t anchor; // Last arrival measured between a NotReady and a frame
+	uint32_t anchor_frame;
+	uint64_t last_miss; // NotReady request since the last frame
+	uint64_t backoff;
+	int misses; // NotReady in a row
+	int streak; // Frames in a row without a NotReady
+	uint64_t next; // Earliest time for the next request
+	uint64_t cost; // Average round trip of a request
+
+	uint64_t start;
+	uint64_t last;
+	uint32_t frames;
+	uint32_t requests;
+	uint32_t not_ready;
+};
+
+void ptp_liveview_pacer_reset(struct PtpLiveviewPacer *p);
+// length is what ptp_liveview_frame gave, 0 for NotReady
+void ptp_liveview_pacer_update(struct PtpLiveviewPacer *p, int length, uint64_t sent, uint64_t done);
+// Sleep until the next frame is due, then get it under ptp_lock
+int ptp_liveview_paced_frame(struct PtpRuntime *r, struct PtpLiveviewPacer *p, void *buffer);
+int ptp_liveview_pacer_json(struct PtpLiveviewPacer *p, char *buffer, int max);
+
+// One frame of a liveview ring, see ptp_liveview_thread_take
+struct PtpLiveviewFrame {
+	uint8_t *data; // ptp_liveview_size bytes
+	int length;
+	uint32_t seq; // Counts up from 1, 0 for never written
+	uint64_t time; // ptp_time_us when it arrived
+
+	// Readers holding it, -1 while the producer writes to it
+	int refs;
+	int taken;
+};
+
+#define PTP_LV_RING_MAX 8
+
+// Liveview polled on a background thread, see ptp_liveview_thread_start
+struct PtpLiveviewThread {
+	int slots; // Frames in the ring, at least 3, 0 for the default
+	int priority; // SCHED_FIFO priority for the thread, 0 for normal
+
+	struct PtpRuntime *r;
+	struct PtpLiveviewFrame ring[PTP_LV_RING_MAX];
+	int latest; // Newest whole frame, -1 for none yet
+	uint32_t seq;
+
+	volatile int running;
+	volatile int stop;
+	int realtime;
+	int error;
+	void *thread;
+
+	uint64_t start;
+	uint64_t end;
+	uint32_t produced;
+	uint32_t consumed;
+	uint32_t dropped; // Overwritten before anyone took them
+	uint32_t stalls; // Every other frame was held by readers
+
+	// Time from a frame arriving to being taken, in microseconds
+	uint64_t age_total;
+	uint64_t age_max;
+
+	struct PtpLiveviewPacer pacer;
+};
+
+// The ring is allocated once, and frames are never copied after the
+// transfer. Sets up ptp_lock_init, other threads must hold ptp_lock.
+int ptp_liveview_thread_start(struct PtpRuntime *r, struct PtpLiveviewThread *lv);
+int ptp_liveview_thread_stop(struct PtpRuntime *r, struct PtpLiveviewThread *lv);
+
+// Newest frame with a seq higher than after, or NULL. Doesn't block or copy,
+// the frame stays valid until ptp_liveview_thread_release.
+struct PtpLiveviewFrame *ptp_liveview_thread_take(struct PtpLiveviewThread *lv, uint32_t after);
+void ptp_liveview_thread_release(struct PtpLiveviewThread *lv, struct PtpLiveviewFrame *f);
+int ptp_liveview_thread_json(struct PtpLiveviewThread *lv, char *buffer, int max);
+
+// Liveview from a PtpLiveviewThread written to an AVI, see avi.c
+struct PtpRecorder {
+	struct PtpLiveviewThread *lv;
+	FILE *file;
+	uint8_t *buffer;
+
+	int mjpeg; // EOS JPEG frames, or top down BGRA for ML
+	int width;
+	int height;
+
+	// Offset and size of each frame, for the index
+	uint32_t *index;
+	uint32_t index_length;
+	uint32_t movi;
+	uint32_t biggest;
+
+	volatile int running;
+	volatile int stop;
+	int error;
+	void *thread;
+
+	uint64_t first; // ptp_time_us of the first and last frame
+	uint64_t last;
+	uint32_t frames;
+	uint32_t skipped; // Frames the writer fell behind on
+	uint64_t write_total;
+	uint64_t write_max;
+};
+
+// Writing is buffered and on its own thread, only reading the ring.
+// Files stop growing at 1GB, with PTP_OUT_OF_MEM as the error.
+int ptp_recorder_start(struct PtpRuntime *r, struct PtpRecorder *rec, struct PtpLiveviewThread *lv, const char *path);
+int ptp_recorder_stop(struct PtpRecorder *rec);
+int ptp_recorder_json(struct PtpRecorder *rec, char *buffer, int max);
+
+// Single thread AVI writer, width and height of 0 are read from the first JPEG
+int ptp_avi_open(struct PtpRecorder *rec, const char *path, int mjpeg, int width, int height);
+int ptp_avi_write(struct PtpRecorder *rec, uint8_t *data, int length, uint64_t time);
+int ptp_avi_close(struct PtpRecorder *rec);
+
+#define PTP_MJPEG_MAX_CLIENTS 16
+
+struct PtpMjpegClient {
+	int fd; // -1 for a free slot
+	int newlines;
+	int streaming; // Request was read
+
+	struct PtpLiveviewFrame *frame; // Being sent, holds a ref
+	uint8_t *data; // Frame or spill, NULL between frames
+	int length;
+	uint8_t *spill; // Copy of a frame that had to go back to the ring
+	int spill_size;
+	uint32_t seq;
+	char head[256];
+	int head_length;
+	int sent;
+	uint64_t progress; // Last time any data went out
+
+	uint32_t frames;
+	uint32_t dropped;
+};
+
+// HTTP multipart/x-mixed-replace stream of a PtpLiveviewThread, see mjpeg.c
+struct PtpMjpegServer {
+	int port; // 0 for any free port, set to the real one once started
+	int public; // Listen on every interface instead of loopback
+
+	struct PtpLiveviewThread *lv;
+	struct PtpMjpegClient client[PTP_MJPEG_MAX_CLIENTS];
+	int fd;
+
+	volatile int running;
+	volatile int stop;
+	int error;
+	void *thread;
+
+	int clients;
+	uint32_t connections;
+	uint32_t rejected; // Over PTP_MJPEG_MAX_CLIENTS
+	uint32_t timeouts;
+	uint32_t frames; // Sent, counted per client
+	uint32_t dropped; // Newer frames came before a client was done
+	uint32_t copies; // Slow clients held every spare ring frame
+	uint64_t bytes;
+};
+
+// Frames are read from the liveview once, no matter how many clients.
+// EOS (JPEG) only. Stop the server before stopping the liveview thread.
+int ptp_mjpeg_server_start(struct PtpRuntime *r, struct PtpMjpegServer *srv, struct PtpLiveviewThread *lv);
+int ptp_mjpeg_server_stop(struct PtpMjpegServer *srv);
+int ptp_mjpeg_server_json(struct PtpMjpegServer *srv, char *buffer, int max);
+
+// EOS property conversion tables, generated by eostables.py
+struct PtpEOSPair {
+	int value;
+	int data;
+};
+
+struct PtpEOSTable {
+	// Indexed by camera data, -1 if unknown
+	int value[256];
+
+	// Sorted by value, for the other direction
+	const struct PtpEOSPair *sorted;
+	int length;
+};
+
+extern const struct PtpEOSTable ptp_eos_shutter_table;
+extern const struct PtpEOSTable ptp_eos_iso_table;
+extern const struct PtpEOSTable ptp_eos_white_balance_table;
+extern const struct PtpEOSTable ptp_eos_aperture_table;
+
+// dir 0 converts camera data to a value, dir 1 converts a value to camera
+// data. Shutter, ISO and aperture snap to the nearest known stop, white
+// balance only matches exactly. Unknown data is returned as is.
 int ptp_eos_get_shutter(int data, int dir);
 int ptp_eos_get_iso(int data, int dir);
 int ptp_eos_get_aperture(int data, int dir);
@@ -169,6 +938,18 @@ int ptp_eos_get_white_balance(int data, int dir);
 int *ptp_eos_get_imgformat_data(int code);
 int ptp_eos_get_imgformat_value(int data[5]);
 
-#pragma pack(pop)
+// Generated by datasets.py. Read returns the number of bytes consumed, write
+// returns the number of bytes written, or a negative error if the data
+// runs out. Strings are UTF-8, arrays are clamped to the struct size.
+int ptp_read_device_info(uint8_t *d, int length, struct PtpDeviceInfo *out);
+int ptp_write_device_info(uint8_t *d, int max, struct PtpDeviceInfo *in);
+int ptp_read_object_info(uint8_t *d, int length, struct PtpObjectInfo *out);
+int ptp_write_object_info(uint8_t *d, int max, struct PtpObjectInfo *in);
+int ptp_read_storage_info(uint8_t *d, int length, struct PtpStorageInfo *out);
+int ptp_write_storage_info(uint8_t *d, int max, struct PtpStorageInfo *in);
+int ptp_read_prop_desc(uint8_t *d, int length, struct PtpDevPropDesc *out);
+int ptp_write_prop_desc(uint8_t *d, int max, struct PtpDevPropDesc *in);
+int ptp_read_eos_viewfinder_data(uint8_t *d, int length, struct PtpEOSViewFinderData *out);
+int ptp_write_eos_viewfinder_data(uint8_t *d, int max, struct PtpEOSViewFinderData *in);
 
 #endif
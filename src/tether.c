@@ -0,0 +1,238 @@
+// Tethered capture - EOS captures are saved to the host instead of the card
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+int ptp_tether_start(struct PtpRuntime *r, struct PtpTether *t, char *dir) {
+	if (ptp_device_type(r) != PTP_DEV_EOS) return PTP_UNSUPPORTED;
+
+	memset(t, 0, sizeof(struct PtpTether));
+	snprintf(t->dir, sizeof(t->dir), "%s", dir);
+
+	int x = ptp_eos_set_prop_value(r, PTP_PC_EOS_CaptureDestination, 4);
+	if (x) return x;
+
+	// Camera won't shoot to the host unless it thinks there is space
+	x = ptp_eos_hdd_capacity_push(r);
+	if (x) return x;
+
+	t->active = 1;
+	r->tether = t;
+	return 0;
+}
+
+int ptp_tether_stop(struct PtpRuntime *r, struct PtpTether *t) {
+	if (!t->active) return 0;
+
+	// Anything already in camera RAM still has to come out
+	int x = ptp_tether_poll(r, t);
+	if (x < 0) return x;
+
+	x = ptp_eos_set_prop_value(r, PTP_PC_EOS_CaptureDestination, 2);
+	if (x) return x;
+
+	t->active = 0;
+	if (r->tether == t) r->tether = NULL;
+	free(t->release);
+	t->release = NULL;
+	t->release_length = 0;
+	t->release_max = 0;
+	return ptp_eos_hdd_capacity_pop(r);
+}
+
+void ptp_tether_shot(struct PtpTether *t) {
+	t->shot = ptp_time_us();
+}
+
+int ptp_tether_queue_event(struct PtpRuntime *r, struct PtpTether *t, struct PtpCanonEvent *ce) {
+	if (ce->type != PTP_EC_EOS_RequestObjectTransfer) return 0;
+
+	struct PtpObjectInfo oi;
+	if (ptp_eos_object_info(ce, &oi)) return 0;
+
+	// Same records can be read again by an explicit call
+	for (int i = 0; i < t->queue_length; i++) {
+		if (t->queue[i].handle == ce->code) return 0;
+	}
+	for (int i = 0; i < t->release_length; i++) {
+		if (t->release[i] == ce->code) return 0;
+	}
+
+	// The camera stops shooting long before this fills up. If it does,
+	// the file is given up, but the camera still needs TransferComplete.
+	if (t->queue_length >= PTP_TETHER_QUEUE) {
+		t->errors++;
+		if (t->release_length == t->release_max) {
+			int n = t->release_max ? t->release_max * 2 : PTP_TETHER_QUEUE;
+			uint32_t *release = realloc(t->release, n * sizeof(uint32_t));
+			if (release == NULL) return 0;
+			t->release = release;
+			t->release_max = n;
+		}
+		t->release[t->release_length] = ce->code;
+		t->release_length++;
+		return 0;
+	}
+
+	struct PtpTetherItem *item = &t->queue[t->queue_length];
+	item->handle = ce->code;
+	item->size = oi.compressed_size;
+	snprintf(item->filename, sizeof(item->filename), "%s", oi.filename);
+	item->start = t->shot ? t->shot : ptp_time_us();
+
+	t->queue_length++;
+	return 1;
+}
+
+int ptp_tether_queue_events(struct PtpRuntime *r, struct PtpTether *t) {
+	int n = 0;
+	struct PtpCanonEvent ce;
+	void *e = ptp_open_eos_events(r);
+	while ((e = ptp_get_eos_event(r, e, &ce)) != NULL) {
+		n += ptp_tether_queue_event(r, t, &ce);
+	}
+
+	return n;
+}
+
+static void tether_path(struct PtpTether *t, struct PtpTetherItem *item, char *path, int max) {
+	char name[64];
+	if (item->filename[0] == '\0') {
+		snprintf(name, sizeof(name), "IMG_%08X", item->handle);
+	} else {
+		snprintf(name, sizeof(name), "%s", item->filename);
+	}
+
+	// Never write outside of dir
+	for (int i = 0; name[i] != '\0'; i++) {
+		if (name[i] == '/' || name[i] == '\\') name[i] = '_';
+	}
+
+	snprintf(path, max, "%s/%s", t->dir, name);
+}
+
+static void tether_stats(struct PtpTether *t, uint64_t latency, int length) {
+	if (t->count == 0 || latency < t->min) t->min = latency;
+	if (latency > t->max) t->max = latency;
+	t->last = latency;
+	t->total += latency;
+	t->bytes += length;
+	t->count++;
+}
+
+// Transfers that didn't fit in the queue
+static int tether_release(struct PtpRuntime *r, struct PtpTether *t) {
+	while (t->release_length) {
+		int x = ptp_eos_transfer_complete(r, t->release[t->release_length - 1]);
+		if (x == PTP_IO_ERR) return x;
+		t->release_length--;
+	}
+
+	return 0;
+}
+
+int ptp_tether_download_next(struct PtpRuntime *r, struct PtpTether *t) {
+	int x = tether_release(r, t);
+	if (x) return x;
+
+	if (t->queue_length == 0) return 0;
+
+	struct PtpTetherItem item = t->queue[0];
+
+	char path[sizeof(t->dir) + 64];
+	tether_path(t, &item, path, sizeof(path));
+
+	// Left queued, the image stays safe in camera RAM. If it keeps failing
+	// (dir gone, disk full) it's given up so the camera doesn't stall.
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) {
+		t->open_failures++;
+		if (t->open_failures < PTP_TETHER_OPEN_RETRIES) return PTP_RUNTIME_ERR;
+	}
+	t->open_failures = 0;
+
+	t->queue_length--;
+	memmove(&t->queue[0], &t->queue[1], t->queue_length * sizeof(struct PtpTetherItem));
+
+	if (f == NULL) {
+		t->errors++;
+		x = ptp_eos_transfer_complete(r, item.handle);
+		if (x == PTP_IO_ERR) return x;
+		return PTP_RUNTIME_ERR;
+	}
+
+	uint64_t start = ptp_time_us();
+	int length = ptp_get_object_file(r, item.handle, f);
+	if (fclose(f) && length >= 0) length = PTP_RUNTIME_ERR;
+	if (length == PTP_IO_ERR) return length;
+
+	uint64_t now = ptp_time_us();
+	t->busy += now - start;
+	if (length >= 0) {
+		tether_stats(t, now - item.start, length);
+	} else {
+		t->errors++;
+		remove(path);
+	}
+
+	// Frees the camera buffer for the next shot, even if the download
+	// failed, otherwise the camera stalls once RAM is full
+	x = ptp_eos_transfer_complete(r, item.handle);
+	if (x == PTP_IO_ERR) return x;
+
+	if (length < 0) return 0;
+
+	if (t->fn != NULL) {
+		x = t->fn(r, path, &item, t->arg);
+		if (x < 0) return x;
+	}
+
+	return 1;
+}
+
+uint64_t ptp_tether_estimate(struct PtpTether *t) {
+	if (t->queue_length == 0) return 0;
+
+	// Assume 20MB/s until something has been downloaded
+	uint64_t size = t->queue[0].size;
+	if (t->busy == 0 || t->bytes == 0) return size / 20;
+	return (size * t->busy) / t->bytes;
+}
+
+int ptp_tether_download(struct PtpRuntime *r, struct PtpTether *t) {
+	int x = tether_release(r, t);
+	if (x) return x;
+
+	int n = 0;
+	while (t->queue_length) {
+		int x = ptp_tether_download_next(r, t);
+		if (x < 0) return x;
+		n += x;
+	}
+
+	// Later captures weren't marked
+	t->shot = 0;
+
+	return n;
+}
+
+int ptp_tether_poll(struct PtpRuntime *r, struct PtpTether *t) {
+	// Queues transfers as a side effect
+	int x = ptp_eos_get_event(r);
+	if (x) return x;
+
+	return ptp_tether_download(r, t);
+}
+
+int ptp_tether_json(struct PtpTether *t, char *buffer, int max) {
+	uint64_t avg = t->count ? t->total / t->count : 0;
+	return snprintf(buffer, max, "{\"active\": %d, \"count\": %d, \"errors\": %d, \"pending\": %d, \"bytes\": %llu, "
+		"\"latency\": {\"last\": %.1f, \"min\": %.1f, \"max\": %.1f, \"avg\": %.1f}}",
+		t->active, t->count, t->errors, t->queue_length, (unsigned long long)t->bytes,
+		t->last / 1000.0, t->min / 1000.0, t->max / 1000.0, avg / 1000.0);
+}
@@ -0,0 +1,217 @@
+// Interval capture on absolute deadlines, so late triggers never add up
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+// Idle work must finish this long before the next trigger
+#define PTP_TIMELAPSE_GUARD 2000
+
+// How often events are checked between shots
+#define PTP_TIMELAPSE_EVENTS 250000
+
+// Longest single sleep, so stop is noticed on long intervals
+#define PTP_TIMELAPSE_WAKE 100000
+
+// Upper bound of each jitter bucket in microseconds, the last one is open ended
+static const uint32_t jitter_limits[PTP_JITTER_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 250000,
+};
+
+static void timelapse_jitter(struct PtpTimelapse *t, uint64_t late) {
+	int i = 0;
+	while (i < PTP_JITTER_BUCKETS - 1 && late >= jitter_limits[i]) i++;
+	t->jitter[i]++;
+	t->jitter_total += late;
+	if (late > t->jitter_max) t->jitter_max = late;
+}
+
+// Worst recent cost, slowly forgets old spikes
+static void timelapse_cost(uint64_t *cost, uint64_t start) {
+	uint64_t took = ptp_time_us() - start;
+	*cost = (*cost * 7) / 8;
+	if (took > *cost) *cost = took;
+}
+
+// Do one piece of work that fits in the time left, returns 1 if something was done
+static int timelapse_idle(struct PtpRuntime *r, struct PtpTimelapse *t, uint64_t left, uint64_t *last_ping, uint64_t *last_event) {
+	uint64_t now = ptp_time_us();
+	int eos = ptp_device_type(r) == PTP_DEV_EOS;
+	int x;
+
+	if (eos && t->keepalive && now - *last_ping >= (uint64_t)t->keepalive * 1000 && t->cost_ping < left) {
+		ptp_lock(r);
+		x = ptp_eos_ping(r);
+		ptp_unlock(r);
+		timelapse_cost(&t->cost_ping, now);
+		*last_ping = now;
+		return x == PTP_IO_ERR ? x : 1;
+	}
+
+	if (eos && now - *last_event >= PTP_TIMELAPSE_EVENTS && t->cost_event < left) {
+		ptp_lock(r);
+		x = ptp_eos_get_event(r);
+		ptp_unlock(r);
+		timelapse_cost(&t->cost_event, now);
+		*last_event = now;
+		return x == PTP_IO_ERR ? x : 1;
+	}
+
+	// Sizes are known, so a file is only started if it should be done in time
+	if (t->tether != NULL && t->tether->queue_length && ptp_tether_estimate(t->tether) < left) {
+		ptp_lock(r);
+		x = ptp_tether_download_next(r, t->tether);
+		ptp_unlock(r);
+		if (x == PTP_IO_ERR) return x;
+
+		// Nowhere to save it, try again after the next shot
+		return x < 0 ? 0 : 1;
+	}
+
+	return 0;
+}
+
+int ptp_timelapse_run(struct PtpRuntime *r, struct PtpTimelapse *t) {
+	t->running = 1;
+	t->error = 0;
+	t->fired = 0;
+	t->missed = 0;
+	memset(t->jitter, 0, sizeof(t->jitter));
+	t->jitter_max = 0;
+	t->jitter_total = 0;
+
+	uint64_t period = (uint64_t)t->interval * 1000;
+	uint64_t start = ptp_time_us();
+	uint64_t last_ping = start;
+	uint64_t last_event = 0;
+	uint64_t slot = 0;
+
+	while (!t->stop && (t->frames == 0 || t->fired < t->frames)) {
+		uint64_t deadline = start + (slot * period);
+
+		while (!t->stop) {
+			uint64_t now = ptp_time_us();
+			if (now + PTP_TIMELAPSE_GUARD >= deadline) break;
+
+			int x = timelapse_idle(r, t, deadline - now - PTP_TIMELAPSE_GUARD, &last_ping, &last_event);
+			if (x < 0) {
+				t->error = x;
+				goto end;
+			}
+			if (x == 0) break;
+		}
+
+		while (!t->stop) {
+			uint64_t now = ptp_time_us();
+			if (now >= deadline) break;
+			ptp_sleep_until(deadline - now > PTP_TIMELAPSE_WAKE ? now + PTP_TIMELAPSE_WAKE : deadline);
+		}
+
+		if (t->stop) break;
+
+		ptp_lock(r);
+		uint64_t now = ptp_time_us();
+		int x = ptp_take_picture(r);
+		ptp_unlock(r);
+		timelapse_cost(&t->cost_capture, now);
+		if (x) {
+			t->error = x;
+			break;
+		}
+
+		if (t->tether != NULL) t->tether->shot = now;
+
+		timelapse_jitter(t, now - deadline);
+		t->fired++;
+		slot++;
+
+		// Stay on the original grid. Slots that are over half an interval
+		// behind are skipped rather than fired back to back.
+		now = ptp_time_us();
+		while (start + (slot * period) + (period / 2) < now) {
+			slot++;
+			t->missed++;
+		}
+	}
+
+	end:;
+	t->running = 0;
+	return t->error ? t->error : t->fired;
+}
+
+struct TimelapseArgs {
+	struct PtpRuntime *r;
+	struct PtpTimelapse *t;
+};
+
+static void *timelapse_thread(void *arg) {
+	struct TimelapseArgs *a = arg;
+	ptp_timelapse_run(a->r, a->t);
+	free(a);
+	return NULL;
+}
+
+int ptp_timelapse_start(struct PtpRuntime *r, struct PtpTimelapse *t) {
+	if (t->thread != NULL) {
+		if (t->running) return PTP_RUNTIME_ERR;
+		ptp_timelapse_stop(r, t);
+	}
+	if (t->interval <= 0) return PTP_RUNTIME_ERR;
+	if (r->lock == NULL) {
+		int x = ptp_lock_init(r);
+		if (x) return x;
+	}
+
+	struct TimelapseArgs *a = malloc(sizeof(struct TimelapseArgs));
+	if (a == NULL) return PTP_OUT_OF_MEM;
+
+	a->r = r;
+	a->t = t;
+	t->stop = 0;
+	t->running = 1;
+
+	int x = ptp_thread_start(&t->thread, timelapse_thread, a, t->priority);
+	if (x < 0) {
+		t->running = 0;
+		free(a);
+		return x;
+	}
+
+	t->realtime = x;
+	return 0;
+}
+
+// Don't hold the lock while calling this, the thread may be waiting on it
+int ptp_timelapse_stop(struct PtpRuntime *r, struct PtpTimelapse *t) {
+	if (t->thread == NULL) return 0;
+
+	t->stop = 1;
+	ptp_thread_join(t->thread);
+	t->thread = NULL;
+
+	return t->error;
+}
+
+int ptp_timelapse_json(struct PtpTimelapse *t, char *buffer, int max) {
+	double avg = t->fired ? (double)t->jitter_total / t->fired / 1000.0 : 0;
+	int curr = snprintf(buffer, max, "{\"running\": %d, \"realtime\": %d, \"error\": %d, \"fired\": %d, \"missed\": %d, "
+		"\"jitter\": {\"avg\": %.3f, \"max\": %.3f, \"histogram\": [",
+		t->running, t->realtime, t->error, t->fired, t->missed, avg, t->jitter_max / 1000.0);
+
+	// [upper bound in ms, count], the last bound is null
+	for (int i = 0; i < PTP_JITTER_BUCKETS; i++) {
+		if (i < PTP_JITTER_BUCKETS - 1) {
+			curr += snprintf(buffer + curr, max - curr, "[%.1f, %u], ", jitter_limits[i] / 1000.0, t->jitter[i]);
+		} else {
+			curr += snprintf(buffer + curr, max - curr, "[null, %u]", t->jitter[i]);
+		}
+		if (curr >= max) return max;
+	}
+
+	curr += snprintf(buffer + curr, max - curr, "]}}");
+	return curr;
+}
@@ -3,6 +3,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
 
 #include <camlib.h>
 #include <ptp.h>
@@ -16,10 +20,173 @@ void ptp_generic_init(struct PtpRuntime *r) {
 	r->max_packet_size = 512;
 	r->data_phase_length = 0;
 	r->di = NULL;
+	r->props = calloc(1, sizeof(struct PtpPropStore));
+	r->arena.base = malloc(CAMLIB_ARENA_SIZE);
+	r->arena.size = CAMLIB_ARENA_SIZE;
+	r->arena.used = 0;
+	r->arena.desc_start = 0;
+	r->arena.desc_end = 0;
+	r->stream = NULL;
+	r->pool = NULL;
+	r->cache = NULL;
+	r->lock = NULL;
+	r->tether = NULL;
 }
 
 void ptp_generic_close(struct PtpRuntime *r) {
+	ptp_lock_close(r);
+	ptp_buffer_pool_close(r);
+	ptp_object_cache_close(r);
 	free(r->data);
+	free(r->props);
+	free(r->arena.base);
+}
+
+void *ptp_arena_alloc(struct PtpRuntime *r, int size) {
+	int used = (r->arena.used + 7) & ~7;
+	if (r->arena.base == NULL || size < 0 || used + size > r->arena.size) {
+		return NULL;
+	}
+
+	r->arena.used = used + size;
+	return r->arena.base + used;
+}
+
+void ptp_arena_reset(struct PtpRuntime *r) {
+	r->arena.used = 0;
+	r->arena.desc_start = 0;
+	r->arena.desc_end = 0;
+}
+
+int ptp_arena_mark(struct PtpRuntime *r) {
+	return r->arena.used;
+}
+
+void ptp_arena_rewind(struct PtpRuntime *r, int mark) {
+	r->arena.used = mark;
+	if (mark < r->arena.desc_end) {
+		r->arena.desc_start = -1;
+		r->arena.desc_end = -1;
+	}
+}
+
+struct PtpLock {
+	pthread_mutex_t mutex;
+};
+
+int ptp_lock_init(struct PtpRuntime *r) {
+	if (r->lock != NULL) return 0;
+
+	struct PtpLock *l = calloc(1, sizeof(struct PtpLock));
+	if (l == NULL) return PTP_OUT_OF_MEM;
+
+	// Recursive, so a locked caller can still use functions that lock
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&l->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	r->lock = l;
+	return 0;
+}
+
+void ptp_lock_close(struct PtpRuntime *r) {
+	if (r->lock == NULL) return;
+	pthread_mutex_destroy(&r->lock->mutex);
+	free(r->lock);
+	r->lock = NULL;
+}
+
+void ptp_lock(struct PtpRuntime *r) {
+	if (r->lock != NULL) pthread_mutex_lock(&r->lock->mutex);
+}
+
+void ptp_unlock(struct PtpRuntime *r) {
+	if (r->lock != NULL) pthread_mutex_unlock(&r->lock->mutex);
+}
+
+#define PTP_POOL_MAX 8
+
+struct PtpBufferPool {
+	pthread_mutex_t lock;
+	uint8_t *spare[PTP_POOL_MAX];
+	int spare_length;
+};
+
+int ptp_buffer_pool_init(struct PtpRuntime *r, int count) {
+	if (r->pool != NULL) return PTP_RUNTIME_ERR;
+	if (count < 2 || count > PTP_POOL_MAX + 1) return PTP_RUNTIME_ERR;
+
+	struct PtpBufferPool *pool = calloc(1, sizeof(struct PtpBufferPool));
+	if (pool == NULL) return PTP_OUT_OF_MEM;
+	pthread_mutex_init(&pool->lock, NULL);
+
+	for (int i = 0; i < count - 1; i++) {
+		pool->spare[i] = malloc(r->data_length);
+		if (pool->spare[i] == NULL) {
+			r->pool = pool;
+			ptp_buffer_pool_close(r);
+			return PTP_OUT_OF_MEM;
+		}
+		pool->spare_length++;
+	}
+
+	r->pool = pool;
+	return 0;
+}
+
+void ptp_buffer_pool_close(struct PtpRuntime *r) {
+	struct PtpBufferPool *pool = r->pool;
+	if (pool == NULL) return;
+
+	for (int i = 0; i < pool->spare_length; i++) {
+		free(pool->spare[i]);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+	r->pool = NULL;
+}
+
+uint8_t *ptp_buffer_take(struct PtpRuntime *r) {
+	struct PtpBufferPool *pool = r->pool;
+	if (pool == NULL) return NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->spare_length == 0) {
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	pool->spare_length--;
+	uint8_t *spare = pool->spare[pool->spare_length];
+	pthread_mutex_unlock(&pool->lock);
+
+	uint8_t *taken = r->data;
+	r->data = spare;
+	return taken;
+}
+
+void ptp_buffer_release(struct PtpRuntime *r, uint8_t *buffer) {
+	struct PtpBufferPool *pool = r->pool;
+	if (pool == NULL || buffer == NULL) return;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->spare_length < PTP_POOL_MAX) {
+		pool->spare[pool->spare_length] = buffer;
+		pool->spare_length++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+uint8_t *ptp_buffer_payload(uint8_t *buffer) {
+	return buffer + 12;
+}
+
+int ptp_buffer_payload_length(uint8_t *buffer) {
+	struct PtpBulkContainer *bulk = (struct PtpBulkContainer *)buffer;
+	return bulk->length - 12;
 }
 
 // May be slightly inneficient for every frame/action
@@ -72,6 +239,8 @@ int ptp_generic_send(struct PtpRuntime *r, struct PtpCommand *cmd) {
 	if (ptp_send_bulk_packets(r, length) != length) return PTP_IO_ERR;
 	if (ptp_recieve_bulk_packets(r) < 0) return PTP_IO_ERR;
 
+	ptp_stream_finish(r);
+
 	if (ptp_get_return_code(r) == PTP_RC_OK) {
 		return 0;
 	} else {
@@ -104,6 +273,64 @@ int ptp_generic_send_data(struct PtpRuntime *r, struct PtpCommand *cmd, void *da
 	}
 }
 
+uint64_t ptp_time_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+int ptp_thread_start(void **thread, void *(*fn)(void *), void *arg, int priority) {
+	pthread_t *t = malloc(sizeof(pthread_t));
+	if (t == NULL) return PTP_OUT_OF_MEM;
+
+	// Real time scheduling usually needs privileges, run normally without them
+	if (priority > 0) {
+		pthread_attr_t attr;
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = priority;
+		pthread_attr_init(&attr);
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+		int x = pthread_create(t, &attr, fn, arg);
+		pthread_attr_destroy(&attr);
+		if (x == 0) {
+			*thread = t;
+			return 1;
+		}
+	}
+
+	if (pthread_create(t, NULL, fn, arg)) {
+		free(t);
+		return PTP_RUNTIME_ERR;
+	}
+
+	*thread = t;
+	return 0;
+}
+
+void ptp_thread_join(void *thread) {
+	pthread_join(*(pthread_t *)thread, NULL);
+	free(thread);
+}
+
+void ptp_sleep_until(uint64_t us) {
+	struct timespec ts;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+#ifdef __APPLE__
+	uint64_t now = ptp_time_us();
+	if (us <= now) return;
+	ts.tv_sec = (us - now) / 1000000;
+	ts.tv_nsec = ((us - now) % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+#else
+	// Absolute, so time spent before the call doesn't add up
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
 int ptp_dump(struct PtpRuntime *r) {
 	FILE *f = fopen("DUMP", "w");
 	fwrite(r->data, r->data_length, 1, f);
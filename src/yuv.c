@@ -0,0 +1,452 @@
+// Magic Lantern liveview conversion - packed YUV444 to RGBA, BGRA, NV12 and I420
+// Copyright 2022 by Daniel C (https://github.com/petabyt/camlib)
+
+// The ML payload is 3 bytes per pixel: Y, then signed U and V. RGB uses
+// the BT.601 factors from test/live.c, (c * 1437) >> 10 and so on. The
+// vector paths are picked like base64.c and give the same bytes as the
+// scalar code, which also does the tail of each row.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <camlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define YUV_X86
+	#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define YUV_NEON
+	#include <arm_neon.h>
+#endif
+
+#define YUV_R_V 1437
+#define YUV_G_U -352
+#define YUV_G_V -731
+#define YUV_B_U 1812
+
+static inline uint8_t yuv_clamp(int x) {
+	if (x < 0) return 0;
+	if (x > 255) return 255;
+	return x;
+}
+
+int ptp_yuv444_size(int width, int height, int format) {
+	switch (format) {
+	case PTP_PIXEL_YUVA:
+	case PTP_PIXEL_RGBA:
+	case PTP_PIXEL_BGRA:
+		return width * height * 4;
+	case PTP_PIXEL_NV12:
+	case PTP_PIXEL_I420:
+		return (width * height) + ((width / 2) * (height / 2) * 2);
+	}
+
+	return 0;
+}
+
+// count pixels to 4 bytes each, step is 3 for the ML payload or 4 for YUVA
+static void yuv_packed_scalar(uint8_t *dst, const uint8_t *src, int step, int count, int format, uint8_t alpha) {
+	for (int i = 0; i < count; i++) {
+		int y = src[0];
+		int u = (int8_t)src[1];
+		int v = (int8_t)src[2];
+
+		if (format == PTP_PIXEL_YUVA) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		} else {
+			uint8_t r = yuv_clamp(y + ((YUV_R_V * v) >> 10));
+			uint8_t g = yuv_clamp(y + ((YUV_G_U * u) >> 10) + ((YUV_G_V * v) >> 10));
+			uint8_t b = yuv_clamp(y + ((YUV_B_U * u) >> 10));
+			dst[0] = format == PTP_PIXEL_RGBA ? r : b;
+			dst[1] = g;
+			dst[2] = format == PTP_PIXEL_RGBA ? b : r;
+		}
+
+		dst[3] = alpha;
+		dst += 4;
+		src += step;
+	}
+}
+
+// Two rows from column x (even) on. Chroma is the rounded average of each
+// 2x2 block, stored unsigned like every other NV12/I420 source.
+static void yuv_planar_scalar(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, int uv_step,
+		const uint8_t *s0, const uint8_t *s1, int x, int width) {
+	for (; x < width; x += 2) {
+		const uint8_t *a = s0 + (x * 3);
+		const uint8_t *b = s1 + (x * 3);
+		y0[x] = a[0];
+		y0[x + 1] = a[3];
+		y1[x] = b[0];
+		y1[x + 1] = b[3];
+		u[(x / 2) * uv_step] = ((a[1] ^ 0x80) + (a[4] ^ 0x80) + (b[1] ^ 0x80) + (b[4] ^ 0x80) + 2) >> 2;
+		v[(x / 2) * uv_step] = ((a[2] ^ 0x80) + (a[5] ^ 0x80) + (b[2] ^ 0x80) + (b[5] ^ 0x80) + 2) >> 2;
+	}
+}
+
+// Row kernels, the same signature for every instruction set
+typedef int yuv_packed_fn(uint8_t *dst, const uint8_t *src, int count, int format, uint8_t alpha);
+typedef int yuv_planar_fn(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, int uv_step,
+	const uint8_t *s0, const uint8_t *s1, int width);
+
+static int yuv_planar(uint8_t *dst, const uint8_t *src, int width, int height, int format, yuv_planar_fn *fn) {
+	if ((width & 1) || (height & 1)) return PTP_RUNTIME_ERR;
+
+	int cw = width / 2;
+	uint8_t *luma = dst;
+	uint8_t *u = dst + (width * height);
+	uint8_t *v;
+	int uv_step, uv_stride;
+	if (format == PTP_PIXEL_NV12) {
+		v = u + 1;
+		uv_step = 2;
+		uv_stride = width;
+	} else {
+		v = u + (cw * (height / 2));
+		uv_step = 1;
+		uv_stride = cw;
+	}
+
+	for (int y = 0; y < height; y += 2) {
+		const uint8_t *s0 = src + (y * width * 3);
+		int row = (y / 2) * uv_stride;
+		int x = 0;
+		if (fn != NULL) {
+			x = fn(luma + (y * width), luma + ((y + 1) * width), u + row, v + row, uv_step, s0, s0 + (width * 3), width);
+		}
+		yuv_planar_scalar(luma + (y * width), luma + ((y + 1) * width), u + row, v + row, uv_step,
+			s0, s0 + (width * 3), x, width);
+	}
+
+	return ptp_yuv444_size(width, height, format);
+}
+
+#ifdef YUV_X86
+#define YUV_SSE2 __attribute__((target("sse2")))
+#define YUV_AVX2 __attribute__((target("avx2")))
+
+// 48 bytes into 16 Y, U and V. SSE2 has no byte shuffle, so the channels
+// are split with five rounds of unpacks (as in OpenCV's v_load_deinterleave).
+YUV_SSE2 static inline void yuv_split_sse2(const uint8_t *src, __m128i *a, __m128i *b, __m128i *c) {
+	__m128i t00 = _mm_loadu_si128((const __m128i *)src);
+	__m128i t01 = _mm_loadu_si128((const __m128i *)(src + 16));
+	__m128i t02 = _mm_loadu_si128((const __m128i *)(src + 32));
+
+	__m128i t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+	__m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+	__m128i t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+
+	__m128i t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+	__m128i t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+	__m128i t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+	__m128i t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+	__m128i t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+	__m128i t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+	*a = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+	*b = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+	*c = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+}
+
+// Signed chroma into the high byte, then down to c << 6, so that
+// mulhi(c << 6, k) is exactly (c * k) >> 10
+YUV_SSE2 static inline void yuv_rgb16_sse2(__m128i y, __m128i u, __m128i v, __m128i *r, __m128i *g, __m128i *b) {
+	u = _mm_srai_epi16(u, 2);
+	v = _mm_srai_epi16(v, 2);
+	*r = _mm_add_epi16(y, _mm_mulhi_epi16(v, _mm_set1_epi16(YUV_R_V)));
+	*g = _mm_add_epi16(y, _mm_add_epi16(_mm_mulhi_epi16(u, _mm_set1_epi16(YUV_G_U)), _mm_mulhi_epi16(v, _mm_set1_epi16(YUV_G_V))));
+	*b = _mm_add_epi16(y, _mm_mulhi_epi16(u, _mm_set1_epi16(YUV_B_U)));
+}
+
+YUV_SSE2 static int yuv_packed_sse2(uint8_t *dst, const uint8_t *src, int count, int format, uint8_t alpha) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a = _mm_set1_epi8((char)alpha);
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i y, u, v;
+		yuv_split_sse2(src + (i * 3), &y, &u, &v);
+
+		__m128i c0 = y, c1 = u, c2 = v;
+		if (format != PTP_PIXEL_YUVA) {
+			__m128i rl, gl, bl, rh, gh, bh;
+			yuv_rgb16_sse2(_mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(zero, u), _mm_unpacklo_epi8(zero, v), &rl, &gl, &bl);
+			yuv_rgb16_sse2(_mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(zero, u), _mm_unpackhi_epi8(zero, v), &rh, &gh, &bh);
+			__m128i r = _mm_packus_epi16(rl, rh);
+			__m128i b = _mm_packus_epi16(bl, bh);
+			c0 = format == PTP_PIXEL_RGBA ? r : b;
+			c1 = _mm_packus_epi16(gl, gh);
+			c2 = format == PTP_PIXEL_RGBA ? b : r;
+		}
+
+		__m128i lo01 = _mm_unpacklo_epi8(c0, c1);
+		__m128i hi01 = _mm_unpackhi_epi8(c0, c1);
+		__m128i lo23 = _mm_unpacklo_epi8(c2, a);
+		__m128i hi23 = _mm_unpackhi_epi8(c2, a);
+
+		__m128i *out = (__m128i *)(dst + (i * 4));
+		_mm_storeu_si128(out, _mm_unpacklo_epi16(lo01, lo23));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo01, lo23));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi01, hi23));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi01, hi23));
+	}
+
+	return i;
+}
+
+// Sum of each 2x2 block of 16 pixels over two rows, 8 rounded averages
+YUV_SSE2 static inline __m128i yuv_average_sse2(__m128i a, __m128i b) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	a = _mm_xor_si128(a, bias);
+	b = _mm_xor_si128(b, bias);
+	__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+	__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+	lo = _mm_madd_epi16(lo, _mm_set1_epi16(1));
+	hi = _mm_madd_epi16(hi, _mm_set1_epi16(1));
+	lo = _mm_srli_epi32(_mm_add_epi32(lo, _mm_set1_epi32(2)), 2);
+	hi = _mm_srli_epi32(_mm_add_epi32(hi, _mm_set1_epi32(2)), 2);
+	__m128i avg = _mm_packs_epi32(lo, hi);
+	return _mm_packus_epi16(avg, avg);
+}
+
+YUV_SSE2 static int yuv_planar_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, int uv_step,
+		const uint8_t *s0, const uint8_t *s1, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i ya, ua, va, yb, ub, vb;
+		yuv_split_sse2(s0 + (x * 3), &ya, &ua, &va);
+		yuv_split_sse2(s1 + (x * 3), &yb, &ub, &vb);
+		_mm_storeu_si128((__m128i *)(y0 + x), ya);
+		_mm_storeu_si128((__m128i *)(y1 + x), yb);
+
+		__m128i cu = yuv_average_sse2(ua, ub);
+		__m128i cv = yuv_average_sse2(va, vb);
+		if (uv_step == 2) {
+			_mm_storeu_si128((__m128i *)(u + x), _mm_unpacklo_epi8(cu, cv));
+		} else {
+			_mm_storel_epi64((__m128i *)(u + (x / 2)), cu);
+			_mm_storel_epi64((__m128i *)(v + (x / 2)), cv);
+		}
+	}
+
+	return x;
+}
+
+// Byte picks for each channel out of the three 16 byte loads
+static const uint8_t yuv_shuffle[3][3][16] = {
+	{
+		{0, 3, 6, 9, 12, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+		{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 5, 8, 11, 14, 0x80, 0x80, 0x80, 0x80, 0x80},
+		{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 1, 4, 7, 10, 13},
+	},
+	{
+		{1, 4, 7, 10, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+		{0x80, 0x80, 0x80, 0x80, 0x80, 0, 3, 6, 9, 12, 15, 0x80, 0x80, 0x80, 0x80, 0x80},
+		{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 5, 8, 11, 14},
+	},
+	{
+		{2, 5, 8, 11, 14, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+		{0x80, 0x80, 0x80, 0x80, 0x80, 1, 4, 7, 10, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+		{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 3, 6, 9, 12, 15},
+	},
+};
+
+YUV_AVX2 static inline __m256i yuv_load2_avx2(const uint8_t *lo, const uint8_t *hi) {
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)lo)),
+		_mm_loadu_si128((const __m128i *)hi), 1);
+}
+
+// 32 pixels, 16 in each 128 bit lane, so every shuffle stays in its lane
+YUV_AVX2 static inline __m256i yuv_channel_avx2(__m256i a, __m256i b, __m256i c, int ch) {
+	__m256i x = _mm256_shuffle_epi8(a, _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)yuv_shuffle[ch][0])));
+	x = _mm256_or_si256(x, _mm256_shuffle_epi8(b, _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)yuv_shuffle[ch][1]))));
+	return _mm256_or_si256(x, _mm256_shuffle_epi8(c, _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)yuv_shuffle[ch][2]))));
+}
+
+YUV_AVX2 static inline void yuv_rgb16_avx2(__m256i y, __m256i u, __m256i v, __m256i *r, __m256i *g, __m256i *b) {
+	u = _mm256_srai_epi16(u, 2);
+	v = _mm256_srai_epi16(v, 2);
+	*r = _mm256_add_epi16(y, _mm256_mulhi_epi16(v, _mm256_set1_epi16(YUV_R_V)));
+	*g = _mm256_add_epi16(y, _mm256_add_epi16(_mm256_mulhi_epi16(u, _mm256_set1_epi16(YUV_G_U)),
+		_mm256_mulhi_epi16(v, _mm256_set1_epi16(YUV_G_V))));
+	*b = _mm256_add_epi16(y, _mm256_mulhi_epi16(u, _mm256_set1_epi16(YUV_B_U)));
+}
+
+YUV_AVX2 static int yuv_packed_avx2(uint8_t *dst, const uint8_t *src, int count, int format, uint8_t alpha) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i a = _mm256_set1_epi8((char)alpha);
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		const uint8_t *s = src + (i * 3);
+		__m256i l0 = yuv_load2_avx2(s, s + 48);
+		__m256i l1 = yuv_load2_avx2(s + 16, s + 64);
+		__m256i l2 = yuv_load2_avx2(s + 32, s + 80);
+		__m256i y = yuv_channel_avx2(l0, l1, l2, 0);
+		__m256i u = yuv_channel_avx2(l0, l1, l2, 1);
+		__m256i v = yuv_channel_avx2(l0, l1, l2, 2);
+
+		__m256i c0 = y, c1 = u, c2 = v;
+		if (format != PTP_PIXEL_YUVA) {
+			__m256i rl, gl, bl, rh, gh, bh;
+			yuv_rgb16_avx2(_mm256_unpacklo_epi8(y, zero), _mm256_unpacklo_epi8(zero, u), _mm256_unpacklo_epi8(zero, v), &rl, &gl, &bl);
+			yuv_rgb16_avx2(_mm256_unpackhi_epi8(y, zero), _mm256_unpackhi_epi8(zero, u), _mm256_unpackhi_epi8(zero, v), &rh, &gh, &bh);
+			__m256i r = _mm256_packus_epi16(rl, rh);
+			__m256i b = _mm256_packus_epi16(bl, bh);
+			c0 = format == PTP_PIXEL_RGBA ? r : b;
+			c1 = _mm256_packus_epi16(gl, gh);
+			c2 = format == PTP_PIXEL_RGBA ? b : r;
+		}
+
+		// Each lane interleaves its own 16 pixels, the halves are put back in order at the end
+		__m256i lo01 = _mm256_unpacklo_epi8(c0, c1);
+		__m256i hi01 = _mm256_unpackhi_epi8(c0, c1);
+		__m256i lo23 = _mm256_unpacklo_epi8(c2, a);
+		__m256i hi23 = _mm256_unpackhi_epi8(c2, a);
+		__m256i o0 = _mm256_unpacklo_epi16(lo01, lo23);
+		__m256i o1 = _mm256_unpackhi_epi16(lo01, lo23);
+		__m256i o2 = _mm256_unpacklo_epi16(hi01, hi23);
+		__m256i o3 = _mm256_unpackhi_epi16(hi01, hi23);
+
+		__m256i *out = (__m256i *)(dst + (i * 4));
+		_mm256_storeu_si256(out, _mm256_permute2x128_si256(o0, o1, 0x20));
+		_mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(o2, o3, 0x20));
+		_mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(o0, o1, 0x31));
+		_mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(o2, o3, 0x31));
+	}
+
+	return i;
+}
+
+static int yuv_x86_level = -1;
+
+static void yuv_x86_detect(void) {
+	if (yuv_x86_level != -1) return;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		yuv_x86_level = 2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		yuv_x86_level = 1;
+	} else {
+		yuv_x86_level = 0;
+	}
+}
+#endif
+
+#ifdef YUV_NEON
+// vqdmulh is (2 * a * b) >> 16, so c << 5 gives (c * k) >> 10
+static inline void yuv_rgb16_neon(int16x8_t y, int16x8_t u, int16x8_t v, uint8x8_t *r, uint8x8_t *g, uint8x8_t *b) {
+	u = vshlq_n_s16(u, 5);
+	v = vshlq_n_s16(v, 5);
+	*r = vqmovun_s16(vaddq_s16(y, vqdmulhq_n_s16(v, YUV_R_V)));
+	*g = vqmovun_s16(vaddq_s16(y, vaddq_s16(vqdmulhq_n_s16(u, YUV_G_U), vqdmulhq_n_s16(v, YUV_G_V))));
+	*b = vqmovun_s16(vaddq_s16(y, vqdmulhq_n_s16(u, YUV_B_U)));
+}
+
+static int yuv_packed_neon(uint8_t *dst, const uint8_t *src, int count, int format, uint8_t alpha) {
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16x3_t in = vld3q_u8(src + (i * 3));
+		uint8x16x4_t out;
+		out.val[3] = vdupq_n_u8(alpha);
+
+		if (format == PTP_PIXEL_YUVA) {
+			out.val[0] = in.val[0];
+			out.val[1] = in.val[1];
+			out.val[2] = in.val[2];
+		} else {
+			int8x16_t u = vreinterpretq_s8_u8(in.val[1]);
+			int8x16_t v = vreinterpretq_s8_u8(in.val[2]);
+			uint8x8_t rl, gl, bl, rh, gh, bh;
+			yuv_rgb16_neon(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(in.val[0]))),
+				vmovl_s8(vget_low_s8(u)), vmovl_s8(vget_low_s8(v)), &rl, &gl, &bl);
+			yuv_rgb16_neon(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(in.val[0]))),
+				vmovl_s8(vget_high_s8(u)), vmovl_s8(vget_high_s8(v)), &rh, &gh, &bh);
+			uint8x16_t r = vcombine_u8(rl, rh);
+			uint8x16_t b = vcombine_u8(bl, bh);
+			out.val[0] = format == PTP_PIXEL_RGBA ? r : b;
+			out.val[1] = vcombine_u8(gl, gh);
+			out.val[2] = format == PTP_PIXEL_RGBA ? b : r;
+		}
+
+		vst4q_u8(dst + (i * 4), out);
+	}
+
+	return i;
+}
+
+static int yuv_planar_neon(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, int uv_step,
+		const uint8_t *s0, const uint8_t *s1, int width) {
+	const uint8x16_t bias = vdupq_n_u8(0x80);
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x3_t a = vld3q_u8(s0 + (x * 3));
+		uint8x16x3_t b = vld3q_u8(s1 + (x * 3));
+		vst1q_u8(y0 + x, a.val[0]);
+		vst1q_u8(y1 + x, b.val[0]);
+
+		uint16x8_t su = vaddq_u16(vpaddlq_u8(veorq_u8(a.val[1], bias)), vpaddlq_u8(veorq_u8(b.val[1], bias)));
+		uint16x8_t sv = vaddq_u16(vpaddlq_u8(veorq_u8(a.val[2], bias)), vpaddlq_u8(veorq_u8(b.val[2], bias)));
+		uint8x8x2_t c;
+		c.val[0] = vrshrn_n_u16(su, 2);
+		c.val[1] = vrshrn_n_u16(sv, 2);
+		if (uv_step == 2) {
+			vst2_u8(u + x, c);
+		} else {
+			vst1_u8(u + (x / 2), c.val[0]);
+			vst1_u8(v + (x / 2), c.val[1]);
+		}
+	}
+
+	return x;
+}
+#endif
+
+static int yuv_convert(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha,
+		yuv_packed_fn *packed, yuv_planar_fn *planar) {
+	switch (format) {
+	case PTP_PIXEL_YUVA:
+	case PTP_PIXEL_RGBA:
+	case PTP_PIXEL_BGRA: {
+		// Packed pixels don't care about rows
+		int count = width * height;
+		int i = packed != NULL ? packed(dst, src, count, format, alpha) : 0;
+		yuv_packed_scalar(dst + (i * 4), src + (i * 3), 3, count - i, format, alpha);
+		return count * 4;
+		}
+	case PTP_PIXEL_NV12:
+	case PTP_PIXEL_I420:
+		return yuv_planar(dst, src, width, height, format, planar);
+	}
+
+	return PTP_UNSUPPORTED;
+}
+
+int ptp_yuv444_convert(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha) {
+#if defined(YUV_X86)
+	yuv_x86_detect();
+	// Chroma averaging is a small part of the planar work, SSE2 does it for both
+	switch (yuv_x86_level) {
+	case 2:
+		return yuv_convert(dst, src, width, height, format, alpha, yuv_packed_avx2, yuv_planar_sse2);
+	case 1:
+		return yuv_convert(dst, src, width, height, format, alpha, yuv_packed_sse2, yuv_planar_sse2);
+	}
+#elif defined(YUV_NEON)
+	return yuv_convert(dst, src, width, height, format, alpha, yuv_packed_neon, yuv_planar_neon);
+#endif
+	return yuv_convert(dst, src, width, height, format, alpha, NULL, NULL);
+}
+
+int ptp_yuv444_convert_scalar(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha) {
+	return yuv_convert(dst, src, width, height, format, alpha, NULL, NULL);
+}
+
+// Frames that were already expanded by ptp_liveview_frame
+int ptp_yuva_convert(uint8_t *dst, const uint8_t *src, int width, int height, int format, uint8_t alpha) {
+	if (format != PTP_PIXEL_RGBA && format != PTP_PIXEL_BGRA) return PTP_UNSUPPORTED;
+	yuv_packed_scalar(dst, src, 4, width * height, format, alpha);
+	return width * height * 4;
+}
@@ -0,0 +1,81 @@
+// Check the base64 encoder against the scalar path, and compare
+// throughput against the old integer array JSON encoding.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <camlib.h>
+
+// Typical EOS liveview JPEG
+#define FRAME_SIZE 150000
+#define RUNS 200
+
+static double cpu_now() {
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static int encode_array(char *buffer, uint8_t *data, int length) {
+	int curr = sprintf(buffer, "[");
+	for (int i = 0; i < length; i++) {
+		char *comma = "";
+		if (i) comma = ",";
+		curr += sprintf(buffer + curr, "%s%u", comma, data[i]);
+	}
+	curr += sprintf(buffer + curr, "]");
+	return curr;
+}
+
+int main() {
+	uint8_t *frame = malloc(FRAME_SIZE);
+	char *a = malloc(FRAME_SIZE * 4 + 16);
+	char *b = malloc(FRAME_SIZE * 4 + 16);
+
+	srand(1234);
+	for (int i = 0; i < FRAME_SIZE; i++) {
+		frame[i] = rand();
+	}
+
+	// Every length up to a few vector widths, and every offset
+	for (int len = 0; len < 200; len++) {
+		for (int of = 0; of < 4; of++) {
+			int x = ptp_base64_encode(a, frame + of, len);
+			int y = ptp_base64_encode_scalar(b, frame + of, len);
+			if (x != y || x != ptp_base64_length(len) || memcmp(a, b, x)) {
+				printf("Mismatch at length %d offset %d\n", len, of);
+				return 1;
+			}
+		}
+	}
+
+	// Known answer
+	int x = ptp_base64_encode(a, (uint8_t *)"camlib", 6);
+	if (x != 8 || memcmp(a, "Y2FtbGli", 8)) {
+		puts("Known answer failed");
+		return 1;
+	}
+
+	double start = cpu_now();
+	for (int i = 0; i < RUNS; i++) ptp_base64_encode_scalar(a, frame, FRAME_SIZE);
+	double scalar = (cpu_now() - start) / RUNS;
+
+	start = cpu_now();
+	for (int i = 0; i < RUNS; i++) ptp_base64_encode(a, frame, FRAME_SIZE);
+	double vector = (cpu_now() - start) / RUNS;
+
+	start = cpu_now();
+	for (int i = 0; i < RUNS / 10; i++) encode_array(b, frame, FRAME_SIZE);
+	double array = (cpu_now() - start) / (RUNS / 10);
+
+	double mb = (double)FRAME_SIZE / 1000000;
+	printf("Frame size: %d bytes\n", FRAME_SIZE);
+	printf("array:  %8.1f MB/s, %8.3f ms/frame\n", mb / array, array * 1000);
+	printf("scalar: %8.1f MB/s, %8.3f ms/frame\n", mb / scalar, scalar * 1000);
+	printf("vector: %8.1f MB/s, %8.3f ms/frame\n", mb / vector, vector * 1000);
+
+	free(frame);
+	free(a);
+	free(b);
+	return 0;
+}
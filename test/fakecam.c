@@ -0,0 +1,166 @@
+// Fake EOS camera for checks that don't need a device. It takes the place
+// of libusb.o, and answers bulk packets from a single reply buffer.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+#include "fakecam.h"
+
+struct FakeCam fakecam = {
+	.period = 0,
+	.latency = 2000,
+	.jpeg_size = 20000,
+	.jpeg_type = 1,
+};
+
+static struct PtpDeviceInfo fakecam_di;
+
+static uint8_t reply[300000];
+static int reply_length;
+static int reply_pos;
+static uint64_t delivered;
+
+void fakecam_init(struct PtpRuntime *r) {
+	memset(&fakecam_di, 0, sizeof(fakecam_di));
+	strcpy(fakecam_di.manufacturer, "Canon Inc.");
+	strcpy(fakecam_di.model, "Fake EOS");
+	fakecam_di.ops_supported[0] = PTP_OC_EOS_GetStorageIDs;
+	fakecam_di.ops_supported[1] = PTP_OC_EOS_GetViewFinderData;
+	fakecam_di.ops_supported_length = 2;
+	r->di = &fakecam_di;
+}
+
+static void put_uint32(int *o, uint32_t v) {
+	reply[*o + 0] = v & 0xff;
+	reply[*o + 1] = (v >> 8) & 0xff;
+	reply[*o + 2] = (v >> 16) & 0xff;
+	reply[*o + 3] = (v >> 24) & 0xff;
+	*o += 4;
+}
+
+static void put_response(int *o, int code, uint32_t transaction) {
+	put_uint32(o, 12);
+	put_uint32(o, PTP_PACKET_TYPE_RESPONSE | (code << 16));
+	put_uint32(o, transaction);
+}
+
+#define FAKECAM_BEFORE 32
+#define FAKECAM_AFTER 256
+
+static uint8_t *put_block(int *o, int type, int length, int fill) {
+	put_uint32(o, 8 + length);
+	put_uint32(o, type);
+	uint8_t *data = reply + *o;
+	memset(data, fill, length);
+	*o += length;
+	return data;
+}
+
+static void put_jpeg_markers(uint8_t *d, int length) {
+	uint8_t sof[] = {
+		0xff, 0xd8,
+		0xff, 0xc0, 0, 11, 8,
+		fakecam.height >> 8, fakecam.height & 0xff,
+		fakecam.width >> 8, fakecam.width & 0xff,
+		1, 1, 0x11, 0,
+	};
+	memcpy(d, sof, sizeof(sof));
+	d[length - 2] = 0xff;
+	d[length - 1] = 0xd9;
+}
+
+static void put_viewfinder(int *o, uint32_t transaction) {
+	int length = 8 + fakecam.jpeg_size;
+	if (fakecam.blocks) length += 8 + FAKECAM_BEFORE + 8 + FAKECAM_AFTER;
+
+	put_uint32(o, 12 + length);
+	put_uint32(o, PTP_PACKET_TYPE_DATA | (PTP_OC_EOS_GetViewFinderData << 16));
+	put_uint32(o, transaction);
+
+	if (fakecam.blocks) put_block(o, 4, FAKECAM_BEFORE, 0xf0);
+
+	// Filled with the frame number so a torn frame can be spotted, and kept
+	// apart from the fill of the other blocks
+	uint8_t *jpeg = put_block(o, fakecam.jpeg_type, fakecam.jpeg_size, fakecam.frames & 0x7f);
+	if (fakecam.width) put_jpeg_markers(jpeg, fakecam.jpeg_size);
+
+	if (fakecam.blocks) put_block(o, 8, FAKECAM_AFTER, 0xf8);
+}
+
+static void viewfinder(int *o, uint32_t transaction) {
+	fakecam.requests++;
+	usleep(fakecam.latency / 2);
+
+	if (fakecam.period) {
+		uint64_t frame = ptp_time_us() / fakecam.period;
+		if (frame == delivered) {
+			fakecam.not_ready++;
+			usleep(fakecam.latency / 2);
+			put_response(o, PTP_RC_CANON_NotReady, transaction);
+			return;
+		}
+		delivered = frame;
+	}
+
+	fakecam.frames++;
+	usleep(fakecam.latency / 2);
+	put_viewfinder(o, transaction);
+	put_response(o, PTP_RC_OK, transaction);
+}
+
+int ptp_device_init(struct PtpRuntime *r) {
+	return 0;
+}
+
+int ptp_device_close(struct PtpRuntime *r) {
+	return 0;
+}
+
+int ptp_device_reset(struct PtpRuntime *r) {
+	return 0;
+}
+
+int ptp_send_bulk_packet(void *to, int length) {
+	struct PtpBulkContainer *bulk = (struct PtpBulkContainer *)to;
+
+	// Data phase from the host, nothing to answer yet
+	if (bulk->type != PTP_PACKET_TYPE_COMMAND) return length;
+
+	int o = 0;
+	reply_pos = 0;
+	switch (bulk->code) {
+	case PTP_OC_EOS_GetViewFinderData:
+		viewfinder(&o, bulk->transaction);
+		break;
+	default:
+		put_response(&o, PTP_RC_OK, bulk->transaction);
+	}
+
+	reply_length = o;
+	return length;
+}
+
+// The data phase and the response come back as separate transfers
+int ptp_recieve_bulk_packet(void *to, int length) {
+	int n = reply_length - reply_pos;
+	if (reply_pos == 0 && reply_length > 12) {
+		uint32_t data_length = reply[0] | (reply[1] << 8) | (reply[2] << 16) | (reply[3] << 24);
+		if ((int)data_length < reply_length) n = data_length;
+	}
+
+	if (n > length) n = length;
+	if (n <= 0) return 0;
+
+	memcpy(to, reply + reply_pos, n);
+	reply_pos += n;
+	return n;
+}
+
+int ptp_recieve_int(void *to, int length) {
+	return 0;
+}
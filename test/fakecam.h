@@ -0,0 +1,38 @@
+// Fake EOS camera, linked in place of the USB backend (see fakecam.c)
+#ifndef FAKECAM_H
+#define FAKECAM_H
+
+#include <stdint.h>
+
+struct FakeCam {
+	// Time between new liveview frames, 0 gives a new frame every request
+	int period;
+
+	// Time a GetViewFinderData round trip takes
+	int latency;
+
+	// Size and type of the JPEG block
+	int jpeg_size;
+	int jpeg_type;
+
+	// Put a type 4 block before the JPEG and a type 8 block after it,
+	// like newer bodies do
+	int blocks;
+
+	// If set, the JPEG starts with SOI and a SOF0 of this size, and ends
+	// with EOI
+	int width;
+	int height;
+
+	// Counters, can be reset by the test
+	uint32_t requests;
+	uint32_t frames;
+	uint32_t not_ready;
+};
+
+extern struct FakeCam fakecam;
+
+// Fill in the device info for an EOS body with GetViewFinderData
+void fakecam_init(struct PtpRuntime *r);
+
+#endif
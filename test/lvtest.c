@@ -0,0 +1,377 @@
+// Liveview checks against the fake camera in fakecam.c, no device needed
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camlib.h>
+#include <ptp.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "fakecam.h"
+
+static int failed = 0;
+
+static void check(int ok, char *what) {
+	printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+	if (!ok) failed++;
+}
+
+// The pacer should keep up with the camera without spinning on NotReady
+static void test_pacing(struct PtpRuntime *r) {
+	uint8_t *buffer = malloc(ptp_liveview_size(r));
+	int periods[] = {100000, 33333, 16667};
+	for (int i = 0; i < (int)(sizeof(periods) / sizeof(periods[0])); i++) {
+		fakecam.period = periods[i];
+
+		struct PtpLiveviewPacer p;
+		ptp_liveview_pacer_reset(&p);
+
+		// Give it a second to measure the frame interval first
+		uint64_t start = ptp_time_us();
+		while (ptp_time_us() < start + 1000000) {
+			if (ptp_liveview_paced_frame(r, &p, buffer) < 0) break;
+		}
+
+		fakecam.requests = 0;
+		int frames = 0;
+		start = ptp_time_us();
+		while (ptp_time_us() < start + 2000000) {
+			int x = ptp_liveview_paced_frame(r, &p, buffer);
+			if (x < 0) break;
+			if (x > 0) frames++;
+		}
+
+		int expected = 2000000 / fakecam.period;
+		printf("period %dus: %d frames (expected %d), %u requests\n",
+			fakecam.period, frames, expected, fakecam.requests);
+		check(frames >= expected * 85 / 100, "pacer keeps the camera frame rate");
+		check((int)fakecam.requests <= frames * 2, "pacer doesn't spin on NotReady");
+	}
+
+	fakecam.period = 0;
+	free(buffer);
+}
+
+// The JPEG is found wherever it is in the list of blocks
+static void test_blocks(struct PtpRuntime *r) {
+	uint8_t *buffer = malloc(ptp_liveview_size(r));
+	ptp_buffer_pool_init(r, 2);
+
+	int layouts[][2] = {{0, 1}, {1, 1}, {1, 11}};
+	for (int i = 0; i < (int)(sizeof(layouts) / sizeof(layouts[0])); i++) {
+		fakecam.blocks = layouts[i][0];
+		fakecam.jpeg_type = layouts[i][1];
+		printf("blocks %d, JPEG type %d\n", fakecam.blocks, fakecam.jpeg_type);
+
+		int x = ptp_liveview_frame(r, buffer);
+		int fill = fakecam.frames & 0x7f;
+		check(x == fakecam.jpeg_size && buffer[0] == fill && buffer[x - 1] == fill, "frame is the JPEG block");
+
+		int types[3];
+		int length = 0;
+		struct PtpEOSViewFinderBlock block;
+		void *b = ptp_open_eos_viewfinder(r);
+		while ((b = ptp_get_eos_viewfinder_block(r, b, &block)) != NULL) {
+			if (length < 3) types[length] = block.type;
+			length++;
+		}
+
+		if (fakecam.blocks) {
+			check(length == 3 && types[0] == 4 && types[1] == fakecam.jpeg_type && types[2] == 8, "blocks are listed in order");
+		} else {
+			check(length == 1 && types[0] == fakecam.jpeg_type, "blocks are listed in order");
+		}
+
+		uint8_t *pool_buffer;
+		uint8_t *frame;
+		x = ptp_liveview_frame_take(r, &pool_buffer, &frame);
+		fill = fakecam.frames & 0x7f;
+		check(x == fakecam.jpeg_size && frame[0] == fill && frame[x - 1] == fill, "taken frame points at the JPEG block");
+		if (pool_buffer != NULL) ptp_buffer_release(r, pool_buffer);
+	}
+
+	fakecam.blocks = 0;
+	fakecam.jpeg_type = 1;
+	free(buffer);
+}
+
+static uint32_t read_uint32(uint8_t *d) {
+	return d[0] | (d[1] << 8) | (d[2] << 16) | ((uint32_t)d[3] << 24);
+}
+
+// Record from the liveview thread, then walk the AVI: header, chunks and index
+static void test_record(struct PtpRuntime *r) {
+	static struct PtpLiveviewThread lv;
+	static struct PtpRecorder rec;
+	char *path = "lvtest.avi";
+
+	fakecam.period = 33333;
+	fakecam.width = 640;
+	fakecam.height = 480;
+
+	check(ptp_liveview_thread_start(r, &lv) == 0, "liveview thread starts");
+	check(ptp_recorder_start(r, &rec, &lv, path) == 0, "recorder starts");
+	ptp_sleep_until(ptp_time_us() + 2000000);
+	check(ptp_recorder_stop(&rec) == 0, "recorder stops");
+	check(ptp_liveview_thread_stop(r, &lv) == 0, "liveview thread stops");
+
+	fakecam.period = 0;
+	fakecam.width = 0;
+	fakecam.height = 0;
+
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		check(0, "AVI file exists");
+		return;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *d = malloc(size);
+	if (fread(d, 1, size, f) != (size_t)size) size = 0;
+	fclose(f);
+	remove(path);
+
+	printf("%u frames, %ld bytes\n", rec.frames, size);
+	check(size > 256 && !memcmp(d, "RIFF", 4) && !memcmp(d + 8, "AVI ", 4), "RIFF AVI header");
+	if (size <= 256) {
+		free(d);
+		return;
+	}
+
+	check(read_uint32(d + 4) + 8 == (uint32_t)size, "RIFF size is the file size");
+
+	// avih follows the hdrl list header
+	uint8_t *avih = d + 24;
+	uint32_t frames = read_uint32(avih + 24);
+	double fps = 1000000.0 / read_uint32(avih + 8);
+	printf("header: %u frames, %.2f fps, %ux%u\n", frames, fps, read_uint32(avih + 40), read_uint32(avih + 44));
+	check(frames == rec.frames && frames >= 50, "header frame count");
+	check(fps > 27 && fps < 33, "header frame rate");
+	check(read_uint32(avih + 40) == 640 && read_uint32(avih + 44) == 480, "size from the SOF marker");
+
+	// movi list right after hdrl, then idx1
+	uint32_t movi = 12 + 8 + read_uint32(d + 16);
+	check(!memcmp(d + movi, "LIST", 4) && !memcmp(d + movi + 8, "movi", 4), "movi list");
+	uint32_t idx1 = movi + 8 + read_uint32(d + movi + 4);
+	if (idx1 + 8 > (uint32_t)size || memcmp(d + idx1, "idx1", 4) || read_uint32(d + idx1 + 4) != frames * 16) {
+		check(0, "idx1 has an entry per frame");
+		free(d);
+		return;
+	}
+
+	int bad = 0;
+	for (uint32_t i = 0; i < frames; i++) {
+		uint8_t *e = d + idx1 + 8 + (i * 16);
+		uint32_t offset = movi + 8 + read_uint32(e + 8);
+		uint32_t length = read_uint32(e + 12);
+		if (memcmp(e, "00dc", 4) || offset + 8 + length > idx1) {
+			bad++;
+			continue;
+		}
+
+		uint8_t *chunk = d + offset;
+		if (memcmp(chunk, "00dc", 4) || read_uint32(chunk + 4) != length) bad++;
+		else if (chunk[8] != 0xff || chunk[9] != 0xd8 || chunk[8 + length - 1] != 0xd9) bad++;
+	}
+
+	check(bad == 0, "index entries point at whole JPEG chunks");
+	free(d);
+}
+
+#ifndef _WIN32
+struct StreamClient {
+	int port;
+	int delay; // ms between frames, -1 to never read
+	int seconds;
+	pthread_t thread;
+
+	int fd;
+	int frames;
+	int bad;
+};
+
+static int stream_connect(int port, int rcvbuf) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+
+	struct timeval tv = {1, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (rcvbuf) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// Start and end markers, and the frame number fill in between
+static int stream_check_jpeg(uint8_t *d, int length) {
+	if (length < 20 || d[0] != 0xff || d[1] != 0xd8 || d[length - 2] != 0xff || d[length - 1] != 0xd9) return 1;
+	for (int i = 16; i < length - 2; i++) {
+		if (d[i] != d[15]) return 1;
+	}
+
+	return 0;
+}
+
+static void *stream_client(void *arg) {
+	struct StreamClient *c = arg;
+	c->fd = stream_connect(c->port, c->delay ? 8192 : 0);
+	if (c->fd < 0) return NULL;
+
+	char *req = "GET /stream HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	send(c->fd, req, strlen(req), 0);
+	if (c->delay < 0) return NULL;
+
+	int max = 256 * 1024;
+	char *buffer = malloc(max + 1);
+	int length = 0;
+	uint64_t end = ptp_time_us() + (uint64_t)c->seconds * 1000000;
+	while (ptp_time_us() < end) {
+		int n = recv(c->fd, buffer + length, max - length, 0);
+		if (n <= 0) break;
+		length += n;
+		buffer[length] = '\0';
+
+		// Every complete part in the buffer
+		while (1) {
+			char *part = strstr(buffer, "Content-Length: ");
+			if (part == NULL) break;
+			char *body = strstr(part, "\r\n\r\n");
+			if (body == NULL) break;
+			body += 4;
+
+			int size = atoi(part + 16);
+			int used = (int)(body - buffer) + size;
+			if (used > length) break;
+
+			c->bad += stream_check_jpeg((uint8_t *)body, size);
+			c->frames++;
+			memmove(buffer, buffer + used, length - used);
+			length -= used;
+			buffer[length] = '\0';
+
+			if (c->delay) usleep(c->delay * 1000);
+		}
+
+		if (length == max) break;
+	}
+
+	free(buffer);
+	close(c->fd);
+	c->fd = -1;
+	return NULL;
+}
+
+// Fast clients keep the full rate next to a slow and a stalled one, the
+// stalled one times out, and clients past the limit get a 503
+static void test_mjpeg(struct PtpRuntime *r) {
+	static struct PtpLiveviewThread lv;
+	static struct PtpMjpegServer srv;
+
+	fakecam.period = 33333;
+	fakecam.width = 640;
+	fakecam.height = 480;
+
+	check(ptp_liveview_thread_start(r, &lv) == 0, "liveview thread starts");
+	memset(&srv, 0, sizeof(srv));
+	check(ptp_mjpeg_server_start(r, &srv, &lv) == 0, "MJPEG server starts");
+
+	// Never sends a request
+	int idle = stream_connect(srv.port, 0);
+
+	struct StreamClient c[6];
+	int delays[] = {0, 0, 0, 0, 300, -1};
+	for (int i = 0; i < 6; i++) {
+		memset(&c[i], 0, sizeof(c[i]));
+		c[i].port = srv.port;
+		c[i].delay = delays[i];
+		c[i].seconds = 3;
+		pthread_create(&c[i].thread, NULL, stream_client, &c[i]);
+	}
+
+	for (int i = 0; i < 6; i++) {
+		pthread_join(c[i].thread, NULL);
+	}
+
+	int ok = 1;
+	int bad = 0;
+	for (int i = 0; i < 5; i++) {
+		printf("client %d (%dms): %d frames, %d bad\n", i, c[i].delay, c[i].frames, c[i].bad);
+		if (c[i].delay == 0 && c[i].frames < 90 * 85 / 100) ok = 0;
+		bad += c[i].bad;
+	}
+
+	check(ok, "fast clients keep the camera frame rate");
+	check(c[4].frames > 0, "slow client gets frames");
+	check(bad == 0, "frames arrive whole");
+	check(lv.stalls == 0, "clients never stall the producer");
+
+	uint64_t end = ptp_time_us() + 5000000;
+	while (srv.timeouts == 0 && ptp_time_us() < end) {
+		usleep(100000);
+	}
+	check(srv.timeouts == 1, "client without a request times out");
+	close(idle);
+	close(c[5].fd);
+
+	int fd[PTP_MJPEG_MAX_CLIENTS + 1];
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS + 1; i++) {
+		fd[i] = stream_connect(srv.port, 0);
+		usleep(10000);
+	}
+
+	char reply[64] = {0};
+	recv(fd[PTP_MJPEG_MAX_CLIENTS], reply, sizeof(reply) - 1, 0);
+	check(!strncmp(reply, "HTTP/1.0 503", 12), "clients past the limit get a 503");
+	for (int i = 0; i < PTP_MJPEG_MAX_CLIENTS + 1; i++) {
+		if (fd[i] >= 0) close(fd[i]);
+	}
+
+	char buffer[1000];
+	ptp_mjpeg_server_json(&srv, buffer, sizeof(buffer));
+	printf("%s\n", buffer);
+
+	check(ptp_mjpeg_server_stop(&srv) == 0, "MJPEG server stops");
+	check(ptp_liveview_thread_stop(r, &lv) == 0, "liveview thread stops");
+
+	fakecam.period = 0;
+	fakecam.width = 0;
+	fakecam.height = 0;
+}
+#endif
+
+int main() {
+	struct PtpRuntime r;
+	ptp_generic_init(&r);
+	fakecam_init(&r);
+
+	test_pacing(&r);
+	test_blocks(&r);
+	test_record(&r);
+#ifndef _WIN32
+	test_mjpeg(&r);
+#endif
+
+	r.di = NULL;
+	printf("%d failed\n", failed);
+	return failed != 0;
+}
@@ -0,0 +1,85 @@
+// Check ptp_sharpness against the scalar path, and time them
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <camlib.h>
+
+// ML liveview
+#define WIDTH 360
+#define HEIGHT 240
+#define RUNS 500
+#define CASES 5000
+
+static double cpu_now() {
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int main() {
+	// Big enough for any region and stride below
+	int max = (WIDTH + 64) * HEIGHT;
+	uint8_t *frame = malloc(max);
+
+	srand(1234);
+	for (int i = 0; i < max; i++) {
+		frame[i] = rand();
+	}
+
+	// Extremes, so lanes would overflow if they were too narrow
+	for (int i = 0; i < WIDTH * 2; i++) {
+		frame[i] = (i & 1) ? 255 : 0;
+	}
+
+	// Every width around the vector sizes, a few short heights
+	for (int w = 0; w <= 100; w++) {
+		for (int h = 1; h <= 4; h++) {
+			if (ptp_sharpness(frame, w, w, h) != ptp_sharpness_scalar(frame, w, w, h)) {
+				printf("Mismatch at %dx%d\n", w, h);
+				return 1;
+			}
+		}
+	}
+
+	// Random regions, strides and offsets, so tails start anywhere
+	for (int i = 0; i < CASES; i++) {
+		int w = rand() % (WIDTH + 1);
+		int h = 1 + (rand() % 16);
+		int stride = w + (rand() % 64);
+		int offset = rand() % 64;
+		uint8_t *p = frame + offset;
+		if (offset + (h * stride) > max) continue;
+
+		uint64_t a = ptp_sharpness(p, stride, w, h);
+		uint64_t b = ptp_sharpness_scalar(p, stride, w, h);
+		if (a != b) {
+			printf("Mismatch at %dx%d, stride %d, offset %d: %llu != %llu\n",
+				w, h, stride, offset, (unsigned long long)a, (unsigned long long)b);
+			return 1;
+		}
+	}
+
+	// Known answer, across and down
+	uint8_t px[4] = {10, 30, 15, 5};
+	if (ptp_sharpness_scalar(px, 2, 2, 2) != 20 + 10 + 5 + 25) {
+		puts("Known answer failed");
+		return 1;
+	}
+
+	printf("Frame: %dx%d\n", WIDTH, HEIGHT);
+
+	double start = cpu_now();
+	uint64_t sum = 0;
+	for (int i = 0; i < RUNS; i++) sum += ptp_sharpness_scalar(frame, WIDTH, WIDTH, HEIGHT);
+	double scalar = (cpu_now() - start) / RUNS;
+
+	start = cpu_now();
+	for (int i = 0; i < RUNS; i++) sum -= ptp_sharpness(frame, WIDTH, WIDTH, HEIGHT);
+	double vector = (cpu_now() - start) / RUNS;
+
+	printf("scalar: %8.3f ms/frame, vector: %8.3f ms/frame\n", scalar * 1000, vector * 1000);
+
+	free(frame);
+	return sum != 0;
+}
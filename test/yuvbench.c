@@ -0,0 +1,90 @@
+// Check the ML liveview conversions against the scalar path, and time them
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <camlib.h>
+
+// ML liveview
+#define WIDTH 360
+#define HEIGHT 240
+#define RUNS 500
+
+static const char *names[] = {"yuva", "rgba", "bgra", "nv12", "i420"};
+
+static double cpu_now() {
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// The old ptp_liveview_ml loop
+static void expand_loop(uint8_t *buffer, uint8_t *data, int length) {
+	for (int i = 0; i < length; i++) {
+		buffer[0] = data[0];
+		buffer[1] = data[1];
+		buffer[2] = data[2];
+		buffer[3] = 0;
+		buffer += 4;
+		data += 3;
+	}
+}
+
+int main() {
+	uint8_t *frame = malloc(WIDTH * HEIGHT * 3);
+	uint8_t *a = malloc(WIDTH * HEIGHT * 4);
+	uint8_t *b = malloc(WIDTH * HEIGHT * 4);
+
+	srand(1234);
+	for (int i = 0; i < WIDTH * HEIGHT * 3; i++) {
+		frame[i] = rand();
+	}
+
+	// Every size around the vector widths, with extremes in the first pixels
+	frame[0] = 255; frame[1] = 127; frame[2] = 127;
+	frame[3] = 0; frame[4] = 128; frame[5] = 128;
+	for (int f = PTP_PIXEL_YUVA; f <= PTP_PIXEL_I420; f++) {
+		for (int w = 2; w <= 80; w += 2) {
+			for (int h = 2; h <= 6; h += 2) {
+				int x = ptp_yuv444_convert(a, frame, w, h, f, 0xff);
+				int y = ptp_yuv444_convert_scalar(b, frame, w, h, f, 0xff);
+				if (x != y || x != ptp_yuv444_size(w, h, f) || memcmp(a, b, x)) {
+					printf("Mismatch in %s at %dx%d\n", names[f], w, h);
+					return 1;
+				}
+			}
+		}
+	}
+
+	// Known answer, white and black don't move
+	uint8_t px[6] = {200, 0, 0, 10, 0, 0};
+	ptp_yuv444_convert_scalar(a, px, 2, 1, PTP_PIXEL_RGBA, 0xff);
+	if (memcmp(a, "\xc8\xc8\xc8\xff\x0a\x0a\x0a\xff", 8)) {
+		puts("Known answer failed");
+		return 1;
+	}
+
+	printf("Frame: %dx%d\n", WIDTH, HEIGHT);
+
+	double start = cpu_now();
+	for (int i = 0; i < RUNS; i++) expand_loop(a, frame, WIDTH * HEIGHT);
+	double loop = (cpu_now() - start) / RUNS;
+	printf("old loop:    %8.3f ms/frame\n", loop * 1000);
+
+	for (int f = PTP_PIXEL_YUVA; f <= PTP_PIXEL_I420; f++) {
+		start = cpu_now();
+		for (int i = 0; i < RUNS; i++) ptp_yuv444_convert_scalar(a, frame, WIDTH, HEIGHT, f, 0);
+		double scalar = (cpu_now() - start) / RUNS;
+
+		start = cpu_now();
+		for (int i = 0; i < RUNS; i++) ptp_yuv444_convert(a, frame, WIDTH, HEIGHT, f, 0);
+		double vector = (cpu_now() - start) / RUNS;
+
+		printf("%s scalar: %8.3f ms/frame, vector: %8.3f ms/frame\n", names[f], scalar * 1000, vector * 1000);
+	}
+
+	free(frame);
+	free(a);
+	free(b);
+	return 0;
+}